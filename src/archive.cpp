@@ -0,0 +1,211 @@
+#include "archive.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace rustymon {
+
+    namespace archive {
+
+        namespace {
+
+            void put_u32(char *target, std::uint32_t value) {
+                for (int i = 0; i < 4; i++) {
+                    target[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+                }
+            }
+
+            void put_u64(char *target, std::uint64_t value) {
+                for (int i = 0; i < 8; i++) {
+                    target[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+                }
+            }
+
+            std::uint32_t get_u32(const char *source) {
+                std::uint32_t value = 0;
+                for (int i = 3; i >= 0; i--) {
+                    value = (value << 8) | static_cast<unsigned char>(source[i]);
+                }
+                return value;
+            }
+
+            std::uint64_t get_u64(const char *source) {
+                std::uint64_t value = 0;
+                for (int i = 7; i >= 0; i--) {
+                    value = (value << 8) | static_cast<unsigned char>(source[i]);
+                }
+                return value;
+            }
+
+        }
+
+        std::uint64_t slot_count_for(const std::uint64_t tile_count) {
+            std::uint64_t slots = 1;
+            while (slots < 2 * tile_count) {
+                slots <<= 1;
+            }
+            return slots;
+        }
+
+        std::uint64_t hash_position(const std::int32_t x, const std::int32_t y, const std::int32_t level) {
+            // SplitMix64 finalizer over the combined coordinates, the level is mixed in first
+            std::uint64_t key = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) | static_cast<std::uint32_t>(y);
+            key ^= static_cast<std::uint64_t>(static_cast<std::uint32_t>(level)) * 0x9e3779b97f4a7c15ULL;
+            key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+            return key ^ (key >> 31);
+        }
+
+        Writer::Writer(const std::string &filename, const std::uint64_t max_tile_count) :
+                filename(filename),
+                output(filename, std::ofstream::binary | std::ofstream::trunc),
+                slot_count(slot_count_for(max_tile_count)),
+                offset(HEADER_SIZE + slot_count * SLOT_SIZE) {
+            if (!output.is_open()) {
+                throw std::runtime_error("failed to open tile archive " + filename + " for writing");
+            }
+            entries.reserve(max_tile_count);
+            // Header and index are written when closing the archive, reserve their space now
+            output.seekp(static_cast<std::streamoff>(offset));
+        }
+
+        Writer::~Writer() {
+            if (output.is_open()) {
+                try {
+                    close();
+                } catch (std::runtime_error &) {
+                }
+            }
+        }
+
+        void Writer::add(const std::int32_t x, const std::int32_t y, const std::int32_t level, const std::string &payload) {
+            if (entries.size() * 2 >= slot_count) {
+                throw std::runtime_error("too many tiles for the tile archive");
+            }
+            output.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+            if (!output) {
+                throw std::runtime_error("failed to write to the tile archive " + filename);
+            }
+            entries.push_back(Entry{x, y, level, offset, payload.size()});
+            offset += payload.size();
+        }
+
+        void Writer::close() {
+            std::vector<char> index(HEADER_SIZE + slot_count * SLOT_SIZE, 0);
+            std::memcpy(index.data(), MAGIC, sizeof(MAGIC));
+            put_u32(index.data() + 8, VERSION);
+            put_u32(index.data() + 12, 0);
+            put_u64(index.data() + 16, entries.size());
+            put_u64(index.data() + 24, slot_count);
+
+            for (const Entry &entry: entries) {
+                std::uint64_t slot = hash_position(entry.x, entry.y, entry.level) & (slot_count - 1);
+                while (get_u64(index.data() + HEADER_SIZE + slot * SLOT_SIZE + 16) != 0) {
+                    slot = (slot + 1) & (slot_count - 1);
+                }
+                char *target = index.data() + HEADER_SIZE + slot * SLOT_SIZE;
+                put_u32(target, static_cast<std::uint32_t>(entry.x));
+                put_u32(target + 4, static_cast<std::uint32_t>(entry.y));
+                put_u32(target + 8, static_cast<std::uint32_t>(entry.level));
+                put_u32(target + 12, 0);
+                put_u64(target + 16, entry.offset);
+                put_u64(target + 24, entry.length);
+            }
+
+            // A failed write of a tile leaves the stream failed, so this also covers the tiles
+            output.seekp(0);
+            output.write(index.data(), static_cast<std::streamsize>(index.size()));
+            const bool written = static_cast<bool>(output);
+            output.close();
+            if (!written || !output) {
+                throw std::runtime_error("failed to write the tile archive " + filename);
+            }
+        }
+
+        Reader::Reader(const std::string &filename) {
+            fd = open(filename.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::runtime_error("failed to open tile archive " + filename);
+            }
+            struct stat file_stat{};
+            if (fstat(fd, &file_stat) != 0 || static_cast<std::size_t>(file_stat.st_size) < HEADER_SIZE) {
+                ::close(fd);
+                throw std::runtime_error("invalid tile archive " + filename);
+            }
+            mapping_size = static_cast<std::size_t>(file_stat.st_size);
+            void *address = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (address == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("failed to map tile archive " + filename);
+            }
+            mapping = static_cast<const char *>(address);
+
+            tile_count = get_u64(mapping + 16);
+            slot_count = get_u64(mapping + 24);
+            const std::uint32_t version = get_u32(mapping + 8);
+            slot_size = (version == 1) ? SLOT_SIZE_V1 : SLOT_SIZE;
+            if (std::memcmp(mapping, MAGIC, sizeof(MAGIC)) != 0 || version == 0 || version > VERSION ||
+                    slot_count == 0 || (slot_count & (slot_count - 1)) != 0 ||
+                    HEADER_SIZE + slot_count * slot_size > mapping_size) {
+                munmap(const_cast<char *>(mapping), mapping_size);
+                ::close(fd);
+                throw std::runtime_error("invalid tile archive " + filename);
+            }
+            // The index is probed randomly, tile payloads are usually read sequentially
+            madvise(const_cast<char *>(mapping), HEADER_SIZE + slot_count * slot_size, MADV_WILLNEED);
+        }
+
+        Reader::~Reader() {
+            munmap(const_cast<char *>(mapping), mapping_size);
+            ::close(fd);
+        }
+
+        std::int32_t Reader::slot_level(const char *entry) const {
+            return (slot_size == SLOT_SIZE_V1) ? 0 : static_cast<std::int32_t>(get_u32(entry + 8));
+        }
+
+        TileData Reader::get(const std::int32_t x, const std::int32_t y, const std::int32_t level) const {
+            std::uint64_t slot = hash_position(x, y, level) & (slot_count - 1);
+            for (std::uint64_t probes = 0; probes < slot_count; probes++) {
+                const char *entry = mapping + HEADER_SIZE + slot * slot_size;
+                const std::uint64_t offset = get_u64(entry + offset_field());
+                if (offset == 0) {
+                    break;
+                }
+                if (static_cast<std::int32_t>(get_u32(entry)) == x && static_cast<std::int32_t>(get_u32(entry + 4)) == y &&
+                        slot_level(entry) == level) {
+                    const std::uint64_t length = get_u64(entry + offset_field() + 8);
+                    if (offset + length > mapping_size) {
+                        break;
+                    }
+                    return TileData{mapping + offset, static_cast<std::size_t>(length)};
+                }
+                slot = (slot + 1) & (slot_count - 1);
+            }
+            return TileData{nullptr, 0};
+        }
+
+        std::vector<Position> Reader::positions() const {
+            std::vector<Position> result;
+            result.reserve(tile_count);
+            for (std::uint64_t slot = 0; slot < slot_count; slot++) {
+                const char *entry = mapping + HEADER_SIZE + slot * slot_size;
+                if (get_u64(entry + offset_field()) != 0) {
+                    result.push_back(Position{
+                            slot_level(entry),
+                            static_cast<std::int32_t>(get_u32(entry)),
+                            static_cast<std::int32_t>(get_u32(entry + 4))
+                    });
+                }
+            }
+            return result;
+        }
+
+    }
+
+}
@@ -0,0 +1,126 @@
+#ifndef WORLD_GENERATOR_ARCHIVE_HPP
+#define WORLD_GENERATOR_ARCHIVE_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+
+/*
+ * Indexed single-file tile archive
+ *
+ * Layout (all integers are little-endian):
+ *   - header (32 bytes): magic "RSTYTILE", uint32 version, uint32 flags,
+ *     uint64 number of tiles, uint64 number of index slots (a power of two)
+ *   - index: one slot of 32 bytes per index slot: int32 x, int32 y, int32 level
+ *     (see structs::TileAddress), uint32 reserved, uint64 payload offset
+ *     (zero marks an empty slot), uint64 payload length
+ *     (version 1 archives use slots of 24 bytes without level and reserved field)
+ *   - tile payloads (the serialized tiles), referenced by the index
+ *
+ * The index is an open-addressing hash table with linear probing and a load
+ * factor of at most 50%, so looking up a tile requires reading one or two slots.
+ */
+
+namespace rustymon {
+
+    namespace archive {
+
+        static const char MAGIC[8] = {'R', 'S', 'T', 'Y', 'T', 'I', 'L', 'E'};
+        static const std::uint32_t VERSION = 2;
+        static const std::size_t HEADER_SIZE = 32;
+        static const std::size_t SLOT_SIZE = 32;
+        static const std::size_t SLOT_SIZE_V1 = 24;
+
+        std::uint64_t slot_count_for(std::uint64_t tile_count);
+
+        /// Hash of the tile address, tiles of level 0 hash like in version 1 archives
+        std::uint64_t hash_position(std::int32_t x, std::int32_t y, std::int32_t level = 0);
+
+        struct Position {
+            std::int32_t level;
+            std::int32_t x;
+            std::int32_t y;
+        };
+
+        class Writer {
+            struct Entry {
+                std::int32_t x;
+                std::int32_t y;
+                std::int32_t level;
+                std::uint64_t offset;
+                std::uint64_t length;
+            };
+
+            const std::string filename;
+            std::ofstream output;
+            std::uint64_t slot_count;
+            std::uint64_t offset;
+            std::vector<Entry> entries;
+
+        public:
+
+            /// Create a new archive which is able to hold up to the given number of tiles
+            Writer(const std::string &filename, std::uint64_t max_tile_count);
+
+            Writer(const Writer &) = delete;
+            Writer& operator = (const Writer &) = delete;
+
+            ~Writer();
+
+            /// Append a tile, throwing a std::runtime_error if it can't be written
+            void add(std::int32_t x, std::int32_t y, std::int32_t level, const std::string &payload);
+
+            /**
+             * Write the index and close the archive, throwing a std::runtime_error if the archive is incomplete.
+             * This is also done on destruction, where errors are ignored.
+             */
+            void close();
+        };
+
+        struct TileData {
+            const char *data;
+            std::size_t size;
+        };
+
+        class Reader {
+            int fd = -1;
+            const char *mapping = nullptr;
+            std::size_t mapping_size = 0;
+            std::uint64_t tile_count = 0;
+            std::uint64_t slot_count = 0;
+            std::size_t slot_size = SLOT_SIZE;
+
+            /// Offset of the payload offset within a slot, the payload length follows it
+            inline std::size_t offset_field() const {
+                return slot_size - 16;
+            }
+
+            std::int32_t slot_level(const char *entry) const;
+
+        public:
+
+            /// Memory-map the given archive, throwing a std::runtime_error if it's invalid
+            explicit Reader(const std::string &filename);
+
+            Reader(const Reader &) = delete;
+            Reader& operator = (const Reader &) = delete;
+
+            ~Reader();
+
+            inline std::uint64_t size() const {
+                return tile_count;
+            }
+
+            /// Look up a tile, returning a TileData with a null pointer if the tile doesn't exist
+            TileData get(std::int32_t x, std::int32_t y, std::int32_t level = 0) const;
+
+            /// Get the addresses of all tiles stored in the archive
+            std::vector<Position> positions() const;
+        };
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_ARCHIVE_HPP
@@ -0,0 +1,226 @@
+#include "bench.hpp"
+
+#include <cmath>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "synth.hpp"
+#include "generator.hpp"
+#include "exporter.hpp"
+#include "uploader.hpp"
+
+namespace rustymon {
+
+    namespace bench {
+
+        namespace {
+
+            std::string scale_name(const double scale) {
+                std::stringstream name;
+                name << scale;
+                return name.str();
+            }
+
+            Result run_single(const std::string &input_file, const std::string &output_file, const config::Config &config, const double scale, std::ostream &logger) {
+                struct stat info{};
+                stat(input_file.c_str(), &info);
+                Result result{scale, static_cast<std::uint64_t>(info.st_size), 0, 0, false};
+
+                // Buffered output would be written by both processes otherwise
+                logger.flush();
+                std::cout.flush();
+                std::cerr.flush();
+
+                const auto start = std::chrono::steady_clock::now();
+                const pid_t pid = fork();
+                if (pid < 0) {
+                    std::cerr << "Failed to start the benchmark process." << std::endl;
+                    return result;
+                }
+                if (pid == 0) {
+                    WorldGenerator generator(config);
+                    reader::read_from_file(generator, input_file, logger);
+                    export_world_to_archive(generator.get_world(), output_file, logger, config.workers.serialize);
+                    logger.flush();
+                    _exit(0);
+                }
+
+                int status = 0;
+                struct rusage usage{};
+                if (wait4(pid, &status, 0, &usage) != pid) {
+                    std::cerr << "Failed to wait for the benchmark process." << std::endl;
+                    return result;
+                }
+                result.seconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+                result.peak_rss = usage.ru_maxrss;
+                result.success = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+                return result;
+            }
+
+            /// Square grid of the given number of tiles with random POIs and streets, the tiles have a few KiB each
+            structs::World synthetic_world(const std::size_t tiles) {
+                std::mt19937_64 random(SYNTH_SEED_DEFAULT);
+                std::uniform_real_distribution<double> offset(0, 0.01);
+                const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(tiles))));
+                long oid = 1;
+                structs::World world;
+                for (std::size_t i = 0; i < tiles; i++) {
+                    const int x = static_cast<int>(i) % side;
+                    const int y = static_cast<int>(i) / side;
+                    const double lon = x * 0.01;
+                    const double lat = y * 0.01;
+                    structs::Tile tile{structs::BoundingBox(lon, lat, lon + 0.01, lat + 0.01), {}, {}, {}};
+                    for (int j = 0; j < UPLOAD_BENCH_POI_PER_TILE; j++) {
+                        tile.poi.push_back(structs::POI{oid++, 1, {lon + offset(random), lat + offset(random)}, SpawnSet{}});
+                    }
+                    for (int j = 0; j < UPLOAD_BENCH_STREETS_PER_TILE; j++) {
+                        structs::Street street{oid++, 1, {}};
+                        for (int k = 0; k < 8; k++) {
+                            street.waypoints.emplace_back(lon + offset(random), lat + offset(random));
+                        }
+                        tile.streets.push_back(std::move(street));
+                    }
+                    world[x].emplace(y, std::move(tile));
+                }
+                return world;
+            }
+
+            double percentile(std::vector<std::int64_t> &values, const double fraction) {
+                if (values.empty()) {
+                    return 0;
+                }
+                const std::size_t index = std::min(values.size() - 1, static_cast<std::size_t>(fraction * values.size()));
+                std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+                return values[index] / 1000.0;
+            }
+
+        }
+
+        std::vector<Result> run_benchmark(const std::string &directory, const config::Config &config, const std::vector<double> &scales, std::ostream &logger) {
+            mkdir(directory.c_str(), 0755);
+
+            std::vector<Result> results;
+            for (const double &scale: scales) {
+                const std::string input_file = directory + "/synth-" + scale_name(scale) + ".osm.pbf";
+                if (access(input_file.c_str(), F_OK) != 0) {
+                    synth::write_dataset(input_file, config, synth::Options{scale, SYNTH_DENSITY_DEFAULT, SYNTH_SEED_DEFAULT}, logger);
+                }
+                logger << "Running the benchmark at scale " << scale_name(scale) << "x..." << std::endl;
+                results.push_back(run_single(input_file, directory + "/synth-" + scale_name(scale) + ".tiles", config, scale, logger));
+            }
+
+            // The time and memory per MiB of input should stay constant for larger scales
+            logger << std::endl << std::left
+                   << std::setw(8) << "Scale" << std::setw(12) << "Input MiB" << std::setw(10) << "Seconds"
+                   << std::setw(10) << "MiB/s" << std::setw(14) << "Peak RSS MiB" << std::setw(16) << "s/MiB vs first"
+                   << "RSS/MiB vs first" << std::endl;
+            const Result *first = nullptr;
+            for (const Result &result: results) {
+                const double input_mib = result.input_bytes / (1024.0 * 1024.0);
+                const double rss_mib = result.peak_rss / 1024.0;
+                if (!result.success) {
+                    logger << std::setw(8) << (scale_name(result.scale) + "x") << "failed" << std::endl;
+                    continue;
+                }
+                if (first == nullptr) {
+                    first = &result;
+                }
+                const double first_input_mib = first->input_bytes / (1024.0 * 1024.0);
+                logger << std::setw(8) << (scale_name(result.scale) + "x")
+                       << std::setw(12) << std::fixed << std::setprecision(1) << input_mib
+                       << std::setw(10) << std::setprecision(2) << result.seconds
+                       << std::setw(10) << std::setprecision(1) << (result.seconds > 0 ? input_mib / result.seconds : 0)
+                       << std::setw(14) << std::setprecision(1) << rss_mib
+                       << std::setw(16) << std::setprecision(2) << ((result.seconds / input_mib) / (first->seconds / first_input_mib))
+                       << std::setprecision(2) << ((rss_mib / input_mib) / ((first->peak_rss / 1024.0) / first_input_mib))
+                       << std::endl;
+            }
+            logger << std::defaultfloat;
+            return results;
+        }
+
+        std::vector<UploadRun> run_upload_benchmark(const config::Config &config, const mock::Options &server_options, const std::size_t tiles, const std::vector<int> &in_flight, std::ostream &logger) {
+            const structs::World world = synthetic_world(tiles);
+            const std::vector<structs::TileRef> units = structs::export_units(world);
+
+            std::vector<UploadRun> results;
+            for (const int requests: in_flight) {
+                mock::IngestServer server(server_options);
+                upload::Options options = detail::upload_options(server.url(), config.http, "");
+                options.max_in_flight = requests;
+                options.max_connections = std::max(1, requests / std::max(1, options.event_threads));
+                logger << "Uploading " << units.size() << " tiles to " << server.url() << " with " << requests << " requests in flight..." << std::endl;
+
+                // Tiles are serialized by the event loops like in the asynchronous export
+                std::atomic<std::size_t> next_unit{0};
+                const upload::JobSource source = [&units, &next_unit](upload::UploadJob &job) {
+                    const std::size_t index = next_unit++;
+                    if (index >= units.size()) {
+                        return upload::JobState::DONE;
+                    }
+                    job.x = units[index].first.x;
+                    job.y = units[index].first.y;
+                    job.level = units[index].first.level;
+                    std::stringstream body;
+                    structs::stream_unit(body, units[index]);
+                    job.body = body.str();
+                    return upload::JobState::READY;
+                };
+                std::mutex latencies_mutex;
+                std::vector<std::int64_t> latencies;
+                latencies.reserve(units.size());
+                const upload::RequestCallback on_request = [&latencies_mutex, &latencies](const upload::UploadJob &, long, const std::int64_t microseconds) {
+                    std::lock_guard<std::mutex> lock(latencies_mutex);
+                    latencies.push_back(microseconds);
+                };
+
+                const auto start = std::chrono::steady_clock::now();
+                const upload::UploadResult result = upload::upload_all(options, source, logger, nullptr, upload::CompletionCallback(), on_request);
+                const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                server.stop();
+                results.push_back(UploadRun{
+                        requests,
+                        static_cast<std::uint64_t>(result.total_requests),
+                        static_cast<std::uint64_t>(result.errors),
+                        static_cast<std::uint64_t>(result.retries),
+                        result.bytes_sent,
+                        seconds,
+                        percentile(latencies, 0.5),
+                        percentile(latencies, 0.99),
+                        server.statistics().tiles
+                });
+            }
+
+            // Requests per second include the repeated requests, the received tiles should match the uploaded ones without errors
+            logger << std::endl << std::left
+                   << std::setw(11) << "In flight" << std::setw(10) << "Tiles" << std::setw(10) << "Req/s"
+                   << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "Retries"
+                   << std::setw(10) << "Errors" << std::setw(10) << "MiB sent" << "Received" << std::endl;
+            for (const UploadRun &run: results) {
+                logger << std::setw(11) << run.in_flight
+                       << std::setw(10) << run.requests
+                       << std::setw(10) << std::fixed << std::setprecision(0) << (run.seconds > 0 ? (run.requests + run.retries) / run.seconds : 0)
+                       << std::setw(10) << std::setprecision(2) << run.p50_ms
+                       << std::setw(10) << std::setprecision(2) << run.p99_ms
+                       << std::setw(10) << run.retries
+                       << std::setw(10) << run.errors
+                       << std::setw(10) << std::setprecision(1) << run.bytes_sent / (1024.0 * 1024.0)
+                       << run.tiles_received << std::endl;
+            }
+            logger << std::defaultfloat;
+            return results;
+        }
+
+    }
+
+}
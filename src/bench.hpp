@@ -0,0 +1,60 @@
+#ifndef WORLD_GENERATOR_BENCH_HPP
+#define WORLD_GENERATOR_BENCH_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+#include "config.hpp"
+#include "mock_ingest.hpp"
+
+namespace rustymon {
+
+    namespace bench {
+
+        struct Result {
+            double scale;
+            std::uint64_t input_bytes;
+            double seconds;
+            /// Peak resident set size of the child process in KiB
+            long peak_rss;
+            bool success;
+        };
+
+        /**
+         * Run the generator and the archive exporter on synthetic datasets of the given scales in the
+         * directory (creating missing datasets first). Every run happens in a child process, so its
+         * peak memory usage isn't influenced by the previous runs. Prints a summary table to the logger.
+         */
+        std::vector<Result> run_benchmark(const std::string &directory, const config::Config &config, const std::vector<double> &scales, std::ostream &logger = std::cout);
+
+        struct UploadRun {
+            /// Maximum number of requests in flight
+            int in_flight;
+            /// Number of uploaded tiles, without repeated requests
+            std::uint64_t requests;
+            /// Number of tiles which failed after all retries
+            std::uint64_t errors;
+            std::uint64_t retries;
+            std::uint64_t bytes_sent;
+            double seconds;
+            /// Latency percentiles of all requests in milliseconds, including repeated ones
+            double p50_ms;
+            double p99_ms;
+            /// Number of different tiles the server accepted
+            std::size_t tiles_received;
+        };
+
+        /**
+         * Upload a synthetic world of the given number of tiles to a local mock ingest server once for
+         * every number of requests in flight, using the asynchronous uploader with the HTTP settings of
+         * the config. Every run gets a fresh server. Prints a summary table to the logger.
+         */
+        std::vector<UploadRun> run_upload_benchmark(const config::Config &config, const mock::Options &server_options, std::size_t tiles, const std::vector<int> &in_flight, std::ostream &logger = std::cout);
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_BENCH_HPP
@@ -0,0 +1,762 @@
+#include "block_index.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+#include <protozero/pbf_reader.hpp>
+#include <osmium/index/id_set.hpp>
+#include <osmium/index/map/flex_mem.hpp>
+#include <osmium/osm/location.hpp>
+
+namespace rustymon {
+
+    namespace block_index {
+
+        namespace {
+
+            using location_index_type = osmium::index::map::FlexMem<osmium::unsigned_object_id_type, osmium::Location>;
+            using id_set_type = osmium::index::IdSetDense<osmium::unsigned_object_id_type>;
+
+            template<typename T>
+            void write_value(std::ostream &stream, const T &value) {
+                stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+            }
+
+            template<typename T>
+            T read_value(std::istream &stream) {
+                T value{};
+                stream.read(reinterpret_cast<char *>(&value), sizeof(T));
+                return value;
+            }
+
+            void write_envelope(std::ostream &stream, const Envelope &envelope) {
+                write_value(stream, envelope.min_x);
+                write_value(stream, envelope.min_y);
+                write_value(stream, envelope.max_x);
+                write_value(stream, envelope.max_y);
+            }
+
+            Envelope read_envelope(std::istream &stream) {
+                Envelope envelope;
+                envelope.min_x = read_value<std::int32_t>(stream);
+                envelope.min_y = read_value<std::int32_t>(stream);
+                envelope.max_x = read_value<std::int32_t>(stream);
+                envelope.max_y = read_value<std::int32_t>(stream);
+                return envelope;
+            }
+
+            bool get_file_info(const std::string &filename, std::uint64_t &size, std::int64_t &modified) {
+                struct stat info{};
+                if (stat(filename.c_str(), &info) != 0) {
+                    return false;
+                }
+                size = static_cast<std::uint64_t>(info.st_size);
+                modified = static_cast<std::int64_t>(info.st_mtime);
+                return true;
+            }
+
+            /// Position of a block in the input file, as found by scanning the blob headers
+            struct RawBlock {
+                std::uint64_t offset;
+                std::uint32_t size;
+                std::uint64_t blob_offset;
+                std::uint32_t blob_size;
+                bool header;
+            };
+
+            std::vector<RawBlock> scan_blocks(std::ifstream &input) {
+                std::vector<RawBlock> raw_blocks;
+                std::string blob_header;
+                while (true) {
+                    const auto offset = static_cast<std::uint64_t>(input.tellg());
+                    unsigned char length_bytes[4];
+                    if (!input.read(reinterpret_cast<char *>(length_bytes), sizeof(length_bytes))) {
+                        break;
+                    }
+                    // The length of the blob header is the only big-endian value of the format
+                    const std::uint32_t header_size = (static_cast<std::uint32_t>(length_bytes[0]) << 24) |
+                            (static_cast<std::uint32_t>(length_bytes[1]) << 16) |
+                            (static_cast<std::uint32_t>(length_bytes[2]) << 8) |
+                            static_cast<std::uint32_t>(length_bytes[3]);
+                    blob_header.resize(header_size);
+                    if (!input.read(&blob_header[0], header_size)) {
+                        throw std::runtime_error("truncated blob header");
+                    }
+
+                    std::string type;
+                    std::int32_t blob_size = 0;
+                    protozero::pbf_reader message{blob_header};
+                    while (message.next()) {
+                        switch (message.tag()) {
+                            case 1:
+                                type = message.get_string();
+                                break;
+                            case 3:
+                                blob_size = message.get_int32();
+                                break;
+                            default:
+                                message.skip();
+                        }
+                    }
+                    if (type != "OSMHeader" && type != "OSMData") {
+                        throw std::runtime_error("unknown blob type '" + type + "'");
+                    }
+
+                    const std::uint64_t blob_offset = offset + 4 + header_size;
+                    raw_blocks.push_back(RawBlock{offset, static_cast<std::uint32_t>(4 + header_size + blob_size), blob_offset, static_cast<std::uint32_t>(blob_size), type == "OSMHeader"});
+                    input.seekg(static_cast<std::streamoff>(blob_offset + blob_size));
+                }
+                return raw_blocks;
+            }
+
+            std::string read_block_data(std::ifstream &input, const RawBlock &raw_block) {
+                std::string blob(raw_block.blob_size, '\0');
+                input.clear();
+                input.seekg(static_cast<std::streamoff>(raw_block.blob_offset));
+                if (!input.read(&blob[0], raw_block.blob_size)) {
+                    throw std::runtime_error("truncated blob");
+                }
+
+                std::int32_t raw_size = 0;
+                protozero::data_view zlib_data;
+                protozero::pbf_reader message{blob};
+                while (message.next()) {
+                    switch (message.tag()) {
+                        case 1:
+                            return message.get_string();
+                        case 2:
+                            raw_size = message.get_int32();
+                            break;
+                        case 3:
+                            zlib_data = message.get_view();
+                            break;
+                        default:
+                            throw std::runtime_error("unsupported blob compression");
+                    }
+                }
+
+                std::string data(static_cast<std::size_t>(raw_size), '\0');
+                uLongf data_size = static_cast<uLongf>(raw_size);
+                if (uncompress(reinterpret_cast<Bytef *>(&data[0]), &data_size, reinterpret_cast<const Bytef *>(zlib_data.data()), static_cast<uLong>(zlib_data.size())) != Z_OK || data_size != static_cast<uLongf>(raw_size)) {
+                    throw std::runtime_error("failed to decompress blob");
+                }
+                return data;
+            }
+
+            struct PrimitiveBlock {
+                std::vector<protozero::data_view> strings;
+                std::vector<protozero::data_view> groups;
+                std::int64_t granularity = 100;
+                std::int64_t lat_offset = 0;
+                std::int64_t lon_offset = 0;
+
+                /// The views refer to the data, which must outlive the block
+                explicit PrimitiveBlock(const std::string &data) {
+                    // The primitive groups precede the granularity and offsets, so they are decoded later
+                    protozero::pbf_reader message{data};
+                    while (message.next()) {
+                        switch (message.tag()) {
+                            case 1: {
+                                protozero::pbf_reader string_table = message.get_message();
+                                while (string_table.next(1)) {
+                                    strings.push_back(string_table.get_view());
+                                }
+                                break;
+                            }
+                            case 2:
+                                groups.push_back(message.get_view());
+                                break;
+                            case 17:
+                                granularity = message.get_int32();
+                                break;
+                            case 19:
+                                lat_offset = message.get_int64();
+                                break;
+                            case 20:
+                                lon_offset = message.get_int64();
+                                break;
+                            default:
+                                message.skip();
+                        }
+                    }
+                }
+
+                inline osmium::Location location(const std::int64_t lon, const std::int64_t lat) const {
+                    // Nanodegrees to the fixed-point coordinates of osmium
+                    return osmium::Location{
+                            static_cast<std::int32_t>((lon_offset + granularity * lon) / 100),
+                            static_cast<std::int32_t>((lat_offset + granularity * lat) / 100)
+                    };
+                }
+
+                bool is_area_relation(const std::vector<std::uint32_t> &keys, const std::vector<std::uint32_t> &values) const {
+                    for (std::size_t i = 0; i < keys.size() && i < values.size(); i++) {
+                        if (keys[i] < strings.size() && values[i] < strings.size() && strings[keys[i]] == "type" &&
+                            (strings[values[i]] == "multipolygon" || strings[values[i]] == "boundary")) {
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+            };
+
+            struct Relation {
+                std::vector<std::uint32_t> keys;
+                std::vector<std::uint32_t> values;
+                std::vector<std::int64_t> member_ids;
+                std::vector<std::int32_t> member_types;
+            };
+
+            Relation decode_relation(protozero::pbf_reader message) {
+                Relation relation;
+                while (message.next()) {
+                    switch (message.tag()) {
+                        case 2:
+                            for (const std::uint32_t key: message.get_packed_uint32()) {
+                                relation.keys.push_back(key);
+                            }
+                            break;
+                        case 3:
+                            for (const std::uint32_t value: message.get_packed_uint32()) {
+                                relation.values.push_back(value);
+                            }
+                            break;
+                        case 9: {
+                            std::int64_t id = 0;
+                            for (const std::int64_t delta: message.get_packed_sint64()) {
+                                id += delta;
+                                relation.member_ids.push_back(id);
+                            }
+                            break;
+                        }
+                        case 10:
+                            for (const std::int32_t type: message.get_packed_enum()) {
+                                relation.member_types.push_back(type);
+                            }
+                            break;
+                        default:
+                            message.skip();
+                    }
+                }
+                return relation;
+            }
+
+            /// Range of object IDs in a block, used to find the block of a referenced object
+            struct IdRange {
+                std::int64_t first;
+                std::int64_t last;
+                std::uint32_t block;
+            };
+
+            class Indexer {
+                std::vector<Block> &blocks;
+                const id_set_type &member_ways;
+                location_index_type locations;
+                bool locations_prepared = false;
+                std::vector<IdRange> node_ranges;
+                std::vector<IdRange> way_ranges;
+                std::vector<std::pair<std::int64_t, Envelope>> way_envelopes;
+
+                // State of the current block
+                std::unordered_map<std::uint32_t, Envelope> dependencies;
+                IdRange nodes{0, 0, 0};
+                IdRange ways{0, 0, 0};
+                bool has_nodes = false;
+                bool has_ways = false;
+
+                static int find_block(const std::vector<IdRange> &ranges, const std::int64_t id) {
+                    auto it = std::upper_bound(ranges.begin(), ranges.end(), id, [](std::int64_t value, const IdRange &range){
+                        return value < range.first;
+                    });
+                    if (it == ranges.begin() || (--it)->last < id) {
+                        return -1;
+                    }
+                    return static_cast<int>(it->block);
+                }
+
+                static void add_range(std::vector<IdRange> &ranges, const IdRange &range) {
+                    if (!ranges.empty() && ranges.back().last >= range.first) {
+                        std::cerr << "The input file must be sorted by type and ID to be indexed." << std::endl;
+                        exit(1);
+                    }
+                    ranges.push_back(range);
+                }
+
+                void add_node(Block &block, const std::int64_t id, const osmium::Location location) {
+                    if (!has_nodes) {
+                        nodes.first = id;
+                        has_nodes = true;
+                    }
+                    nodes.last = id;
+                    block.types |= NODES;
+                    block.envelope.extend(location.x(), location.y());
+                    if (id > 0) {
+                        locations.set(static_cast<osmium::unsigned_object_id_type>(id), location);
+                    }
+                }
+
+                void add_way(Block &block, const std::int64_t id, const std::vector<std::int64_t> &refs) {
+                    if (!has_ways) {
+                        ways.first = id;
+                        has_ways = true;
+                    }
+                    ways.last = id;
+                    block.types |= WAYS;
+                    if (!locations_prepared) {
+                        locations.prepare_for_lookup();
+                        locations_prepared = true;
+                    }
+
+                    Envelope envelope;
+                    for (const std::int64_t &ref: refs) {
+                        if (ref <= 0) {
+                            continue;
+                        }
+                        const osmium::Location location = locations.get_noexcept(static_cast<osmium::unsigned_object_id_type>(ref));
+                        if (location.valid()) {
+                            envelope.extend(location.x(), location.y());
+                        }
+                    }
+                    if (!envelope.valid()) {
+                        return;
+                    }
+                    block.envelope.extend(envelope);
+
+                    // Consecutive nodes of a way are usually stored in the same block
+                    int last_block = -1;
+                    for (const std::int64_t &ref: refs) {
+                        const int node_block = find_block(node_ranges, ref);
+                        if (node_block >= 0 && node_block != last_block) {
+                            dependencies[static_cast<std::uint32_t>(node_block)].extend(envelope);
+                            last_block = node_block;
+                        }
+                    }
+                    if (id > 0 && member_ways.get(static_cast<osmium::unsigned_object_id_type>(id))) {
+                        way_envelopes.emplace_back(id, envelope);
+                    }
+                }
+
+                void add_relation(Block &block, const Relation &relation) {
+                    block.types |= RELATIONS;
+
+                    Envelope envelope;
+                    std::vector<std::uint32_t> relation_dependencies;
+                    for (std::size_t i = 0; i < relation.member_ids.size() && i < relation.member_types.size(); i++) {
+                        const std::int64_t id = relation.member_ids[i];
+                        if (relation.member_types[i] == 0 && id > 0) {
+                            const osmium::Location location = locations.get_noexcept(static_cast<osmium::unsigned_object_id_type>(id));
+                            const int node_block = find_block(node_ranges, id);
+                            if (location.valid() && node_block >= 0) {
+                                envelope.extend(location.x(), location.y());
+                                relation_dependencies.push_back(static_cast<std::uint32_t>(node_block));
+                            }
+                        } else if (relation.member_types[i] == 1) {
+                            auto it = std::lower_bound(way_envelopes.begin(), way_envelopes.end(), id, [](const std::pair<std::int64_t, Envelope> &entry, std::int64_t value){
+                                return entry.first < value;
+                            });
+                            const int way_block = find_block(way_ranges, id);
+                            if (it != way_envelopes.end() && it->first == id && way_block >= 0) {
+                                envelope.extend(it->second);
+                                relation_dependencies.push_back(static_cast<std::uint32_t>(way_block));
+                            }
+                        }
+                    }
+                    if (!envelope.valid()) {
+                        return;
+                    }
+                    block.envelope.extend(envelope);
+                    for (const std::uint32_t &dependency: relation_dependencies) {
+                        dependencies[dependency].extend(envelope);
+                    }
+                }
+
+                void decode_group(Block &block, const PrimitiveBlock &primitive_block, protozero::pbf_reader group) {
+                    while (group.next()) {
+                        switch (group.tag()) {
+                            case 1: {
+                                protozero::pbf_reader node = group.get_message();
+                                std::int64_t id = 0;
+                                std::int64_t lat = 0;
+                                std::int64_t lon = 0;
+                                while (node.next()) {
+                                    switch (node.tag()) {
+                                        case 1:
+                                            id = node.get_sint64();
+                                            break;
+                                        case 8:
+                                            lat = node.get_sint64();
+                                            break;
+                                        case 9:
+                                            lon = node.get_sint64();
+                                            break;
+                                        default:
+                                            node.skip();
+                                    }
+                                }
+                                add_node(block, id, primitive_block.location(lon, lat));
+                                break;
+                            }
+                            case 2: {
+                                protozero::pbf_reader dense = group.get_message();
+                                std::vector<std::int64_t> ids;
+                                std::vector<std::int64_t> lats;
+                                std::vector<std::int64_t> lons;
+                                while (dense.next()) {
+                                    std::vector<std::int64_t> *target = nullptr;
+                                    switch (dense.tag()) {
+                                        case 1:
+                                            target = &ids;
+                                            break;
+                                        case 8:
+                                            target = &lats;
+                                            break;
+                                        case 9:
+                                            target = &lons;
+                                            break;
+                                        default:
+                                            dense.skip();
+                                    }
+                                    if (target != nullptr) {
+                                        std::int64_t value = 0;
+                                        for (const std::int64_t delta: dense.get_packed_sint64()) {
+                                            value += delta;
+                                            target->push_back(value);
+                                        }
+                                    }
+                                }
+                                for (std::size_t i = 0; i < ids.size() && i < lats.size() && i < lons.size(); i++) {
+                                    add_node(block, ids[i], primitive_block.location(lons[i], lats[i]));
+                                }
+                                break;
+                            }
+                            case 3: {
+                                protozero::pbf_reader way = group.get_message();
+                                std::int64_t id = 0;
+                                std::vector<std::int64_t> refs;
+                                while (way.next()) {
+                                    switch (way.tag()) {
+                                        case 1:
+                                            id = way.get_int64();
+                                            break;
+                                        case 8: {
+                                            std::int64_t ref = 0;
+                                            for (const std::int64_t delta: way.get_packed_sint64()) {
+                                                ref += delta;
+                                                refs.push_back(ref);
+                                            }
+                                            break;
+                                        }
+                                        default:
+                                            way.skip();
+                                    }
+                                }
+                                add_way(block, id, refs);
+                                break;
+                            }
+                            case 4: {
+                                const Relation relation = decode_relation(group.get_message());
+                                if (primitive_block.is_area_relation(relation.keys, relation.values)) {
+                                    add_relation(block, relation);
+                                } else {
+                                    block.types |= RELATIONS;
+                                }
+                                break;
+                            }
+                            default:
+                                group.skip();
+                        }
+                    }
+                }
+
+            public:
+
+                Indexer(std::vector<Block> &blocks, const id_set_type &member_ways) : blocks(blocks), member_ways(member_ways) {}
+
+                void add_block(const RawBlock &raw_block, const std::string &data) {
+                    const auto block_number = static_cast<std::uint32_t>(blocks.size());
+                    blocks.push_back(Block{raw_block.offset, raw_block.size, 0, Envelope{}, {}});
+                    Block &block = blocks.back();
+                    if (raw_block.header) {
+                        block.types = HEADER;
+                        return;
+                    }
+
+                    dependencies.clear();
+                    has_nodes = false;
+                    has_ways = false;
+                    const PrimitiveBlock primitive_block(data);
+                    for (const protozero::data_view &group: primitive_block.groups) {
+                        decode_group(block, primitive_block, protozero::pbf_reader{group});
+                    }
+
+                    if (has_nodes) {
+                        add_range(node_ranges, IdRange{nodes.first, nodes.last, block_number});
+                    }
+                    if (has_ways) {
+                        add_range(way_ranges, IdRange{ways.first, ways.last, block_number});
+                    }
+                    for (const std::pair<const std::uint32_t, Envelope> &dependency: dependencies) {
+                        if (dependency.first != block_number) {
+                            block.dependencies.push_back(Dependency{dependency.first, dependency.second});
+                        }
+                    }
+                    std::sort(block.dependencies.begin(), block.dependencies.end(), [](const Dependency &a, const Dependency &b){
+                        return a.block < b.block;
+                    });
+                }
+            };
+
+            /// Collect the member ways of area relations, which are stored in the last blocks of a sorted file
+            void collect_member_ways(std::ifstream &input, const std::vector<RawBlock> &raw_blocks, id_set_type &member_ways) {
+                for (auto it = raw_blocks.rbegin(); it != raw_blocks.rend() && !it->header; ++it) {
+                    const std::string data = read_block_data(input, *it);
+                    const PrimitiveBlock primitive_block(data);
+                    bool has_relations = false;
+                    for (const protozero::data_view &group_data: primitive_block.groups) {
+                        protozero::pbf_reader group{group_data};
+                        while (group.next(4)) {
+                            has_relations = true;
+                            const Relation relation = decode_relation(group.get_message());
+                            if (!primitive_block.is_area_relation(relation.keys, relation.values)) {
+                                continue;
+                            }
+                            for (std::size_t i = 0; i < relation.member_ids.size() && i < relation.member_types.size(); i++) {
+                                if (relation.member_types[i] == 1 && relation.member_ids[i] > 0) {
+                                    member_ways.set(static_cast<osmium::unsigned_object_id_type>(relation.member_ids[i]));
+                                }
+                            }
+                        }
+                    }
+                    if (!has_relations) {
+                        break;
+                    }
+                }
+            }
+
+        }
+
+        void Envelope::extend(const std::int32_t x, const std::int32_t y) {
+            if (!valid()) {
+                min_x = max_x = x;
+                min_y = max_y = y;
+                return;
+            }
+            min_x = std::min(min_x, x);
+            min_y = std::min(min_y, y);
+            max_x = std::max(max_x, x);
+            max_y = std::max(max_y, y);
+        }
+
+        void Envelope::extend(const Envelope &other) {
+            if (other.valid()) {
+                extend(other.min_x, other.min_y);
+                extend(other.max_x, other.max_y);
+            }
+        }
+
+        bool Envelope::intersects(const Envelope &other) const {
+            return valid() && other.valid() && min_x <= other.max_x && other.min_x <= max_x && min_y <= other.max_y && other.min_y <= max_y;
+        }
+
+        Envelope to_envelope(const osmium::Box &box) {
+            Envelope envelope;
+            envelope.extend(box.bottom_left().x(), box.bottom_left().y());
+            envelope.extend(box.top_right().x(), box.top_right().y());
+            return envelope;
+        }
+
+        std::string index_filename(const std::string &input_file) {
+            return input_file + ".blocks";
+        }
+
+        std::vector<Block> build_index(const std::string &input_file, std::ostream &logger) {
+            const auto start = std::chrono::steady_clock::now();
+            std::ifstream input(input_file, std::ifstream::binary);
+            if (!input.is_open()) {
+                std::cerr << "Input file " << input_file << " not found." << std::endl;
+                exit(1);
+            }
+
+            std::vector<Block> blocks;
+            try {
+                const std::vector<RawBlock> raw_blocks = scan_blocks(input);
+                id_set_type member_ways;
+                collect_member_ways(input, raw_blocks, member_ways);
+
+                Indexer indexer(blocks, member_ways);
+                for (const RawBlock &raw_block: raw_blocks) {
+                    indexer.add_block(raw_block, raw_block.header ? std::string() : read_block_data(input, raw_block));
+                }
+            } catch (std::runtime_error &error) {
+                std::cerr << "Failed to index " << input_file << ": " << error.what() << std::endl;
+                exit(1);
+            }
+
+            const auto seconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+            logger << "Indexed " << blocks.size() << " blocks of " << input_file << " in " << seconds << " seconds." << std::endl;
+            return blocks;
+        }
+
+        void write_index(const std::string &input_file, const std::vector<Block> &blocks) {
+            std::uint64_t size = 0;
+            std::int64_t modified = 0;
+            if (!get_file_info(input_file, size, modified)) {
+                std::cerr << "Input file " << input_file << " not found." << std::endl;
+                exit(1);
+            }
+
+            const std::string filename = index_filename(input_file);
+            std::ofstream output(filename + ".tmp", std::ofstream::binary | std::ofstream::trunc);
+            output.write(MAGIC, sizeof(MAGIC));
+            write_value(output, VERSION);
+            write_value(output, size);
+            write_value(output, modified);
+            write_value(output, static_cast<std::uint64_t>(blocks.size()));
+            for (const Block &block: blocks) {
+                write_value(output, block.offset);
+                write_value(output, block.size);
+                write_value(output, block.types);
+                write_envelope(output, block.envelope);
+                write_value(output, static_cast<std::uint32_t>(block.dependencies.size()));
+                for (const Dependency &dependency: block.dependencies) {
+                    write_value(output, dependency.block);
+                    write_envelope(output, dependency.envelope);
+                }
+            }
+            output.close();
+            if (!output || std::rename((filename + ".tmp").c_str(), filename.c_str()) != 0) {
+                std::cerr << "Failed to write the block index " << filename << "." << std::endl;
+                exit(1);
+            }
+        }
+
+        bool read_index(const std::string &input_file, std::vector<Block> &blocks) {
+            std::ifstream input(index_filename(input_file), std::ifstream::binary);
+            std::uint64_t size = 0;
+            std::int64_t modified = 0;
+            if (!input.is_open() || !get_file_info(input_file, size, modified)) {
+                return false;
+            }
+
+            char magic[sizeof(MAGIC)];
+            input.read(magic, sizeof(magic));
+            if (!input || std::memcmp(magic, MAGIC, sizeof(magic)) != 0 || read_value<std::uint32_t>(input) != VERSION) {
+                return false;
+            }
+            const auto indexed_size = read_value<std::uint64_t>(input);
+            const auto indexed_modified = read_value<std::int64_t>(input);
+            if (indexed_size != size || indexed_modified != modified) {
+                return false;
+            }
+
+            const auto block_count = read_value<std::uint64_t>(input);
+            blocks.clear();
+            blocks.reserve(block_count);
+            for (std::uint64_t i = 0; i < block_count && input; i++) {
+                Block block{0, 0, 0, Envelope{}, {}};
+                block.offset = read_value<std::uint64_t>(input);
+                block.size = read_value<std::uint32_t>(input);
+                block.types = read_value<std::uint8_t>(input);
+                block.envelope = read_envelope(input);
+                const auto dependency_count = read_value<std::uint32_t>(input);
+                block.dependencies.reserve(dependency_count);
+                for (std::uint32_t j = 0; j < dependency_count; j++) {
+                    const auto dependency = read_value<std::uint32_t>(input);
+                    block.dependencies.push_back(Dependency{dependency, read_envelope(input)});
+                }
+                blocks.push_back(std::move(block));
+            }
+            return static_cast<bool>(input);
+        }
+
+        std::vector<std::uint32_t> select_blocks(const std::vector<Block> &blocks, const Envelope &bbox) {
+            // Envelope of the objects needed from every block, dependencies always precede their dependents
+            std::vector<Envelope> needed(blocks.size());
+            for (std::size_t i = 0; i < blocks.size(); i++) {
+                if (blocks[i].envelope.intersects(bbox)) {
+                    needed[i] = bbox;
+                }
+            }
+            for (std::size_t i = blocks.size(); i-- > 0;) {
+                if (!needed[i].valid()) {
+                    continue;
+                }
+                for (const Dependency &dependency: blocks[i].dependencies) {
+                    if (dependency.block < i && dependency.envelope.intersects(needed[i])) {
+                        needed[dependency.block].extend(dependency.envelope);
+                    }
+                }
+            }
+
+            std::vector<std::uint32_t> selected;
+            for (std::size_t i = 0; i < blocks.size(); i++) {
+                if (needed[i].valid() || (blocks[i].types & HEADER) != 0) {
+                    selected.push_back(static_cast<std::uint32_t>(i));
+                }
+            }
+            return selected;
+        }
+
+        void extract_blocks(const std::string &input_file, const std::vector<Block> &blocks, const std::vector<std::uint32_t> &selected, const std::string &output_file) {
+            std::ifstream input(input_file, std::ifstream::binary);
+            std::ofstream output(output_file, std::ofstream::binary | std::ofstream::trunc);
+            std::string buffer;
+            for (const std::uint32_t &index: selected) {
+                const Block &block = blocks.at(index);
+                buffer.resize(block.size);
+                input.seekg(static_cast<std::streamoff>(block.offset));
+                input.read(&buffer[0], block.size);
+                output.write(buffer.data(), block.size);
+            }
+            output.close();
+            if (!input || !output) {
+                std::cerr << "Failed to extract the blocks of " << input_file << " into " << output_file << "." << std::endl;
+                exit(1);
+            }
+        }
+
+        std::string prepare_extract(const std::string &input_file, const osmium::Box &bbox, std::ostream &logger) {
+            std::vector<Block> blocks;
+            if (!read_index(input_file, blocks)) {
+                if (access(index_filename(input_file).c_str(), F_OK) == 0) {
+                    logger << "The block index of " << input_file << " is outdated, reading the whole file." << std::endl;
+                }
+                return "";
+            }
+
+            const std::vector<std::uint32_t> selected = select_blocks(blocks, to_envelope(bbox));
+            std::uint64_t total_size = 0;
+            std::uint64_t selected_size = 0;
+            for (const Block &block: blocks) {
+                total_size += block.size;
+            }
+            for (const std::uint32_t &index: selected) {
+                selected_size += blocks[index].size;
+            }
+
+            // The suffix is required for osmium to detect the file format
+            std::string filename = input_file + ".extract-XXXXXX.osm.pbf";
+            const int fd = mkstemps(&filename[0], 8);
+            if (fd < 0) {
+                std::cerr << "Failed to create a temporary extract of " << input_file << "." << std::endl;
+                exit(1);
+            }
+            close(fd);
+            extract_blocks(input_file, blocks, selected, filename);
+            logger << "Selected " << selected.size() << " of " << blocks.size() << " blocks ("
+                   << selected_size / (1024 * 1024) << " of " << total_size / (1024 * 1024) << " MiB) using the block index." << std::endl;
+            return filename;
+        }
+
+    }
+
+}
@@ -0,0 +1,102 @@
+#ifndef WORLD_GENERATOR_BLOCK_INDEX_HPP
+#define WORLD_GENERATOR_BLOCK_INDEX_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+#include <osmium/osm/box.hpp>
+
+/*
+ * Spatial index of the blocks of a sorted PBF file ("sidecar" next to the input file)
+ *
+ * Layout (native byte order):
+ *   - header: magic "RSTYPBFI", uint32 version, uint64 size and int64 modification
+ *     time of the indexed file, uint64 number of blocks
+ *   - one entry per block: uint64 file offset, uint32 size (including the length
+ *     prefix and the blob header), uint8 entity types, envelope (4 x int32),
+ *     uint32 number of dependencies, followed by the dependencies
+ *   - dependency: uint32 index of the block, envelope (4 x int32) of the objects
+ *     of this block which need the other block
+ *
+ * Envelopes are in fixed-point coordinates like osmium::Location. Ways depend on the
+ * blocks of their nodes, multipolygon and boundary relations on the blocks of their members.
+ */
+
+namespace rustymon {
+
+    namespace block_index {
+
+        static const char MAGIC[8] = {'R', 'S', 'T', 'Y', 'P', 'B', 'F', 'I'};
+        static const std::uint32_t VERSION = 1;
+
+        static const std::uint8_t HEADER = 1;
+        static const std::uint8_t NODES = 2;
+        static const std::uint8_t WAYS = 4;
+        static const std::uint8_t RELATIONS = 8;
+
+        struct Envelope {
+            std::int32_t min_x = 1;
+            std::int32_t min_y = 1;
+            std::int32_t max_x = 0;
+            std::int32_t max_y = 0;
+
+            inline bool valid() const {
+                return min_x <= max_x && min_y <= max_y;
+            }
+
+            void extend(std::int32_t x, std::int32_t y);
+
+            void extend(const Envelope &other);
+
+            bool intersects(const Envelope &other) const;
+        };
+
+        Envelope to_envelope(const osmium::Box &box);
+
+        struct Dependency {
+            std::uint32_t block;
+            Envelope envelope;
+        };
+
+        struct Block {
+            std::uint64_t offset;
+            std::uint32_t size;
+            std::uint8_t types;
+            Envelope envelope;
+            std::vector<Dependency> dependencies;
+        };
+
+        /// Filename of the index of the given input file
+        std::string index_filename(const std::string &input_file);
+
+        /// Scan the complete input file once and build the index of its blocks
+        std::vector<Block> build_index(const std::string &input_file, std::ostream &logger = std::cout);
+
+        void write_index(const std::string &input_file, const std::vector<Block> &blocks);
+
+        /// Load the index of the input file, returning false if it's missing or outdated
+        bool read_index(const std::string &input_file, std::vector<Block> &blocks);
+
+        /**
+         * Select the blocks required for the bounding box: all blocks whose envelope intersects the
+         * bounding box and, recursively, the dependencies of those blocks which are needed there.
+         * The file header is always selected, and the result is in file order.
+         */
+        std::vector<std::uint32_t> select_blocks(const std::vector<Block> &blocks, const Envelope &bbox);
+
+        /// Write a new PBF file with the raw data of the selected blocks of the input file
+        void extract_blocks(const std::string &input_file, const std::vector<Block> &blocks, const std::vector<std::uint32_t> &selected, const std::string &output_file);
+
+        /**
+         * Create a temporary extract of the input file for the bounding box if the input has an up-to-date index.
+         * Returns the name of the extract (which should be removed after use) or an empty string.
+         */
+        std::string prepare_extract(const std::string &input_file, const osmium::Box &bbox, std::ostream &logger = std::cout);
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_BLOCK_INDEX_HPP
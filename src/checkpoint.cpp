@@ -0,0 +1,347 @@
+#include "checkpoint.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+namespace rustymon {
+
+    namespace checkpoint {
+
+        static const char DELTA_MAGIC[8] = {'R', 'S', 'T', 'Y', 'C', 'K', 'P', 'T'};
+        static const std::uint32_t DELTA_VERSION = 4;
+
+        namespace {
+
+            template<typename T>
+            void write_value(std::ostream &stream, const T &value) {
+                stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+            }
+
+            template<typename T>
+            T read_value(std::istream &stream) {
+                T value{};
+                stream.read(reinterpret_cast<char *>(&value), sizeof(T));
+                return value;
+            }
+
+            void write_points(std::ostream &stream, const std::vector<std::pair<double, double>> &points) {
+                write_value(stream, static_cast<std::uint32_t>(points.size()));
+                for (const std::pair<double, double> &point: points) {
+                    write_value(stream, point.first);
+                    write_value(stream, point.second);
+                }
+            }
+
+            std::vector<std::pair<double, double>> read_points(std::istream &stream) {
+                std::vector<std::pair<double, double>> points(read_value<std::uint32_t>(stream));
+                for (std::pair<double, double> &point: points) {
+                    point.first = read_value<double>(stream);
+                    point.second = read_value<double>(stream);
+                }
+                return points;
+            }
+
+        }
+
+        void write_tile(std::ostream &stream, const int x, const int y, const structs::Tile &tile) {
+            write_value(stream, static_cast<std::int32_t>(x));
+            write_value(stream, static_cast<std::int32_t>(y));
+            write_value(stream, tile.bbox.bottom_left.first);
+            write_value(stream, tile.bbox.bottom_left.second);
+            write_value(stream, tile.bbox.top_right.first);
+            write_value(stream, tile.bbox.top_right.second);
+
+            write_value(stream, static_cast<std::uint32_t>(tile.poi.size()));
+            for (const structs::POI &poi: tile.poi) {
+                write_value(stream, static_cast<std::int64_t>(poi.oid));
+                write_value(stream, static_cast<std::int32_t>(poi.type));
+                write_value(stream, poi.pos.first);
+                write_value(stream, poi.pos.second);
+                write_value(stream, poi.spawns.mask());
+            }
+
+            write_value(stream, static_cast<std::uint32_t>(tile.streets.size()));
+            for (const structs::Street &street: tile.streets) {
+                write_value(stream, static_cast<std::int64_t>(street.oid));
+                write_value(stream, static_cast<std::int32_t>(street.type));
+                write_points(stream, street.waypoints);
+            }
+
+            write_value(stream, static_cast<std::uint32_t>(tile.areas.size()));
+            for (const structs::Area &area: tile.areas) {
+                write_value(stream, static_cast<std::int64_t>(area.oid));
+                write_value(stream, static_cast<std::int32_t>(area.type));
+                write_points(stream, area.border);
+                write_value(stream, area.spawns.mask());
+                write_value(stream, static_cast<std::uint32_t>(area.holes.size()));
+                for (const std::vector<std::pair<double, double>> &hole: area.holes) {
+                    write_points(stream, hole);
+                }
+            }
+
+            write_value(stream, static_cast<std::uint32_t>(tile.covering.size()));
+            for (const structs::AreaRef &ref: tile.covering) {
+                write_value(stream, static_cast<std::int64_t>(ref.oid));
+                write_value(stream, static_cast<std::int32_t>(ref.type));
+                write_value(stream, ref.spawns.mask());
+            }
+        }
+
+        void read_tiles(std::istream &stream, structs::World &world) {
+            char magic[sizeof(DELTA_MAGIC)];
+            stream.read(magic, sizeof(magic));
+            if (!stream || std::memcmp(magic, DELTA_MAGIC, sizeof(magic)) != 0 || read_value<std::uint32_t>(stream) != DELTA_VERSION) {
+                throw std::runtime_error("invalid checkpoint file");
+            }
+
+            const auto tile_count = read_value<std::uint64_t>(stream);
+            for (std::uint64_t i = 0; i < tile_count && stream; i++) {
+                const int x = read_value<std::int32_t>(stream);
+                const int y = read_value<std::int32_t>(stream);
+                const auto x1 = read_value<double>(stream);
+                const auto y1 = read_value<double>(stream);
+                const auto x2 = read_value<double>(stream);
+                const auto y2 = read_value<double>(stream);
+                structs::Tile tile{structs::BoundingBox(x1, y1, x2, y2), {}, {}, {}};
+
+                const auto poi_count = read_value<std::uint32_t>(stream);
+                tile.poi.reserve(poi_count);
+                for (std::uint32_t j = 0; j < poi_count; j++) {
+                    const auto oid = read_value<std::int64_t>(stream);
+                    const auto type = read_value<std::int32_t>(stream);
+                    const auto lon = read_value<double>(stream);
+                    const auto lat = read_value<double>(stream);
+                    tile.poi.push_back(structs::POI{oid, type, std::pair<double, double>{lon, lat}, SpawnSet{read_value<std::uint64_t>(stream)}});
+                }
+
+                const auto streets_count = read_value<std::uint32_t>(stream);
+                tile.streets.reserve(streets_count);
+                for (std::uint32_t j = 0; j < streets_count; j++) {
+                    const auto oid = read_value<std::int64_t>(stream);
+                    const auto type = read_value<std::int32_t>(stream);
+                    tile.streets.push_back(structs::Street{oid, type, read_points(stream)});
+                }
+
+                const auto areas_count = read_value<std::uint32_t>(stream);
+                tile.areas.reserve(areas_count);
+                for (std::uint32_t j = 0; j < areas_count; j++) {
+                    const auto oid = read_value<std::int64_t>(stream);
+                    const auto type = read_value<std::int32_t>(stream);
+                    std::vector<std::pair<double, double>> border = read_points(stream);
+                    const SpawnSet spawns{read_value<std::uint64_t>(stream)};
+                    std::vector<std::vector<std::pair<double, double>>> holes(read_value<std::uint32_t>(stream));
+                    for (std::vector<std::pair<double, double>> &hole: holes) {
+                        hole = read_points(stream);
+                    }
+                    tile.areas.push_back(structs::Area{oid, type, std::move(border), spawns, std::move(holes)});
+                }
+
+                const auto covering_count = read_value<std::uint32_t>(stream);
+                tile.covering.reserve(covering_count);
+                for (std::uint32_t j = 0; j < covering_count; j++) {
+                    const auto oid = read_value<std::int64_t>(stream);
+                    const auto type = read_value<std::int32_t>(stream);
+                    tile.covering.push_back(structs::AreaRef{oid, type, SpawnSet{read_value<std::uint64_t>(stream)}});
+                }
+
+                // Later deltas contain newer versions of the same tile
+                world[x].erase(y);
+                world[x].insert(std::pair<int, structs::Tile>{y, std::move(tile)});
+            }
+            if (!stream) {
+                throw std::runtime_error("truncated checkpoint file");
+            }
+        }
+
+        Checkpointer::Checkpointer(std::string directory, const int interval_seconds, std::ostream &logger) :
+                directory(std::move(directory)),
+                interval(std::chrono::seconds(interval_seconds)),
+                last_checkpoint(std::chrono::steady_clock::now()),
+                logger(logger) {
+            if (mkdir(this->directory.c_str(), 0755) != 0 && errno != EEXIST) {
+                std::cerr << "Failed to create the checkpoint directory " << this->directory << ": " << std::strerror(errno) << "." << std::endl;
+                exit(1);
+            }
+        }
+
+        Checkpointer::~Checkpointer() {
+            if (writer.joinable()) {
+                writer.join();
+            }
+        }
+
+        std::string Checkpointer::state_filename() const {
+            return directory + "/state";
+        }
+
+        std::string Checkpointer::delta_filename(const std::uint64_t sequence) const {
+            return directory + "/delta-" + std::to_string(sequence) + ".bin";
+        }
+
+        State Checkpointer::restore(structs::World &world) {
+            std::ifstream state_stream(state_filename());
+            if (!state_stream.is_open()) {
+                logger << "No checkpoint found in " << directory << ", starting from scratch." << std::endl;
+                return state;
+            }
+            State loaded{0, Position{0, 0}, false};
+            int complete = 0;
+            state_stream >> loaded.sequence >> loaded.position.type >> loaded.position.id >> complete;
+            if (!state_stream) {
+                std::cerr << "Invalid checkpoint state file in " << directory << "." << std::endl;
+                exit(1);
+            }
+            loaded.complete = complete != 0;
+
+            for (std::uint64_t i = 0; i < loaded.sequence; i++) {
+                std::ifstream delta_stream(delta_filename(i), std::ifstream::binary);
+                try {
+                    read_tiles(delta_stream, world);
+                } catch (std::runtime_error &error) {
+                    std::cerr << "Failed to restore checkpoint " << delta_filename(i) << ": " << error.what() << std::endl;
+                    exit(1);
+                }
+            }
+
+            state = loaded;
+            logger << "Restored " << state.sequence << " checkpoints from " << directory
+                   << (state.complete ? " (input completely read)." : ".") << std::endl;
+            return state;
+        }
+
+        void Checkpointer::clear() {
+            // Deltas are only read up to the sequence of the state file, so that is removed first
+            const std::string state_file = state_filename();
+            if (std::remove(state_file.c_str()) != 0 && errno != ENOENT) {
+                std::cerr << "Failed to remove the checkpoint state " << state_file << ": " << std::strerror(errno) << "." << std::endl;
+                exit(1);
+            }
+            std::uint64_t removed = 0;
+            while (std::remove(delta_filename(removed).c_str()) == 0) {
+                removed++;
+            }
+            if (removed > 0) {
+                logger << "Removed " << removed << " checkpoints of an earlier run from " << directory << "." << std::endl;
+            }
+        }
+
+        void Checkpointer::write_delta(std::vector<std::pair<std::pair<int, int>, structs::Tile>> tiles, const State new_state) {
+            if (!write_delta_files(tiles, new_state)) {
+                write_failed = true;
+                for (const auto &tile: tiles) {
+                    unsaved_tiles.push_back(tile.first);
+                }
+            }
+            writing.store(false);
+        }
+
+        bool Checkpointer::write_delta_files(const std::vector<std::pair<std::pair<int, int>, structs::Tile>> &tiles, const State &new_state) {
+            const std::string filename = delta_filename(new_state.sequence - 1);
+            std::ofstream delta_stream(filename + ".tmp", std::ofstream::binary | std::ofstream::trunc);
+            delta_stream.write(DELTA_MAGIC, sizeof(DELTA_MAGIC));
+            write_value(delta_stream, DELTA_VERSION);
+            write_value(delta_stream, static_cast<std::uint64_t>(tiles.size()));
+            for (const auto &tile: tiles) {
+                write_tile(delta_stream, tile.first.first, tile.first.second, tile.second);
+            }
+            delta_stream.close();
+            if (!delta_stream || std::rename((filename + ".tmp").c_str(), filename.c_str()) != 0) {
+                std::cerr << "Failed to write the checkpoint " << filename << "." << std::endl;
+                return false;
+            }
+
+            // The state file references the new delta only after it has been written completely
+            const std::string state_file = state_filename();
+            std::ofstream state_stream(state_file + ".tmp", std::ofstream::trunc);
+            state_stream << new_state.sequence << " " << new_state.position.type << " " << new_state.position.id
+                         << " " << (new_state.complete ? 1 : 0) << std::endl;
+            state_stream.close();
+            if (!state_stream || std::rename((state_file + ".tmp").c_str(), state_file.c_str()) != 0) {
+                std::cerr << "Failed to update the checkpoint state in " << directory << "." << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        bool Checkpointer::save(const structs::World &world, const std::vector<std::pair<int, int>> &changed_tiles, const Position position, const bool complete, const bool wait) {
+            if (writer.joinable()) {
+                writer.join();
+            }
+
+            std::vector<std::pair<int, int>> positions = changed_tiles;
+            if (write_failed) {
+                // The state file still references the deltas before the failed one, so that one is written again
+                write_failed = false;
+                state.sequence--;
+                positions.insert(positions.end(), unsaved_tiles.begin(), unsaved_tiles.end());
+                std::vector<std::pair<int, int>>().swap(unsaved_tiles);
+                std::sort(positions.begin(), positions.end());
+                positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+            }
+
+            std::vector<std::pair<std::pair<int, int>, structs::Tile>> tiles;
+            tiles.reserve(positions.size());
+            for (const std::pair<int, int> &position_of_tile: positions) {
+                tiles.emplace_back(position_of_tile, world.at(position_of_tile.first).at(position_of_tile.second));
+            }
+
+            state.sequence++;
+            state.position = position;
+            state.complete = complete;
+            last_checkpoint = std::chrono::steady_clock::now();
+            writing.store(true);
+            writer = std::thread(&Checkpointer::write_delta, this, std::move(tiles), state);
+            if (wait) {
+                writer.join();
+                return !write_failed;
+            }
+            return true;
+        }
+
+        ExportJournal::ExportJournal(const std::string &directory, const bool resume) {
+            const std::string filename = directory + "/export.journal";
+            if (resume) {
+                std::ifstream input(filename);
+                std::string line;
+                while (std::getline(input, line)) {
+                    int x;
+                    int y;
+                    int level = 0;
+                    if (std::sscanf(line.c_str(), "%d,%d,%d", &x, &y, &level) >= 2) {
+                        exported.insert(std::make_tuple(x, y, level));
+                    }
+                }
+                output.open(filename, std::ofstream::app);
+            } else {
+                output.open(filename, std::ofstream::trunc);
+            }
+            if (!output.is_open()) {
+                std::cerr << "Failed to open the export journal " << filename << "." << std::endl;
+                exit(1);
+            }
+        }
+
+        bool ExportJournal::contains(const int x, const int y, const int level) {
+            std::unique_lock<std::mutex> lock(mutex);
+            return exported.count(std::make_tuple(x, y, level)) > 0;
+        }
+
+        void ExportJournal::record(const int x, const int y, const int level) {
+            std::unique_lock<std::mutex> lock(mutex);
+            exported.insert(std::make_tuple(x, y, level));
+            output << x << "," << y;
+            if (level != 0) {
+                output << "," << level;
+            }
+            output << "\n" << std::flush;
+        }
+
+    }
+
+}
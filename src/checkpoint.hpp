@@ -0,0 +1,143 @@
+#ifndef WORLD_GENERATOR_CHECKPOINT_HPP
+#define WORLD_GENERATOR_CHECKPOINT_HPP
+
+#include <set>
+#include <tuple>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+
+#include "structs.hpp"
+
+namespace rustymon {
+
+    namespace checkpoint {
+
+        /**
+         * Position in a sorted input file: the type (as osmium::item_type) and ID
+         * of the last object whose processing has been completed
+         */
+        struct Position {
+            std::uint16_t type;
+            std::int64_t id;
+
+            inline bool valid() const {
+                return type != 0;
+            }
+
+            inline bool operator < (const Position &other) const {
+                return type < other.type || (type == other.type && id < other.id);
+            }
+
+            inline bool operator <= (const Position &other) const {
+                return !(other < *this);
+            }
+        };
+
+        struct State {
+            /// Number of delta files written so far
+            std::uint64_t sequence;
+            Position position;
+            /// Whether the input file has been read completely
+            bool complete;
+        };
+
+        void write_tile(std::ostream &stream, int x, int y, const structs::Tile &tile);
+
+        void read_tiles(std::istream &stream, structs::World &world);
+
+        /**
+         * Writer of periodic checkpoints of the world into a directory. Every checkpoint is a delta
+         * file with all tiles changed since the previous checkpoint, followed by an update of the
+         * state file. The delta is copied on the calling thread and written in the background, so
+         * checkpointing only stalls the generator while copying the changed tiles.
+         */
+        class Checkpointer {
+            const std::string directory;
+            const std::chrono::seconds interval;
+            std::chrono::steady_clock::time_point last_checkpoint;
+            State state{0, Position{0, 0}, false};
+            std::thread writer;
+            std::atomic<bool> writing{false};
+            /// Set by the writer if the last checkpoint failed, its tiles are saved again with the next one
+            bool write_failed = false;
+            std::vector<std::pair<int, int>> unsaved_tiles;
+            std::ostream &logger;
+
+            std::string state_filename() const;
+
+            std::string delta_filename(std::uint64_t sequence) const;
+
+            /// Write the delta and update the state file, returning false on failure
+            bool write_delta_files(const std::vector<std::pair<std::pair<int, int>, structs::Tile>> &tiles, const State &new_state);
+
+            void write_delta(std::vector<std::pair<std::pair<int, int>, structs::Tile>> tiles, State new_state);
+
+        public:
+
+            Checkpointer(std::string directory, int interval_seconds, std::ostream &logger = std::cout);
+
+            Checkpointer(const Checkpointer &) = delete;
+            Checkpointer& operator = (const Checkpointer &) = delete;
+
+            ~Checkpointer();
+
+            inline const std::string &get_directory() const {
+                return directory;
+            }
+
+            /// Check whether the interval has passed and the previous checkpoint has been written
+            inline bool due() const {
+                return !writing.load() && std::chrono::steady_clock::now() - last_checkpoint >= interval;
+            }
+
+            /// Load all checkpoints from the directory into the world, returning the last state
+            State restore(structs::World &world);
+
+            /// Remove the checkpoints of an earlier run from the directory, so they can't be mixed with the new ones
+            void clear();
+
+            /**
+             * Start writing a checkpoint with the given changed tiles in the background.
+             * This waits for the previous checkpoint to be written first, so check `due()` before.
+             * If the previous checkpoint failed, it's replaced by this one including its tiles.
+             * If `wait` is set, the call returns after the checkpoint has been written, false if that failed.
+             */
+            bool save(const structs::World &world, const std::vector<std::pair<int, int>> &changed_tiles, Position position, bool complete, bool wait = false);
+        };
+
+        /**
+         * Append-only journal of the tiles which were exported successfully, one line "x,y" per tile
+         * of level 0 and "x,y,level" for tiles of other levels
+         */
+        class ExportJournal {
+            std::mutex mutex;
+            std::set<std::tuple<int, int, int>> exported;
+            std::ofstream output;
+
+        public:
+
+            /// Open the journal in the given directory, loading its entries if `resume` is set
+            ExportJournal(const std::string &directory, bool resume);
+
+            bool contains(int x, int y, int level = 0);
+
+            void record(int x, int y, int level = 0);
+
+            inline std::size_t size() {
+                std::unique_lock<std::mutex> lock(mutex);
+                return exported.size();
+            }
+        };
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_CHECKPOINT_HPP
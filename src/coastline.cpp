@@ -0,0 +1,520 @@
+#include "coastline.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+#include "constants.hpp"
+
+namespace rustymon {
+
+    namespace coastline {
+
+        static const std::uint32_t NO_WAY = UINT32_MAX;
+
+        namespace {
+
+            inline int cell_of(const double coordinate, const int size_factor) {
+                return static_cast<int>(std::floor(coordinate * size_factor / COASTLINE_CELL_TILES));
+            }
+
+            void close_ring(geometry::Ring &ring) {
+                if (!ring.empty() && ring.front() != ring.back()) {
+                    ring.push_back(ring.front());
+                }
+            }
+
+            /// Part of a coastline run inside a tile, starting and ending on the tile border
+            struct Piece {
+                geometry::Ring points;
+                double start;
+                double end;
+            };
+
+        }
+
+        bool is_coastline(const osmium::Way &way) {
+            const char *natural = way.tags().get_value_by_key("natural");
+            return natural != nullptr && std::strcmp(natural, "coastline") == 0;
+        }
+
+        void Coastline::way(const osmium::Way &way) {
+            if (!enabled || way.nodes().size() < 2 || !is_coastline(way)) {
+                return;
+            }
+
+            Way entry{points.size(), 0, way.nodes().front().ref(), way.nodes().back().ref(), 0, 0};
+            for (const osmium::NodeRef &node: way.nodes()) {
+                if (node.location().valid() && (points.size() == entry.first || points.back() != node.location())) {
+                    points.push_back(node.location());
+                }
+            }
+            entry.count = static_cast<std::uint32_t>(points.size() - entry.first);
+            if (entry.count < 2) {
+                points.resize(entry.first);
+                return;
+            }
+            ways.push_back(entry);
+        }
+
+        void Coastline::join_ways() {
+            std::unordered_map<osmium::object_id_type, std::uint32_t> starts;
+            starts.reserve(ways.size());
+            for (std::uint32_t i = 0; i < ways.size(); i++) {
+                starts.emplace(ways[i].first_node, i);
+            }
+
+            std::vector<std::uint32_t> next(ways.size(), NO_WAY);
+            std::vector<bool> has_previous(ways.size(), false);
+            for (std::uint32_t i = 0; i < ways.size(); i++) {
+                auto it = starts.find(ways[i].last_node);
+                if (it != starts.end() && it->second != i && !has_previous[it->second]) {
+                    next[i] = it->second;
+                    has_previous[it->second] = true;
+                }
+            }
+
+            std::vector<bool> visited(ways.size(), false);
+            auto follow = [this, &next, &visited](const std::uint32_t start) {
+                const auto chain = static_cast<std::uint32_t>(chains.size());
+                std::uint32_t sequence = 0;
+                std::uint32_t last = start;
+                for (std::uint32_t way = start; way != NO_WAY && !visited[way]; way = next[way]) {
+                    visited[way] = true;
+                    ways[way].chain = chain;
+                    ways[way].sequence = sequence++;
+                    last = way;
+                }
+                chains.push_back(Chain{sequence, ways[last].last_node == ways[start].first_node});
+            };
+
+            // Open chains start at a way without predecessor, all remaining ways belong to rings
+            for (std::uint32_t i = 0; i < ways.size(); i++) {
+                if (!has_previous[i] && !visited[i]) {
+                    follow(i);
+                }
+            }
+            for (std::uint32_t i = 0; i < ways.size(); i++) {
+                if (!visited[i]) {
+                    follow(i);
+                }
+            }
+        }
+
+        void Coastline::build_cells() {
+            for (std::uint32_t w = 0; w < ways.size(); w++) {
+                const Way &way = ways[w];
+                for (std::uint32_t p = 0; p + 1 < way.count; p++) {
+                    const geometry::Point a = point(way.first + p);
+                    const geometry::Point b = point(way.first + p + 1);
+                    const int min_col = cell_of(std::min(a.first, b.first), x_size_factor);
+                    const int max_col = cell_of(std::max(a.first, b.first), x_size_factor);
+                    const int min_row = cell_of(std::min(a.second, b.second), y_size_factor);
+                    const int max_row = cell_of(std::max(a.second, b.second), y_size_factor);
+                    for (int row = min_row; row <= max_row; row++) {
+                        std::map<int, std::vector<SegmentRef>> &columns = cells[row];
+                        for (int col = min_col; col <= max_col; col++) {
+                            columns[col].push_back(SegmentRef{w, p});
+                        }
+                    }
+                }
+            }
+        }
+
+        void Coastline::prepare(const int x_size_factor, const int y_size_factor) {
+            this->x_size_factor = x_size_factor;
+            this->y_size_factor = y_size_factor;
+            chains.clear();
+            cells.clear();
+            points.shrink_to_fit();
+            ways.shrink_to_fit();
+            join_ways();
+            build_cells();
+        }
+
+        std::vector<Coastline::SegmentRef> Coastline::segments_in(const structs::BoundingBox &box) const {
+            std::vector<SegmentRef> result;
+            const double center_x = (box.bottom_left.first + box.top_right.first) / 2;
+            const double center_y = (box.bottom_left.second + box.top_right.second) / 2;
+            auto row = cells.find(cell_of(center_y, y_size_factor));
+            if (row == cells.end()) {
+                return result;
+            }
+            auto cell = row->second.find(cell_of(center_x, x_size_factor));
+            if (cell == row->second.end()) {
+                return result;
+            }
+
+            for (const SegmentRef &ref: cell->second) {
+                const geometry::Point a = point(ways[ref.way].first + ref.point);
+                const geometry::Point b = point(ways[ref.way].first + ref.point + 1);
+                if (std::max(a.first, b.first) >= box.bottom_left.first && std::min(a.first, b.first) <= box.top_right.first &&
+                        std::max(a.second, b.second) >= box.bottom_left.second && std::min(a.second, b.second) <= box.top_right.second) {
+                    result.push_back(ref);
+                }
+            }
+            return result;
+        }
+
+        bool Coastline::is_water(const geometry::Point &position) const {
+            const int row = cell_of(position.second, y_size_factor);
+            const int col = cell_of(position.first, x_size_factor);
+            const double cell_width = static_cast<double>(COASTLINE_CELL_TILES) / x_size_factor;
+            const double cell_height = static_cast<double>(COASTLINE_CELL_TILES) / y_size_factor;
+
+            // Nearest crossing of a ray from the point with the coastline; the ray runs along
+            // the latitude of the point (horizontal) or along its longitude (vertical)
+            bool found = false;
+            double best = 0;
+            bool best_increasing = false;
+            auto check = [this, &position, &found, &best, &best_increasing](const std::vector<SegmentRef> &refs, const bool horizontal, const bool forward) {
+                for (const SegmentRef &ref: refs) {
+                    geometry::Point a = point(ways[ref.way].first + ref.point);
+                    geometry::Point b = point(ways[ref.way].first + ref.point + 1);
+                    geometry::Point origin = position;
+                    if (!horizontal) {
+                        std::swap(a.first, a.second);
+                        std::swap(b.first, b.second);
+                        std::swap(origin.first, origin.second);
+                    }
+                    if ((a.second <= origin.second) == (b.second <= origin.second)) {
+                        continue;
+                    }
+                    const double crossing = a.first + (origin.second - a.second) * (b.first - a.first) / (b.second - a.second);
+                    if (forward ? (crossing >= origin.first && (!found || crossing < best)) : (crossing < origin.first && (!found || crossing > best))) {
+                        found = true;
+                        best = crossing;
+                        best_increasing = b.second > a.second;
+                    }
+                }
+            };
+
+            // Land is on the left side of the coastline: a coastline running north east of
+            // the point means land, a coastline running north west of it sea
+            auto row_it = cells.find(row);
+            if (row_it != cells.end()) {
+                const std::map<int, std::vector<SegmentRef>> &columns = row_it->second;
+                for (auto it = columns.lower_bound(col); it != columns.end() && !(found && it->first * cell_width > best); ++it) {
+                    check(it->second, true, true);
+                }
+                if (found) {
+                    return !best_increasing;
+                }
+                for (auto it = std::map<int, std::vector<SegmentRef>>::const_reverse_iterator(columns.upper_bound(col));
+                        it != columns.rend() && !(found && (it->first + 1) * cell_width < best); ++it) {
+                    check(it->second, true, false);
+                }
+                if (found) {
+                    return best_increasing;
+                }
+            }
+
+            // No coastline at this latitude (e.g. the southern ocean), so look north and south:
+            // a coastline running east south of the point means land, one north of it sea
+            for (auto it = std::map<int, std::map<int, std::vector<SegmentRef>>>::const_reverse_iterator(cells.upper_bound(row));
+                    it != cells.rend() && !(found && (it->first + 1) * cell_height < best); ++it) {
+                auto cell = it->second.find(col);
+                if (cell != it->second.end()) {
+                    check(cell->second, false, false);
+                }
+            }
+            if (found) {
+                return !best_increasing;
+            }
+            for (auto it = cells.lower_bound(row); it != cells.end() && !(found && it->first * cell_height > best); ++it) {
+                auto cell = it->second.find(col);
+                if (cell != it->second.end()) {
+                    check(cell->second, false, true);
+                }
+            }
+            return found && best_increasing;
+        }
+
+        std::vector<std::pair<int, int>> Coastline::crossed_tiles(const structs::BoundingBox &bbox) const {
+            std::vector<std::pair<int, int>> result;
+            const int min_x = static_cast<int>(std::floor(bbox.bottom_left.first * x_size_factor));
+            const int min_y = static_cast<int>(std::floor(bbox.bottom_left.second * y_size_factor));
+            const int max_x = static_cast<int>(std::ceil(bbox.top_right.first * x_size_factor)) - 1;
+            const int max_y = static_cast<int>(std::ceil(bbox.top_right.second * y_size_factor)) - 1;
+
+            for (const Way &way: ways) {
+                for (std::uint32_t p = 0; p + 1 < way.count; p++) {
+                    const geometry::Point a = point(way.first + p);
+                    const geometry::Point b = point(way.first + p + 1);
+                    const int x1 = std::max(min_x, static_cast<int>(std::floor(std::min(a.first, b.first) * x_size_factor)));
+                    const int x2 = std::min(max_x, static_cast<int>(std::floor(std::max(a.first, b.first) * x_size_factor)));
+                    const int y1 = std::max(min_y, static_cast<int>(std::floor(std::min(a.second, b.second) * y_size_factor)));
+                    const int y2 = std::min(max_y, static_cast<int>(std::floor(std::max(a.second, b.second) * y_size_factor)));
+                    for (int x = x1; x <= x2; x++) {
+                        for (int y = y1; y <= y2; y++) {
+                            const structs::BoundingBox tile(
+                                    static_cast<double>(x) / x_size_factor,
+                                    static_cast<double>(y) / y_size_factor,
+                                    (static_cast<double>(x) + 1) / x_size_factor,
+                                    (static_cast<double>(y) + 1) / y_size_factor
+                            );
+                            geometry::Point clipped_a = a;
+                            geometry::Point clipped_b = b;
+                            double entry, exit;
+                            if (geometry::clip_segment(tile, clipped_a, clipped_b, entry, exit)) {
+                                result.emplace_back(x, y);
+                            }
+                        }
+                    }
+                }
+            }
+
+            std::sort(result.begin(), result.end());
+            result.erase(std::unique(result.begin(), result.end()), result.end());
+            return result;
+        }
+
+        std::vector<Polygon> Coastline::water_polygons(const structs::BoundingBox &tile) const {
+            std::vector<Polygon> result;
+            std::vector<SegmentRef> refs = segments_in(tile);
+
+            if (refs.empty()) {
+                const geometry::Point center{
+                        (tile.bottom_left.first + tile.top_right.first) / 2,
+                        (tile.bottom_left.second + tile.top_right.second) / 2
+                };
+                if (is_water(center)) {
+                    result.push_back(Polygon{geometry::box_ring(tile), {}});
+                }
+                return result;
+            }
+
+            // Sorting by chain and position in the chain turns the segments into consecutive runs
+            std::sort(refs.begin(), refs.end(), [this](const SegmentRef &a, const SegmentRef &b) {
+                const Way &way_a = ways[a.way];
+                const Way &way_b = ways[b.way];
+                if (way_a.chain != way_b.chain) {
+                    return way_a.chain < way_b.chain;
+                }
+                if (way_a.sequence != way_b.sequence) {
+                    return way_a.sequence < way_b.sequence;
+                }
+                return a.point < b.point;
+            });
+
+            struct Run {
+                geometry::Ring points;
+                std::uint32_t chain;
+                bool chain_start;
+                bool chain_end;
+            };
+            std::vector<Run> runs;
+            for (std::size_t i = 0; i < refs.size(); i++) {
+                const SegmentRef &ref = refs[i];
+                const Way &way = ways[ref.way];
+                bool continues = false;
+                if (i > 0) {
+                    const SegmentRef &previous = refs[i - 1];
+                    const Way &previous_way = ways[previous.way];
+                    continues = previous_way.chain == way.chain && (
+                            (previous.way == ref.way && previous.point + 1 == ref.point) ||
+                            (previous_way.sequence + 1 == way.sequence && previous.point + 2 == previous_way.count && ref.point == 0)
+                    );
+                }
+                if (!continues) {
+                    runs.push_back(Run{geometry::Ring{point(way.first + ref.point)}, way.chain, way.sequence == 0 && ref.point == 0, false});
+                }
+                runs.back().points.push_back(point(way.first + ref.point + 1));
+                runs.back().chain_end = way.sequence + 1 == chains[way.chain].ways && ref.point + 2 == way.count;
+            }
+
+            // Runs of closed chains may wrap around the end of the chain
+            for (Run &run: runs) {
+                if (!run.chain_end || run.chain_start || !chains[run.chain].closed) {
+                    continue;
+                }
+                for (Run &other: runs) {
+                    if (&other != &run && other.chain == run.chain && other.chain_start && !other.points.empty()) {
+                        run.points.insert(run.points.end(), other.points.begin() + 1, other.points.end());
+                        run.chain_start = false;
+                        run.chain_end = false;
+                        other.points.clear();
+                        break;
+                    }
+                }
+            }
+
+            std::vector<Piece> pieces;
+            std::vector<geometry::Ring> rings;
+            auto finish = [&tile, &pieces](geometry::Ring &points) {
+                points.erase(std::unique(points.begin(), points.end()), points.end());
+                if (points.size() < 2) {
+                    points.clear();
+                    return;
+                }
+                // Broken coastlines end inside the tile, they are connected to the nearest border point
+                if (!geometry::on_border(tile, points.front())) {
+                    points.insert(points.begin(), geometry::nearest_border_point(tile, points.front()));
+                }
+                if (!geometry::on_border(tile, points.back())) {
+                    points.push_back(geometry::nearest_border_point(tile, points.back()));
+                }
+                const double start = geometry::border_position(tile, points.front());
+                const double end = geometry::border_position(tile, points.back());
+                pieces.push_back(Piece{std::move(points), start, end});
+            };
+
+            for (Run &run: runs) {
+                if (run.points.size() < 2) {
+                    continue;
+                }
+                const bool ring = run.chain_start && run.chain_end && chains[run.chain].closed;
+                bool clipped = false;
+                std::vector<geometry::Ring> parts;
+                geometry::Ring current;
+                for (std::size_t i = 0; i + 1 < run.points.size(); i++) {
+                    geometry::Point a = run.points[i];
+                    geometry::Point b = run.points[i + 1];
+                    double entry, exit;
+                    if (!geometry::clip_segment(tile, a, b, entry, exit)) {
+                        clipped = true;
+                        if (!current.empty()) {
+                            parts.push_back(std::move(current));
+                            current.clear();
+                        }
+                        continue;
+                    }
+                    if (entry > 0 || exit < 1) {
+                        clipped = true;
+                    }
+                    if (!current.empty() && entry > 0) {
+                        parts.push_back(std::move(current));
+                        current.clear();
+                    }
+                    if (current.empty()) {
+                        current.push_back(a);
+                    }
+                    current.push_back(b);
+                    if (exit < 1) {
+                        parts.push_back(std::move(current));
+                        current.clear();
+                    }
+                }
+                if (!current.empty()) {
+                    parts.push_back(std::move(current));
+                }
+
+                if (ring && !clipped) {
+                    rings.push_back(std::move(parts.front()));
+                    continue;
+                }
+                // A ring leaving the tile starts and ends in the same part
+                if (ring && parts.size() > 1 && parts.front().front() == parts.back().back()) {
+                    parts.back().insert(parts.back().end(), parts.front().begin() + 1, parts.front().end());
+                    parts.erase(parts.begin());
+                }
+                for (geometry::Ring &part: parts) {
+                    finish(part);
+                }
+            }
+
+            if (pieces.empty()) {
+                // The tile border doesn't cross the coastline, so one corner decides for the whole border
+                const double nudge = (tile.top_right.first - tile.bottom_left.first) * 1e-6;
+                if (is_water(geometry::Point{tile.bottom_left.first + nudge, tile.bottom_left.second + nudge})) {
+                    result.push_back(Polygon{geometry::box_ring(tile), {}});
+                }
+            }
+
+            // The sea is on the right side of every piece; from the end of a piece the border is
+            // followed clockwise to the start of the next piece until the polygon is closed
+            std::vector<bool> used(pieces.size(), false);
+            for (std::size_t i = 0; i < pieces.size(); i++) {
+                if (used[i]) {
+                    continue;
+                }
+                geometry::Ring border;
+                std::size_t current = i;
+                for (std::size_t steps = 0; steps <= pieces.size(); steps++) {
+                    used[current] = true;
+                    for (const geometry::Point &p: pieces[current].points) {
+                        if (border.empty() || border.back() != p) {
+                            border.push_back(p);
+                        }
+                    }
+
+                    const double position = pieces[current].end;
+                    std::size_t next = i;
+                    double distance = 4;
+                    for (std::size_t j = 0; j < pieces.size(); j++) {
+                        if (used[j] && j != i) {
+                            continue;
+                        }
+                        double d = pieces[j].start - position;
+                        if (d < 0) {
+                            d += 4;
+                        }
+                        if (d < distance) {
+                            distance = d;
+                            next = j;
+                        }
+                    }
+                    for (int corner = static_cast<int>(std::floor(position)) + 1; corner < position + distance; corner++) {
+                        border.push_back(geometry::border_corner(tile, corner));
+                    }
+                    if (next == i) {
+                        break;
+                    }
+                    current = next;
+                }
+                close_ring(border);
+                if (border.size() >= 4) {
+                    result.push_back(Polygon{std::move(border), {}});
+                }
+            }
+
+            // Closed rings inside the tile: islands (counter-clockwise) are holes of the
+            // surrounding water, clockwise rings enclose water surrounded by land
+            for (geometry::Ring &ring: rings) {
+                close_ring(ring);
+                if (ring.size() < 4) {
+                    continue;
+                }
+                Polygon *surrounding = nullptr;
+                for (Polygon &polygon: result) {
+                    if (geometry::contains(polygon.border, ring.front())) {
+                        surrounding = &polygon;
+                        break;
+                    }
+                }
+                if (geometry::signed_area(ring) > 0) {
+                    if (surrounding != nullptr) {
+                        surrounding->holes.push_back(std::move(ring));
+                    }
+                } else if (surrounding == nullptr) {
+                    result.push_back(Polygon{std::move(ring), {}});
+                }
+            }
+
+            for (Polygon &polygon: result) {
+                if (geometry::signed_area(polygon.border) < 0) {
+                    std::reverse(polygon.border.begin(), polygon.border.end());
+                }
+                for (geometry::Ring &hole: polygon.holes) {
+                    if (geometry::signed_area(hole) > 0) {
+                        std::reverse(hole.begin(), hole.end());
+                    }
+                }
+            }
+            return result;
+        }
+
+        std::size_t Coastline::used_memory() const {
+            std::size_t total = points.capacity() * sizeof(osmium::Location) + ways.capacity() * sizeof(Way) + chains.capacity() * sizeof(Chain);
+            for (const auto &row: cells) {
+                for (const auto &cell: row.second) {
+                    total += sizeof(cell) + cell.second.capacity() * sizeof(SegmentRef);
+                }
+            }
+            return total;
+        }
+
+    }
+
+}
@@ -0,0 +1,122 @@
+#ifndef WORLD_GENERATOR_COASTLINE_HPP
+#define WORLD_GENERATOR_COASTLINE_HPP
+
+#include <map>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+#include <osmium/handler.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/types.hpp>
+#include <osmium/osm/way.hpp>
+
+#include "geometry.hpp"
+#include "structs.hpp"
+
+/*
+ * Coastline stage: natural=coastline ways are stored in a compact form while reading the
+ * input (only their locations), joined into chains afterwards and indexed in coarse cells
+ * of COASTLINE_CELL_TILES x COASTLINE_CELL_TILES tiles. Land is always on the left side
+ * of a coastline way, so a tile can be classified without assembling whole continents:
+ * tiles without coastline segments are land or sea depending on the nearest coastline
+ * segment crossed by a horizontal ray, and only the segments crossing a tile are clipped
+ * into water polygons for it.
+ */
+
+namespace rustymon {
+
+    namespace coastline {
+
+        /// Check whether the way is part of the coastline (natural=coastline)
+        bool is_coastline(const osmium::Way &way);
+
+        struct Polygon {
+            geometry::Ring border;
+            std::vector<geometry::Ring> holes;
+        };
+
+        class Coastline : public osmium::handler::Handler {
+
+            struct Way {
+                /// Index of the first point in the list of all points and number of points
+                std::size_t first;
+                std::uint32_t count;
+                osmium::object_id_type first_node;
+                osmium::object_id_type last_node;
+                /// Chain of joined ways this way belongs to and its position in the chain
+                std::uint32_t chain;
+                std::uint32_t sequence;
+            };
+
+            struct Chain {
+                std::uint32_t ways;
+                bool closed;
+            };
+
+            /// Segment from the given point to the next point of the way
+            struct SegmentRef {
+                std::uint32_t way;
+                std::uint32_t point;
+            };
+
+            const bool enabled;
+            int x_size_factor = 1;
+            int y_size_factor = 1;
+
+            std::vector<osmium::Location> points;
+            std::vector<Way> ways;
+            std::vector<Chain> chains;
+            /// Segments by cell row (latitude) and cell column (longitude)
+            std::map<int, std::map<int, std::vector<SegmentRef>>> cells;
+
+            inline geometry::Point point(const std::size_t index) const {
+                return geometry::Point{points[index].lon_without_check(), points[index].lat_without_check()};
+            }
+
+            void join_ways();
+
+            void build_cells();
+
+            std::vector<SegmentRef> segments_in(const structs::BoundingBox &box) const;
+
+            bool is_water(const geometry::Point &point) const;
+
+        public:
+
+            explicit Coastline(bool enabled) : enabled(enabled) {}
+
+            void way(const osmium::Way &way);
+
+            /// Join the collected ways and build the index for the given tile size, must be called before querying
+            void prepare(int x_size_factor, int y_size_factor);
+
+            inline bool empty() const {
+                return ways.empty();
+            }
+
+            inline std::size_t way_count() const {
+                return ways.size();
+            }
+
+            inline std::size_t chain_count() const {
+                return chains.size();
+            }
+
+            /// Positions of all tiles within the bounding box which are crossed by a coastline
+            std::vector<std::pair<int, int>> crossed_tiles(const structs::BoundingBox &bbox) const;
+
+            /**
+             * Water polygons of the tile (the full tile for sea tiles, nothing for land tiles).
+             * Outer rings are counter-clockwise, holes clockwise. It's safe to call this concurrently.
+             */
+            std::vector<Polygon> water_polygons(const structs::BoundingBox &tile) const;
+
+            std::size_t used_memory() const;
+        };
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_COASTLINE_HPP
@@ -1,15 +1,40 @@
 #include "config.hpp"
 
+#include <limits>
+
+#include "enums.hpp"
+#include "spawns.hpp"
+
 namespace rustymon {
 
     namespace config {
 
         Config load_config_from_json(const Json::Value &data) {
             Workers workers{
+                .decode = data.get("workers", Json::objectValue).get("decode", rustymon::DECODE_DEFAULT_WORKER_THREADS).asInt(),
                 .node = data.get("workers", Json::objectValue).get("node", rustymon::NODE_DEFAULT_WORKER_THREADS).asInt(),
-                .way = data.get("workers", Json::objectValue).get("node", rustymon::WAY_DEFAULT_WORKER_THREADS).asInt(),
-                .area = data.get("workers", Json::objectValue).get("node", rustymon::AREA_DEFAULT_WORKER_THREADS).asInt(),
-                .upload = data.get("workers", Json::objectValue).get("node", rustymon::UPLOAD_DEFAULT_WORKER_THREADS).asInt()
+                .way = data.get("workers", Json::objectValue).get("way", rustymon::WAY_DEFAULT_WORKER_THREADS).asInt(),
+                .area = data.get("workers", Json::objectValue).get("area", rustymon::AREA_DEFAULT_WORKER_THREADS).asInt(),
+                .upload = data.get("workers", Json::objectValue).get("upload", rustymon::UPLOAD_DEFAULT_WORKER_THREADS).asInt(),
+                .serialize = data.get("workers", Json::objectValue).get("serialize", rustymon::SERIALIZE_DEFAULT_WORKER_THREADS).asInt()
+            };
+
+            Reader reader{
+                .input_queue = data.get("reader", Json::objectValue).get("input_queue", rustymon::READER_INPUT_QUEUE_DEFAULT).asInt(),
+                .osmdata_queue = data.get("reader", Json::objectValue).get("osmdata_queue", rustymon::READER_OSMDATA_QUEUE_DEFAULT).asInt(),
+                .work_queue = data.get("reader", Json::objectValue).get("work_queue", rustymon::READER_WORK_QUEUE_DEFAULT).asInt(),
+                .selective_locations = data.get("reader", Json::objectValue).get("selective_locations", rustymon::READER_SELECTIVE_LOCATIONS_DEFAULT).asBool()
+            };
+
+            Http http{
+                .async = data.get("http", Json::objectValue).get("async", rustymon::HTTP_ASYNC_DEFAULT).asBool(),
+                .event_threads = data.get("http", Json::objectValue).get("event_threads", rustymon::HTTP_EVENT_THREADS_DEFAULT).asInt(),
+                .in_flight = data.get("http", Json::objectValue).get("in_flight", rustymon::HTTP_MAX_IN_FLIGHT_DEFAULT).asInt(),
+                .connections = data.get("http", Json::objectValue).get("connections", rustymon::HTTP_MAX_CONNECTIONS_DEFAULT).asInt(),
+                .http2 = data.get("http", Json::objectValue).get("http2", rustymon::HTTP_HTTP2_DEFAULT).asBool(),
+                .retries = data.get("http", Json::objectValue).get("retries", rustymon::HTTP_MAX_RETRIES_DEFAULT).asInt(),
+                .pipelined = data.get("http", Json::objectValue).get("pipelined", rustymon::HTTP_PIPELINED_DEFAULT).asBool(),
+                .pipeline_queue = data.get("http", Json::objectValue).get("pipeline_queue", rustymon::HTTP_PIPELINE_QUEUE_DEFAULT).asInt()
             };
 
             Size size{
@@ -17,6 +42,49 @@ namespace rustymon {
                 .y = data.get("size", Json::objectValue).get("y", rustymon::Y_SIZE_FACTOR_DEFAULT).asInt()
             };
 
+            const Json::Value budget_data = data.get("memory", Json::objectValue).get("budget", rustymon::MEMORY_BUDGET_DEFAULT_MB);
+            if (!budget_data.isUInt64() || budget_data.asUInt64() > std::numeric_limits<std::size_t>::max() / (1024 * 1024)) {
+                std::cerr << "Config error (section 'memory'): budget must be a non-negative number of MiB" << std::endl;
+                exit(1);
+            }
+            Memory memory{
+                .budget = static_cast<std::size_t>(budget_data.asUInt64()) * 1024 * 1024
+            };
+
+            Checkpoint checkpoint{
+                .directory = data.get("checkpoint", Json::objectValue).get("directory", "").asString(),
+                .interval = data.get("checkpoint", Json::objectValue).get("interval", rustymon::CHECKPOINT_INTERVAL_DEFAULT).asInt()
+            };
+
+            Layout layout{
+                .spatial_order = data.get("layout", Json::objectValue).get("spatial_order", rustymon::LAYOUT_SPATIAL_ORDER_DEFAULT).asBool(),
+                .bucket_level = data.get("layout", Json::objectValue).get("bucket_level", rustymon::LAYOUT_BUCKET_LEVEL_DEFAULT).asInt(),
+                .merge_streets = data.get("layout", Json::objectValue).get("merge_streets", rustymon::LAYOUT_MERGE_STREETS_DEFAULT).asBool(),
+                .shared_areas = data.get("layout", Json::objectValue).get("shared_areas", rustymon::LAYOUT_SHARED_AREAS_DEFAULT).asBool()
+            };
+            if (layout.bucket_level < 1 || layout.bucket_level > rustymon::LAYOUT_BUCKET_LEVEL_MAX) {
+                std::cerr << "Config error (section 'layout'): bucket_level must be between 1 and " << rustymon::LAYOUT_BUCKET_LEVEL_MAX << std::endl;
+                exit(1);
+            }
+
+            const Json::Value tiling_data = data.get("tiling", Json::objectValue);
+            Tiling tiling{
+                .adaptive = tiling_data.get("adaptive", rustymon::TILING_ADAPTIVE_DEFAULT).asBool(),
+                .max_objects = tiling_data.get("max_objects", rustymon::TILING_MAX_OBJECTS_DEFAULT).asInt(),
+                .max_bytes = static_cast<std::size_t>(tiling_data.get("max_bytes", rustymon::TILING_MAX_BYTES_DEFAULT).asUInt64()),
+                .max_depth = tiling_data.get("max_depth", rustymon::TILING_MAX_DEPTH_DEFAULT).asInt(),
+                .coarsen = tiling_data.get("coarsen", rustymon::TILING_COARSEN_DEFAULT).asBool(),
+                .coarsen_max_objects = tiling_data.get("coarsen_max_objects", rustymon::TILING_COARSEN_MAX_OBJECTS_DEFAULT).asInt()
+            };
+            if (tiling.max_depth < 1 || tiling.max_depth > rustymon::TILING_MAX_DEPTH_LIMIT) {
+                std::cerr << "Config error (section 'tiling'): max_depth must be between 1 and " << rustymon::TILING_MAX_DEPTH_LIMIT << std::endl;
+                exit(1);
+            }
+            if (tiling.max_objects < 1 || tiling.max_bytes == 0) {
+                std::cerr << "Config error (section 'tiling'): max_objects and max_bytes must be positive" << std::endl;
+                exit(1);
+            }
+
             auto convert_object_to_map = [](const Json::Value& object){
                 std::map<std::string, std::vector<std::string>> map;
                 for (const std::string &key: object.getMemberNames()) {
@@ -31,17 +99,25 @@ namespace rustymon {
                 return map;
             };
 
+            auto convert_array_to_spawn_set = [](const Json::Value &array, const char *section) {
+                SpawnSet spawns;
+                for (const Json::Value &value: array) {
+                    const int id = value.asInt();
+                    if (!SpawnSet::valid(id)) {
+                        std::cerr << "Config error (section '" << section << "'): spawn " << id << " out of range (1 to " << SpawnSet::MAX_ID << ")" << std::endl;
+                        exit(1);
+                    }
+                    spawns.add(id);
+                }
+                return spawns;
+            };
+
             std::vector<ObjectProcessorEntry> poi;
             try {
                 for (const Json::Value &v: data.get("poi", Json::arrayValue)) {
-                    std::vector<int> spawns;
-                    for (const Json::Value &s: v.get("spawns", Json::arrayValue)) {
-                        spawns.push_back(s.asInt());
-                    }
-
                     poi.push_back(ObjectProcessorEntry{
                             .type = v["type"].asInt(),
-                            .spawns = spawns,
+                            .spawns = convert_array_to_spawn_set(v.get("spawns", Json::arrayValue), "poi"),
                             .required = convert_object_to_map(v.get("required", Json::objectValue)),
                             .forbidden = convert_object_to_map(v.get("forbidden", Json::objectValue))
                     });
@@ -69,14 +145,9 @@ namespace rustymon {
             std::vector<ObjectProcessorEntry> areas;
             try {
                 for (const Json::Value &v: data.get("areas", Json::arrayValue)) {
-                    std::vector<int> spawns;
-                    for (const Json::Value &s: v.get("spawns", Json::arrayValue)) {
-                        spawns.push_back(s.asInt());
-                    }
-
                     areas.push_back(ObjectProcessorEntry{
                             .type = v["type"].asInt(),
-                            .spawns = std::move(spawns),
+                            .spawns = convert_array_to_spawn_set(v.get("spawns", Json::arrayValue), "areas"),
                             .required = convert_object_to_map(v.get("required", Json::objectValue)),
                             .forbidden = convert_object_to_map(v.get("forbidden", Json::objectValue))
                     });
@@ -86,12 +157,124 @@ namespace rustymon {
                 exit(1);
             }
 
+            // Condition values are 1-indexed enum values, values outside of the enum would never match
+            auto convert_array_to_conditions = [](const Json::Value& array, const char *name, const int count){
+                std::vector<int> values;
+                for (const Json::Value &value: array) {
+                    const int id = value.asInt();
+                    if (id < 1 || id > count) {
+                        std::cerr << "Config error (section 'spawn_conditions'): " << name << " " << id << " out of range (1 to " << count << ")" << std::endl;
+                        exit(1);
+                    }
+                    values.push_back(id);
+                }
+                return values;
+            };
+
+            std::vector<ConditionModifier> modifiers;
+            const Json::Value spawn_conditions_data = data.get("spawn_conditions", Json::objectValue);
+            try {
+                for (const Json::Value &v: spawn_conditions_data.get("modifiers", Json::arrayValue)) {
+                    const int spawn = v["spawn"].asInt();
+                    if (!SpawnSet::valid(spawn)) {
+                        std::cerr << "Config error (section 'spawn_conditions'): spawn " << spawn << " out of range (1 to " << SpawnSet::MAX_ID << ")" << std::endl;
+                        exit(1);
+                    }
+                    modifiers.push_back(ConditionModifier{
+                            .spawn = spawn,
+                            .time = convert_array_to_conditions(v.get("time", Json::arrayValue), "time", spawns::TIME_TYPE_COUNT),
+                            .weather = convert_array_to_conditions(v.get("weather", Json::arrayValue), "weather", spawns::WEATHER_TYPE_COUNT),
+                            .moon = convert_array_to_conditions(v.get("moon", Json::arrayValue), "moon", spawns::MOON_TYPE_COUNT),
+                            .temperature = convert_array_to_conditions(v.get("temperature", Json::arrayValue), "temperature", spawns::TEMPERATURE_TYPE_COUNT),
+                            .factor = v.get("factor", 1.0).asDouble()
+                    });
+                }
+            } catch (Json::LogicError &error) {
+                std::cerr << "Config error (section 'spawn_conditions'): " << error.what() << std::endl;
+                exit(1);
+            }
+
+            SpawnConditions spawn_conditions{
+                .enabled = spawn_conditions_data.get("enabled", false).asBool(),
+                .modifiers = std::move(modifiers)
+            };
+
+            const Json::Value coastline_data = data.get("coastline", Json::objectValue);
+            SpawnSet coastline_spawns;
+            coastline_spawns.add(static_cast<int>(SpawnType::OCEAN) + 1);
+            if (coastline_data.isMember("spawns")) {
+                try {
+                    coastline_spawns = convert_array_to_spawn_set(coastline_data["spawns"], "coastline");
+                } catch (Json::LogicError &error) {
+                    std::cerr << "Config error (section 'coastline'): " << error.what() << std::endl;
+                    exit(1);
+                }
+            }
+            Coastline coastline{
+                .enabled = coastline_data.get("enabled", rustymon::COASTLINE_ENABLED_DEFAULT).asBool(),
+                .type = coastline_data.get("type", static_cast<int>(AreaType::WATER) + 1).asInt(),
+                .spawns = coastline_spawns,
+                .create_tiles = coastline_data.get("create_tiles", rustymon::COASTLINE_CREATE_TILES_DEFAULT).asBool()
+            };
+
+            const Json::Value elevation_data = data.get("elevation", Json::objectValue);
+            auto make_band = [](const int min, const int max, const SpawnType spawn) {
+                SpawnSet spawns;
+                spawns.add(static_cast<int>(spawn) + 1);
+                return ElevationBand{
+                        .min = min,
+                        .max = max,
+                        .type = static_cast<int>(AreaType::UNDEFINED) + 1,
+                        .spawns = spawns
+                };
+            };
+            std::vector<ElevationBand> bands{
+                    make_band(rustymon::ELEVATION_HILLS_MIN, rustymon::ELEVATION_MOUNTAIN_MIN, SpawnType::HILLS),
+                    make_band(rustymon::ELEVATION_MOUNTAIN_MIN, rustymon::ELEVATION_MOUNTAIN_TOP_MIN, SpawnType::MOUNTAIN),
+                    make_band(rustymon::ELEVATION_MOUNTAIN_TOP_MIN, std::numeric_limits<int>::max(), SpawnType::MOUNTAIN_TOP),
+                    make_band(rustymon::ELEVATION_GLACIER_MIN, std::numeric_limits<int>::max(), SpawnType::GLACIER)
+            };
+            if (elevation_data.isMember("bands")) {
+                bands.clear();
+                try {
+                    for (const Json::Value &v: elevation_data["bands"]) {
+                        bands.push_back(ElevationBand{
+                                .min = v.get("min", std::numeric_limits<int>::min()).asInt(),
+                                .max = v.get("max", std::numeric_limits<int>::max()).asInt(),
+                                .type = v.get("type", static_cast<int>(AreaType::UNDEFINED) + 1).asInt(),
+                                .spawns = convert_array_to_spawn_set(v.get("spawns", Json::arrayValue), "elevation")
+                        });
+                    }
+                } catch (Json::LogicError &error) {
+                    std::cerr << "Config error (section 'elevation'): " << error.what() << std::endl;
+                    exit(1);
+                }
+            }
+            Elevation elevation{
+                .directory = elevation_data.get("directory", "").asString(),
+                .samples = elevation_data.get("samples", rustymon::ELEVATION_SAMPLES_DEFAULT).asInt(),
+                .bands = std::move(bands)
+            };
+            if (elevation.samples < 1 || elevation.samples > rustymon::ELEVATION_SAMPLES_MAX) {
+                std::cerr << "Config error (section 'elevation'): samples must be between 1 and " << rustymon::ELEVATION_SAMPLES_MAX << std::endl;
+                exit(1);
+            }
+
             return Config{
                 .workers = workers,
+                .reader = reader,
+                .http = http,
                 .size = size,
+                .memory = memory,
+                .checkpoint = checkpoint,
+                .layout = layout,
+                .tiling = tiling,
                 .poi = poi,
                 .streets = streets,
-                .areas = areas
+                .areas = areas,
+                .spawn_conditions = spawn_conditions,
+                .coastline = coastline,
+                .elevation = elevation
             };
         }
 
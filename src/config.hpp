@@ -10,16 +10,45 @@
 #include <json/json.h>
 
 #include "constants.hpp"
+#include "spawn_set.hpp"
 
 namespace rustymon {
 
     namespace config {
 
         struct Workers {
+            const int decode;
             const int node;
             const int way;
             const int area;
             const int upload;
+            const int serialize;
+        };
+
+        struct Reader {
+            /// Maximum number of raw input chunks waiting to be decoded (0 uses the libosmium default)
+            const int input_queue;
+            /// Maximum number of decoded buffers waiting to be processed (0 uses the libosmium default)
+            const int osmdata_queue;
+            /// Maximum number of jobs waiting in the decoding thread pool
+            const int work_queue;
+            /// Store only the locations of nodes referenced by ways which may become streets or areas
+            const bool selective_locations;
+        };
+
+        struct Http {
+            /// Use the asynchronous event loop uploader instead of one blocking request per worker thread
+            const bool async;
+            const int event_threads;
+            const int in_flight;
+            const int connections;
+            const bool http2;
+            /// Number of times a throttled or failed request is repeated by the asynchronous uploader
+            const int retries;
+            /// Post-process the tiles one by one and upload each of them as soon as it's finished
+            const bool pipelined;
+            /// Maximum number of finished units waiting for an upload slot
+            const int pipeline_queue;
         };
 
         struct Size {
@@ -27,19 +56,109 @@ namespace rustymon {
             const int y;
         };
 
+        struct Memory {
+            /// Memory budget in bytes, zero means unlimited
+            const std::size_t budget;
+        };
+
+        struct Checkpoint {
+            /// Directory for checkpoints and the export journal, empty to disable checkpoints
+            const std::string directory;
+            /// Minimum number of seconds between two checkpoints while reading the input
+            const int interval;
+        };
+
+        struct Layout {
+            /// Sort the objects of every tile along a space-filling curve and add a bucket index
+            const bool spatial_order;
+            /// Subdivision level of the bucket index (4^level sub-cells per tile)
+            const int bucket_level;
+            /// Join streets of the same type meeting end to end within a tile
+            const bool merge_streets;
+            /// Store only a reference to an area in the tiles it covers completely
+            const bool shared_areas;
+        };
+
+        struct Tiling {
+            /// Split tiles exceeding one of the limits into quadrants, recursively up to the maximum depth
+            const bool adaptive;
+            const int max_objects;
+            /// Limit of the serialized size of a tile in bytes
+            const std::size_t max_bytes;
+            const int max_depth;
+            /// Join groups of 2x2 sparse tiles into one tile of level -1
+            const bool coarsen;
+            /// Maximum number of objects of all tiles of a joined group
+            const int coarsen_max_objects;
+        };
+
+        struct ConditionModifier {
+            /// Spawn type whose weight is modified
+            const int spawn;
+            /// Conditions (1-indexed enum values) under which the modifier applies, empty lists match any value
+            const std::vector<int> time;
+            const std::vector<int> weather;
+            const std::vector<int> moon;
+            const std::vector<int> temperature;
+            /// Factor applied to the weight of the spawn type
+            const double factor;
+        };
+
+        struct SpawnConditions {
+            /// Add precomputed spawn tables to every tile
+            const bool enabled;
+            const std::vector<ConditionModifier> modifiers;
+        };
+
+        struct Coastline {
+            /// Join the natural=coastline ways and add water areas to all tiles covered by the sea
+            const bool enabled;
+            /// Area type and spawns of the generated water areas
+            const int type;
+            const SpawnSet spawns;
+            /// Also create the tiles crossed by the coastline which don't contain any other objects (open sea tiles aren't created)
+            const bool create_tiles;
+        };
+
+        struct ElevationBand {
+            /// Range of the mean elevation of a tile in meters (minimum inclusive, maximum exclusive)
+            const int min;
+            const int max;
+            /// Area type and spawns of the area covering the tiles in the range
+            const int type;
+            const SpawnSet spawns;
+        };
+
+        struct Elevation {
+            /// Directory of SRTM HGT files (e.g. N47E011.hgt), elevation data is only used if it's set
+            const std::string directory;
+            /// Samples per row and column of every tile
+            const int samples;
+            const std::vector<ElevationBand> bands;
+        };
+
         struct ObjectProcessorEntry {
             const int type;
-            const std::vector<int> spawns;
+            const SpawnSet spawns;
             const std::map<std::string, std::vector<std::string>> required;
             const std::map<std::string, std::vector<std::string>> forbidden;
         };
 
         struct Config {
             const Workers workers;
+            const Reader reader;
+            const Http http;
             const Size size;
+            const Memory memory;
+            const Checkpoint checkpoint;
+            const Layout layout;
+            const Tiling tiling;
             const std::vector<ObjectProcessorEntry> poi;
             const std::vector<ObjectProcessorEntry> streets;
             const std::vector<ObjectProcessorEntry> areas;
+            const SpawnConditions spawn_conditions;
+            const Coastline coastline;
+            const Elevation elevation;
         };
 
         Config load_config_from_json(const Json::Value &data);
@@ -2,12 +2,14 @@
 #define WORLD_GENERATOR_CONSTANTS_HPP
 
 #include <string>
+#include <cstdint>
 #include <thread>
 
 namespace rustymon {
 
     static const int FILE_VERSION = 1;
     static const char BBOX_SPLIT_CHAR = '/';
+    static const char INPUT_SPLIT_CHAR = ',';
     static const std::string DEFAULT_CONFIG_FILENAME = "config.json";  // NOLINT
 
     static const int QUEUE_MAX_SIZE = 16 * 1024;
@@ -16,10 +18,78 @@ namespace rustymon {
     static const int X_SIZE_FACTOR_DEFAULT = 10000;
     static const int Y_SIZE_FACTOR_DEFAULT = 10000;
 
+    static const int MEMORY_BUDGET_DEFAULT_MB = 0;
+    static const int MEMORY_CHECK_INTERVAL_BUFFERS = 64;
+    static const int MEMORY_EXPORT_WAIT_MS = 5;
+
+    static const int CHECKPOINT_INTERVAL_DEFAULT = 600;
+
+    static const double SYNTH_DENSITY_DEFAULT = 1.0;
+    static const std::uint64_t SYNTH_SEED_DEFAULT = 42;
+
+    static const std::size_t UPLOAD_BENCH_TILES_DEFAULT = 2000;
+    static const int UPLOAD_BENCH_POI_PER_TILE = 40;
+    static const int UPLOAD_BENCH_STREETS_PER_TILE = 10;
+    static const std::size_t MOCK_INGEST_MAX_HEADER_SIZE = 65536;
+
+    static const bool LAYOUT_SPATIAL_ORDER_DEFAULT = false;
+    static const int LAYOUT_BUCKET_LEVEL_DEFAULT = 2;
+    static const int LAYOUT_BUCKET_LEVEL_MAX = 6;
+    static const bool LAYOUT_MERGE_STREETS_DEFAULT = false;
+    static const bool LAYOUT_SHARED_AREAS_DEFAULT = false;
+
+    static const bool TILING_ADAPTIVE_DEFAULT = false;
+    static const int TILING_MAX_OBJECTS_DEFAULT = 2000;
+    static const int TILING_MAX_BYTES_DEFAULT = 256 * 1024;
+    static const int TILING_MAX_DEPTH_DEFAULT = 4;
+    static const int TILING_MAX_DEPTH_LIMIT = 12;
+    static const bool TILING_COARSEN_DEFAULT = false;
+    static const int TILING_COARSEN_MAX_OBJECTS_DEFAULT = 50;
+
+    static const double STREET_SPLIT_EPSILON = 1e-12;
+
+    static const long AREA_MAX_TILES = 1L << 22;
+    static const int AREA_PENDING_JOBS_PER_THREAD = 16;
+    static const std::size_t AREA_JOB_BUFFER_SIZE = 16 * 1024;
+
+    static const bool COASTLINE_ENABLED_DEFAULT = false;
+    static const bool COASTLINE_CREATE_TILES_DEFAULT = false;
+    static const int COASTLINE_CELL_TILES = 64;
+
+    static const int ELEVATION_SAMPLES_DEFAULT = 4;
+    static const int ELEVATION_SAMPLES_MAX = 64;
+    static const int ELEVATION_HILLS_MIN = 500;
+    static const int ELEVATION_MOUNTAIN_MIN = 1500;
+    static const int ELEVATION_MOUNTAIN_TOP_MIN = 3000;
+    static const int ELEVATION_GLACIER_MIN = 4500;
+
+    static const int READER_INPUT_QUEUE_DEFAULT = 0;
+    static const int READER_OSMDATA_QUEUE_DEFAULT = 0;
+    static const int READER_WORK_QUEUE_DEFAULT = 10;
+    static const bool READER_SELECTIVE_LOCATIONS_DEFAULT = false;
+    static const std::size_t READER_MERGE_BUFFER_SIZE = 1024 * 1024;
+
+    static const bool HTTP_ASYNC_DEFAULT = true;
+    static const bool HTTP_HTTP2_DEFAULT = true;
+    static const int HTTP_EVENT_THREADS_DEFAULT = 2;
+    static const int HTTP_MAX_IN_FLIGHT_DEFAULT = 256;
+    static const int HTTP_MAX_CONNECTIONS_DEFAULT = 16;
+    static const int HTTP_MAX_RETRIES_DEFAULT = 3;
+    static const int HTTP_RETRY_BACKOFF_MS = 100;
+    static const bool HTTP_PIPELINED_DEFAULT = false;
+    static const int HTTP_PIPELINE_QUEUE_DEFAULT = 1024;
+    static const int UPLOAD_POLL_TIMEOUT_MS = 100;
+    static const int UPLOAD_SOURCE_WAIT_MS = 2;
+
+    static const int SERIALIZE_BUFFERS_PER_THREAD = 4;
+    static const int SINK_BUFFER_UNITS = 256;
+
+    static const int DECODE_DEFAULT_WORKER_THREADS = static_cast<int>(std::thread::hardware_concurrency());
     static const int NODE_DEFAULT_WORKER_THREADS = static_cast<int>(std::thread::hardware_concurrency());
     static const int WAY_DEFAULT_WORKER_THREADS = 2 * static_cast<int>(std::thread::hardware_concurrency());
     static const int AREA_DEFAULT_WORKER_THREADS = 4 * static_cast<int>(std::thread::hardware_concurrency());
     static const int UPLOAD_DEFAULT_WORKER_THREADS = 2 * static_cast<int>(std::thread::hardware_concurrency());
+    static const int SERIALIZE_DEFAULT_WORKER_THREADS = static_cast<int>(std::thread::hardware_concurrency());
 
 }
 
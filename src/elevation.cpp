@@ -0,0 +1,194 @@
+#include "elevation.hpp"
+
+#include <cmath>
+#include <atomic>
+#include <cstdio>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "geometry.hpp"
+
+namespace rustymon {
+
+    namespace elevation {
+
+        static const int HGT_VOID = -32768;
+
+        HgtFile::HgtFile(const std::string &filename, const int lat, const int lon) : lat(lat), lon(lon) {
+            fd = open(filename.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::runtime_error("failed to open elevation file " + filename);
+            }
+            struct stat file_stat{};
+            if (fstat(fd, &file_stat) != 0) {
+                ::close(fd);
+                throw std::runtime_error("failed to open elevation file " + filename);
+            }
+            mapping_size = static_cast<std::size_t>(file_stat.st_size);
+            size = static_cast<int>(std::lround(std::sqrt(mapping_size / 2.0)));
+            if (size < 2 || 2 * static_cast<std::size_t>(size) * size != mapping_size) {
+                ::close(fd);
+                throw std::runtime_error("invalid elevation file " + filename);
+            }
+            void *address = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (address == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("failed to map elevation file " + filename);
+            }
+            mapping = static_cast<const unsigned char *>(address);
+        }
+
+        HgtFile::~HgtFile() {
+            munmap(const_cast<unsigned char *>(mapping), mapping_size);
+            ::close(fd);
+        }
+
+        double HgtFile::sample(const double lon, const double lat) const {
+            const double column = std::min(std::max((lon - this->lon) * (size - 1), 0.0), size - 1.0);
+            const double row = std::min(std::max((this->lat + 1 - lat) * (size - 1), 0.0), size - 1.0);
+            const int column0 = std::min(static_cast<int>(column), size - 2);
+            const int row0 = std::min(static_cast<int>(row), size - 2);
+            const double fx = column - column0;
+            const double fy = row - row0;
+
+            const int values[4] = {value(row0, column0), value(row0, column0 + 1), value(row0 + 1, column0), value(row0 + 1, column0 + 1)};
+            if (std::find(std::begin(values), std::end(values), HGT_VOID) != std::end(values)) {
+                // Voids are common in steep terrain, fall back to the nearest sample there
+                const int nearest = values[(fy < 0.5 ? 0 : 2) + (fx < 0.5 ? 0 : 1)];
+                return (nearest == HGT_VOID) ? std::numeric_limits<double>::quiet_NaN() : nearest;
+            }
+            return (values[0] * (1 - fx) + values[1] * fx) * (1 - fy) + (values[2] * (1 - fx) + values[3] * fx) * fy;
+        }
+
+        std::string hgt_filename(const int lat, const int lon) {
+            char name[16];
+            std::snprintf(name, sizeof(name), "%c%02d%c%03d.hgt", lat < 0 ? 'S' : 'N', std::abs(lat), lon < 0 ? 'W' : 'E', std::abs(lon));
+            return name;
+        }
+
+        ElevationModel::ElevationModel(std::string directory) : directory(std::move(directory)) {
+        }
+
+        const HgtFile *ElevationModel::file(const int lat, const int lon) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            const std::pair<int, int> cell{lat, lon};
+            auto it = files.find(cell);
+            if (it != files.end()) {
+                return it->second.get();
+            }
+
+            std::unique_ptr<HgtFile> file;
+            const std::string filename = directory + "/" + hgt_filename(lat, lon);
+            struct stat file_stat{};
+            if (stat(filename.c_str(), &file_stat) == 0) {
+                try {
+                    file.reset(new HgtFile(filename, lat, lon));
+                } catch (std::runtime_error &error) {
+                    std::cerr << error.what() << std::endl;
+                }
+            }
+            return files.emplace(cell, std::move(file)).first->second.get();
+        }
+
+        std::size_t ElevationModel::mapped_files() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return static_cast<std::size_t>(std::count_if(files.begin(), files.end(), [](const std::pair<const std::pair<int, int>, std::unique_ptr<HgtFile>> &entry) {
+                return entry.second != nullptr;
+            }));
+        }
+
+        structs::Elevation summarize(const ElevationModel &model, const structs::BoundingBox &box, const int samples) {
+            const double width = box.top_right.first - box.bottom_left.first;
+            const double height = box.top_right.second - box.bottom_left.second;
+
+            // The last file is remembered, so the model is only asked when the grid crosses into another cell
+            const HgtFile *file = nullptr;
+            std::pair<int, int> cell{std::numeric_limits<int>::min(), std::numeric_limits<int>::min()};
+            int count = 0;
+            double min = std::numeric_limits<double>::max();
+            double max = std::numeric_limits<double>::lowest();
+            double sum = 0;
+            // Rows run from north to south like the rows of the files
+            for (int j = samples - 1; j >= 0; j--) {
+                const double lat = box.bottom_left.second + (j + 0.5) * height / samples;
+                for (int i = 0; i < samples; i++) {
+                    const double lon = box.bottom_left.first + (i + 0.5) * width / samples;
+                    const std::pair<int, int> current{static_cast<int>(std::floor(lat)), static_cast<int>(std::floor(lon))};
+                    if (current != cell) {
+                        cell = current;
+                        file = model.file(cell.first, cell.second);
+                    }
+                    if (file == nullptr) {
+                        continue;
+                    }
+                    const double value = file->sample(lon, lat);
+                    if (std::isnan(value)) {
+                        continue;
+                    }
+                    count++;
+                    min = std::min(min, value);
+                    max = std::max(max, value);
+                    sum += value;
+                }
+            }
+
+            if (count == 0) {
+                return structs::Elevation{0, 0, 0, 0};
+            }
+            return structs::Elevation{
+                    count,
+                    static_cast<int>(std::lround(min)),
+                    static_cast<int>(std::lround(max)),
+                    static_cast<int>(std::lround(sum / count))
+            };
+        }
+
+        ElevationStatistics add_tile_elevation(const ElevationModel &model, const config::Elevation &config, const bool shared_areas, structs::Tile &tile, memory::MemoryTracker *tracker) {
+            ElevationStatistics statistics{1, 0, 0, 0};
+            tile.elevation = summarize(model, tile.bbox, config.samples);
+            if (tile.elevation.samples == 0) {
+                return statistics;
+            }
+            statistics.covered = 1;
+            for (const config::ElevationBand &band: config.bands) {
+                if (tile.elevation.mean >= band.min && tile.elevation.mean < band.max) {
+                    if (shared_areas) {
+                        tile.covering.push_back(structs::AreaRef{0, band.type, band.spawns});
+                        if (tracker != nullptr) {
+                            tracker->add(memory::Component::WORLD, structs::memory_usage(tile.covering.back()));
+                        }
+                    } else {
+                        tile.areas.push_back(structs::Area{0, band.type, geometry::box_ring(tile.bbox), band.spawns});
+                        if (tracker != nullptr) {
+                            tracker->add(memory::Component::WORLD, structs::memory_usage(tile.areas.back()));
+                        }
+                    }
+                    statistics.areas++;
+                }
+            }
+            return statistics;
+        }
+
+        ElevationStatistics add_elevation(structs::World &world, const config::Elevation &config, const bool shared_areas, const int worker_threads, memory::MemoryTracker *tracker) {
+            const ElevationModel model(config.directory);
+            std::atomic<std::size_t> tiles{0};
+            std::atomic<std::size_t> covered{0};
+            std::atomic<std::size_t> areas{0};
+            structs::for_each_tile_parallel(world, worker_threads, [&](structs::Tile &tile){
+                const ElevationStatistics statistics = add_tile_elevation(model, config, shared_areas, tile, tracker);
+                tiles++;
+                covered += statistics.covered;
+                areas += statistics.areas;
+            });
+            return ElevationStatistics{tiles, covered, areas, model.mapped_files()};
+        }
+
+    }
+
+}
@@ -0,0 +1,102 @@
+#ifndef WORLD_GENERATOR_ELEVATION_HPP
+#define WORLD_GENERATOR_ELEVATION_HPP
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "config.hpp"
+#include "memory.hpp"
+#include "structs.hpp"
+
+/*
+ * Elevation stage: SRTM HGT files (one file per degree of latitude and longitude, big-endian
+ * 16 bit samples in rows from north to south) are memory-mapped when a tile first needs them.
+ * Every tile is sampled on a small regular grid in the row order of the files, the samples are
+ * summarized in the tile and tiles whose mean elevation lies in a configured band get an area
+ * covering the whole tile with the terrain spawns of that band.
+ */
+
+namespace rustymon {
+
+    namespace elevation {
+
+        /// Memory-mapped HGT file covering the cell from (lon, lat) to (lon + 1, lat + 1)
+        class HgtFile {
+            int fd = -1;
+            const unsigned char *mapping = nullptr;
+            std::size_t mapping_size = 0;
+            /// Samples per row and column, 1201 for 3 arc seconds or 3601 for 1 arc second resolution
+            int size = 0;
+            const int lat;
+            const int lon;
+
+            /// Elevation of the sample in the given row and column, HGT_VOID if there's no data
+            inline int value(int row, int column) const {
+                const unsigned char *sample = mapping + 2 * (static_cast<std::size_t>(row) * size + column);
+                return static_cast<std::int16_t>((sample[0] << 8) | sample[1]);
+            }
+
+        public:
+
+            /// Memory-map the given file, throwing a std::runtime_error if it's invalid
+            HgtFile(const std::string &filename, int lat, int lon);
+
+            HgtFile(const HgtFile &) = delete;
+            HgtFile& operator = (const HgtFile &) = delete;
+
+            ~HgtFile();
+
+            /// Bilinear interpolated elevation in meters at the point inside the cell, NaN without data
+            double sample(double lon, double lat) const;
+        };
+
+        /// Name of the HGT file of the cell with the given south west corner, e.g. N47E011.hgt
+        std::string hgt_filename(int lat, int lon);
+
+        /// Directory of HGT files, which are mapped on first use. It's safe to use this concurrently.
+        class ElevationModel {
+            const std::string directory;
+            mutable std::mutex mutex;
+            /// Mapped files by cell, null for cells without a (valid) file
+            mutable std::map<std::pair<int, int>, std::unique_ptr<HgtFile>> files;
+
+        public:
+
+            explicit ElevationModel(std::string directory);
+
+            /// File of the cell with the given south west corner, null if there's none
+            const HgtFile *file(int lat, int lon) const;
+
+            std::size_t mapped_files() const;
+        };
+
+        /// Summarize the elevation of samples x samples points at the centers of a regular grid over the box
+        structs::Elevation summarize(const ElevationModel &model, const structs::BoundingBox &box, int samples);
+
+        struct ElevationStatistics {
+            std::size_t tiles;
+            /// Number of tiles with elevation data
+            std::size_t covered;
+            /// Number of areas added for elevation bands
+            std::size_t areas;
+            std::size_t files;
+        };
+
+        /**
+         * Summarize the elevation of a single tile and add the areas of its bands, `files` stays zero.
+         * With shared areas the bands are only referenced from the tile, as their border is the bounding box.
+         */
+        ElevationStatistics add_tile_elevation(const ElevationModel &model, const config::Elevation &config, bool shared_areas, structs::Tile &tile, memory::MemoryTracker *tracker = nullptr);
+
+        ElevationStatistics add_elevation(structs::World &world, const config::Elevation &config, bool shared_areas, int worker_threads, memory::MemoryTracker *tracker = nullptr);
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_ELEVATION_HPP
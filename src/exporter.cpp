@@ -4,7 +4,84 @@ namespace rustymon {
 
     namespace detail {
 
-        std::pair<int, int> export_world_to_http_worker(const structs::World &world, const std::string &push_url, const std::string &auth_info, std::ostream &logger, const int worker_count, const int my_modulo) {
+        std::vector<structs::TileRef> world_tiles(const structs::World &world) {
+            std::vector<structs::TileRef> tiles;
+            for (auto const &x: world) {
+                for (auto const &y: x.second) {
+                    tiles.emplace_back(structs::TileAddress{y.second.level, x.first, y.first}, &y.second);
+                }
+            }
+            return tiles;
+        }
+
+        void serialize_tiles_in_order(const std::vector<structs::TileRef> &tiles, const int worker_threads, const TileConsumer &consumer, const bool nested) {
+            const int threads = std::max(1, worker_threads);
+            const std::size_t window = static_cast<std::size_t>(threads) * SERIALIZE_BUFFERS_PER_THREAD;
+            std::vector<std::string> buffers(window);
+            std::vector<bool> ready(window, false);
+            std::size_t next_index = 0;
+            std::size_t consumed = 0;
+            std::mutex mutex;
+            std::condition_variable changed;
+
+            std::vector<std::thread> thread_pool;
+            thread_pool.reserve(threads);
+            for (int i = 0; i < threads; i++) {
+                thread_pool.emplace_back([&tiles, nested, window, &buffers, &ready, &next_index, &consumed, &mutex, &changed, i](){
+                    trace::set_thread_name("serialize worker " + std::to_string(i));
+                    while (true) {
+                        std::size_t index;
+                        {
+                            // Don't run ahead of the consumer by more than the window of buffers
+                            std::unique_lock<std::mutex> lock(mutex);
+                            changed.wait(lock, [&](){
+                                return next_index >= tiles.size() || next_index < consumed + window;
+                            });
+                            if (next_index >= tiles.size()) {
+                                return;
+                            }
+                            index = next_index++;
+                        }
+
+                        trace::Scope scope{"serialize", "export"};
+                        std::stringstream payload;
+                        if (nested) {
+                            payload << *tiles[index].second;
+                        } else {
+                            structs::stream_unit(payload, tiles[index]);
+                        }
+                        std::string result = payload.str();
+
+                        std::unique_lock<std::mutex> lock(mutex);
+                        buffers[index % window] = std::move(result);
+                        ready[index % window] = true;
+                        changed.notify_all();
+                    }
+                });
+            }
+
+            for (std::size_t index = 0; index < tiles.size(); index++) {
+                std::string payload;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&](){
+                        return ready[index % window];
+                    });
+                    payload = std::move(buffers[index % window]);
+                    ready[index % window] = false;
+                    consumed++;
+                    changed.notify_all();
+                }
+                trace::Scope scope{"write", "export"};
+                consumer(tiles[index].first, payload);
+            }
+
+            for (std::thread &t: thread_pool) {
+                t.join();
+            }
+        }
+
+        std::pair<int, int> export_world_to_http_worker(const std::vector<structs::TileRef> &units, const std::string &push_url, const std::string &auth_info, std::ostream &logger, const int worker_count, const int my_modulo, memory::MemoryTracker *tracker, checkpoint::ExportJournal *journal) {
             cpr::Header headers{{"Content-Type", "application/json"}};
             if (!auth_info.empty()) {
                 headers.insert({"Authorization", auth_info});
@@ -15,28 +92,51 @@ namespace rustymon {
 
             int errors = 0;
             int total_requests = 0;
-            for (auto const& x : world) {
-                if (x.first % worker_count != my_modulo) {
+            for (std::size_t index = static_cast<std::size_t>(my_modulo); index < units.size(); index += worker_count) {
+                const structs::TileAddress &address = units[index].first;
+                const structs::Tile &tile = *units[index].second;
+                if (journal != nullptr && journal->contains(address.x, address.y, address.level)) {
                     continue;
                 }
 
-                for (auto const &y: x.second) {
-                    std::stringstream body;
-                    body << y.second;
-                    std::stringstream position_header;
-
-                    position_header << x.first << "," << y.first;
-                    headers.erase("X-Tile-Position");
-                    headers.insert({"X-Tile-Position", position_header.str()});
-                    session.SetBody(cpr::Body{body.str()});
-                    session.SetHeader(headers);
-
-                    cpr::Response r = session.Post();
-                    total_requests++;
-                    if (r.status_code != 200) {
-                        errors++;
-                        logger << "Received status code " << r.status_code << " while uploading Tile " << x.first << "," << y.first << std::endl;
+                // Reduce the number of in-flight buffers while the memory budget is exhausted,
+                // but always allow one buffer to be in flight to guarantee progress
+                // (split tiles are only sent as small index entries, their children follow on their own)
+                std::size_t estimated_size = 0;
+                if (tracker != nullptr) {
+                    estimated_size = tile.children.empty() ? structs::memory_usage(tile) : 0;
+                    while (tracker->would_exceed(estimated_size) && tracker->get(memory::Component::EXPORT_BUFFERS) > 0) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(MEMORY_EXPORT_WAIT_MS));
                     }
+                    tracker->add(memory::Component::EXPORT_BUFFERS, estimated_size);
+                }
+
+                std::stringstream body;
+                structs::stream_unit(body, units[index]);
+                std::stringstream position_header;
+
+                position_header << address.x << "," << address.y;
+                headers.erase("X-Tile-Position");
+                headers.insert({"X-Tile-Position", position_header.str()});
+                headers.erase("X-Tile-Level");
+                if (address.level != 0) {
+                    headers.insert({"X-Tile-Level", std::to_string(address.level)});
+                }
+                session.SetBody(cpr::Body{body.str()});
+                session.SetHeader(headers);
+
+                trace::Scope scope{"upload", "http"};
+                cpr::Response r = session.Post();
+                if (tracker != nullptr) {
+                    tracker->sub(memory::Component::EXPORT_BUFFERS, estimated_size);
+                }
+                total_requests++;
+                if (r.status_code != 200) {
+                    errors++;
+                    logger << "Received status code " << r.status_code << " while uploading Tile " << address.x << "," << address.y
+                           << " (level " << address.level << ")" << std::endl;
+                } else if (journal != nullptr) {
+                    journal->record(address.x, address.y, address.level);
                 }
             }
 
@@ -45,27 +145,83 @@ namespace rustymon {
 
     }
 
-    void export_world_to_file(const structs::World &world, const std::string &filename, std::ostream &logger) {
+    void export_world_to_file(const structs::World &world, const std::string &filename, std::ostream &logger, const int worker_threads) {
         std::ofstream output_file_stream(filename);
-        structs::stream(output_file_stream, world);
+
+        // Same output as structs::stream, but with the tiles serialized in parallel
+        // (the generator never creates columns without any tile, so they are ignored here)
+        bool first_column = true;
+        int current_x = 0;
+        output_file_stream << "{";
+        detail::serialize_tiles_in_order(detail::world_tiles(world), worker_threads, [&output_file_stream, &first_column, &current_x](const structs::TileAddress &address, std::string &payload) {
+            const int x = address.x;
+            const int y = address.y;
+            if (first_column || x != current_x) {
+                if (!first_column) {
+                    output_file_stream << "},";
+                }
+                output_file_stream << x << ":{";
+                first_column = false;
+                current_x = x;
+            }
+            output_file_stream << y << ":" << payload << ",";
+        }, true);
+        if (!first_column) {
+            output_file_stream << "},";
+        }
+        output_file_stream << "}";
         output_file_stream.close();
     }
 
+    void export_world_to_archive(const structs::World &world, const std::string &filename, std::ostream &logger, const int worker_threads) {
+        // Split tiles are stored as index entries of their children, which are stored as tiles of their own
+        const std::vector<structs::TileRef> units = structs::export_units(world);
+        const std::uint64_t tile_count = units.size();
+
+        archive::Writer writer(filename, tile_count);
+        // Exceptions can't leave the consumer while the serialization threads are running, the first error stops the writing
+        std::string error;
+        detail::serialize_tiles_in_order(units, worker_threads, [&writer, &error](const structs::TileAddress &address, std::string &payload) {
+            if (!error.empty()) {
+                return;
+            }
+            try {
+                writer.add(address.x, address.y, address.level, payload);
+            } catch (std::runtime_error &exception) {
+                error = exception.what();
+            }
+        }, false);
+        if (error.empty()) {
+            try {
+                writer.close();
+            } catch (std::runtime_error &exception) {
+                error = exception.what();
+            }
+        }
+        if (!error.empty()) {
+            std::cerr << error << "." << std::endl;
+            exit(1);
+        }
+        logger << "Wrote " << tile_count << " tiles to the archive " << filename << "." << std::endl;
+    }
+
     void export_world_to_files(const structs::World &world, const std::string &directory, std::ostream &logger) {
         // TODO: Implement this function
     }
 
-    void export_world_to_http(const structs::World &world, const std::string &push_url, const std::string &auth_info, std::ostream &logger, const int worker_threads) {
-        int error_count;
-        int total_requests;
+    void export_world_to_http(const structs::World &world, const std::string &push_url, const std::string &auth_info, std::ostream &logger, const int worker_threads, memory::MemoryTracker *tracker, checkpoint::ExportJournal *journal) {
+        int error_count = 0;
+        int total_requests = 0;
 
+        const std::vector<structs::TileRef> units = structs::export_units(world);
         std::mutex result_mutex;
         std::vector<std::thread> thread_pool;
         thread_pool.reserve(worker_threads);
         for (int i = 0; i < worker_threads; i++) {
-            thread_pool.emplace_back([&world, &push_url, &auth_info, &logger, worker_threads, i, &result_mutex, &error_count, &total_requests](){
+            thread_pool.emplace_back([&units, &push_url, &auth_info, &logger, worker_threads, i, tracker, journal, &result_mutex, &error_count, &total_requests](){
                 logger << "Starting upload worker thread " << i << " of " << worker_threads << " with ID " << std::this_thread::get_id() << std::endl;
-                std::pair<int, int> result = detail::export_world_to_http_worker(world, push_url, auth_info, logger, worker_threads, i);
+                trace::set_thread_name("upload worker " + std::to_string(i));
+                std::pair<int, int> result = detail::export_world_to_http_worker(units, push_url, auth_info, logger, worker_threads, i, tracker, journal);
                 {
                     std::unique_lock<std::mutex> lock(result_mutex);
                     total_requests += result.first;
@@ -82,4 +238,101 @@ namespace rustymon {
         logger << "Completed uploading of " << total_requests << " objects with " << error_count << " errors." << std::endl;
     }
 
+    namespace detail {
+
+        upload::Options upload_options(const std::string &push_url, const config::Http &http_config, const std::string &auth_info) {
+            return upload::Options{
+                push_url,
+                auth_info,
+                (http_config.event_threads > 0) ? http_config.event_threads : HTTP_EVENT_THREADS_DEFAULT,
+                (http_config.in_flight > 0) ? http_config.in_flight : HTTP_MAX_IN_FLIGHT_DEFAULT,
+                (http_config.connections > 0) ? http_config.connections : HTTP_MAX_CONNECTIONS_DEFAULT,
+                http_config.http2,
+                std::max(0, http_config.retries)
+            };
+        }
+
+        upload::UploadResult upload_from_source(const upload::Options &options, const upload::JobSource &source, std::ostream &logger, memory::MemoryTracker *tracker, checkpoint::ExportJournal *journal) {
+            logger << "Starting " << options.event_threads << " upload event loops with up to " << options.max_in_flight << " requests in flight..." << std::endl;
+            upload::CompletionCallback on_success;
+            if (journal != nullptr) {
+                on_success = [journal](const upload::UploadJob &job) {
+                    journal->record(job.x, job.y, job.level);
+                };
+            }
+            const upload::UploadResult result = upload::upload_all(options, source, logger, tracker, on_success);
+            logger << "Completed uploading of " << result.total_requests << " objects with " << result.errors << " errors";
+            if (result.retries > 0) {
+                logger << " after " << result.retries << " retries";
+            }
+            logger << "." << std::endl;
+            return result;
+        }
+
+    }
+
+    void export_world_to_http_async(const structs::World &world, const std::string &push_url, const config::Http &http_config, const std::string &auth_info, std::ostream &logger, memory::MemoryTracker *tracker, checkpoint::ExportJournal *journal) {
+        const upload::Options options = detail::upload_options(push_url, http_config, auth_info);
+
+        // Tiles are serialized lazily by the event loops whenever a transfer slot is free
+        const std::vector<structs::TileRef> units = structs::export_units(world);
+        std::atomic<std::size_t> next_unit{0};
+        const upload::JobSource source = [&units, &next_unit, journal](upload::UploadJob &job) {
+            std::size_t index;
+            do {
+                index = next_unit++;
+                if (index >= units.size()) {
+                    return upload::JobState::DONE;
+                }
+                job.x = units[index].first.x;
+                job.y = units[index].first.y;
+                job.level = units[index].first.level;
+            } while (journal != nullptr && journal->contains(job.x, job.y, job.level));
+            trace::Scope scope{"serialize", "export"};
+            std::stringstream body;
+            structs::stream_unit(body, units[index]);
+            job.body = body.str();
+            return upload::JobState::READY;
+        };
+        detail::upload_from_source(options, source, logger, tracker, journal);
+    }
+
+    void export_world_to_http_pipelined(structs::World &world, const pipeline::TileProcessor &processor, const int worker_threads, const std::string &push_url, const config::Http &http_config, const std::string &auth_info, std::ostream &logger, memory::MemoryTracker *tracker, checkpoint::ExportJournal *journal) {
+        const upload::Options options = detail::upload_options(push_url, http_config, auth_info);
+
+        // The bounded queue lets the post-processing run ahead of the uploads only by a limited number of units
+        ThreadSafeQueue<structs::TileRef> queue{static_cast<std::size_t>((http_config.pipeline_queue > 0) ? http_config.pipeline_queue : HTTP_PIPELINE_QUEUE_DEFAULT)};
+        std::atomic<bool> producing{true};
+        std::thread producer([&world, &processor, worker_threads, &queue, &producing](){
+            trace::set_thread_name("pipeline");
+            pipeline::process_world(world, processor, worker_threads, [&queue](const structs::TileRef &unit) {
+                queue.push(unit);
+                trace::counter("pipelined units", static_cast<std::int64_t>(queue.size()));
+            });
+            producing = false;
+        });
+
+        const upload::JobSource source = [&queue, &producing, journal](upload::UploadJob &job) {
+            structs::TileRef unit;
+            do {
+                // The flag is read before the queue, the queue can only be empty and stay empty after the producer stopped
+                const bool done = !producing;
+                if (!queue.try_pop(unit)) {
+                    return done ? upload::JobState::DONE : upload::JobState::LATER;
+                }
+                job.x = unit.first.x;
+                job.y = unit.first.y;
+                job.level = unit.first.level;
+            } while (journal != nullptr && journal->contains(job.x, job.y, job.level));
+            trace::Scope scope{"serialize", "export"};
+            std::stringstream body;
+            structs::stream_unit(body, unit);
+            job.body = body.str();
+            return upload::JobState::READY;
+        };
+        detail::upload_from_source(options, source, logger, tracker, journal);
+        producer.join();
+        processor.report(logger);
+    }
+
 }
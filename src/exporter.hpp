@@ -1,30 +1,71 @@
 #ifndef WORLD_GENERATOR_EXPORTER_HPP
 #define WORLD_GENERATOR_EXPORTER_HPP
 
+#include <atomic>
 #include <chrono>
 #include <string>
 #include <thread>
 #include <fstream>
 #include <iostream>
+#include <functional>
+#include <condition_variable>
 
 #include <cpr/api.h>
 
 #include "constants.hpp"
 #include "structs.hpp"
+#include "memory.hpp"
+#include "archive.hpp"
+#include "config.hpp"
+#include "uploader.hpp"
+#include "checkpoint.hpp"
+#include "pipeline.hpp"
+#include "queue.hpp"
+#include "trace.hpp"
 
 namespace rustymon {
 
     namespace detail {
 
-        std::pair<int, int> export_world_to_http_worker(const structs::World &world, const std::string &push_url, const std::string &auth_info, std::ostream &logger, int worker_count, int my_modulo);
+        /// Called on the writing thread with every serialized tile in the order of the given tiles
+        using TileConsumer = std::function<void(const structs::TileAddress &address, std::string &payload)>;
+
+        /// Tiles of the world as stored in it, addressed by their position in the world and their level
+        std::vector<structs::TileRef> world_tiles(const structs::World &world);
+
+        /**
+         * Serialize the tiles with a number of worker threads into per-tile buffers and pass them to
+         * the consumer in the given order, so the result is identical to a serial run. Tiles are serialized
+         * including their children if `nested` is set, otherwise as units (see structs::stream_unit).
+         * At most a few buffers per worker thread are held in memory while waiting for the consumer.
+         */
+        void serialize_tiles_in_order(const std::vector<structs::TileRef> &tiles, int worker_threads, const TileConsumer &consumer, bool nested);
+
+        /// Options of the asynchronous uploader, using the defaults for all unset settings
+        upload::Options upload_options(const std::string &push_url, const config::Http &http_config, const std::string &auth_info);
+
+        /// Upload all jobs of the source with the asynchronous uploader, recording the uploaded tiles in the journal (if any)
+        upload::UploadResult upload_from_source(const upload::Options &options, const upload::JobSource &source, std::ostream &logger, memory::MemoryTracker *tracker, checkpoint::ExportJournal *journal);
+
+        std::pair<int, int> export_world_to_http_worker(const std::vector<structs::TileRef> &units, const std::string &push_url, const std::string &auth_info, std::ostream &logger, int worker_count, int my_modulo, memory::MemoryTracker *tracker, checkpoint::ExportJournal *journal);
 
     }
 
-    void export_world_to_file(const structs::World &world, const std::string &filename, std::ostream &logger = std::cout);
+    void export_world_to_file(const structs::World &world, const std::string &filename, std::ostream &logger = std::cout, int worker_threads = SERIALIZE_DEFAULT_WORKER_THREADS);
+
+    void export_world_to_archive(const structs::World &world, const std::string &filename, std::ostream &logger = std::cout, int worker_threads = SERIALIZE_DEFAULT_WORKER_THREADS);
 
     void export_world_to_files(const structs::World &world, const std::string &directory, std::ostream &logger = std::cout);
 
-    void export_world_to_http(const structs::World &world, const std::string &push_url, const std::string &auth_info = "", std::ostream &logger = std::cout, int worker_threads = UPLOAD_DEFAULT_WORKER_THREADS);
+    void export_world_to_http(const structs::World &world, const std::string &push_url, const std::string &auth_info = "", std::ostream &logger = std::cout, int worker_threads = UPLOAD_DEFAULT_WORKER_THREADS, memory::MemoryTracker *tracker = nullptr, checkpoint::ExportJournal *journal = nullptr);
+
+    void export_world_to_http_async(const structs::World &world, const std::string &push_url, const config::Http &http_config, const std::string &auth_info = "", std::ostream &logger = std::cout, memory::MemoryTracker *tracker = nullptr, checkpoint::ExportJournal *journal = nullptr);
+
+    /**
+     * Post-process the tiles of the world with the processor and upload them with the event loops of the
+     * asynchronous exporter at the same time, so the first tiles are uploaded while others are still processed
+     */
+    void export_world_to_http_pipelined(structs::World &world, const pipeline::TileProcessor &processor, int worker_threads, const std::string &push_url, const config::Http &http_config, const std::string &auth_info = "", std::ostream &logger = std::cout, memory::MemoryTracker *tracker = nullptr, checkpoint::ExportJournal *journal = nullptr);
 
 }
 
@@ -70,9 +70,54 @@ namespace rustymon {
             return bbox;
         }
 
+        std::vector<std::string> get_input_files(const std::string& spec) {
+            std::stringstream spec_stream = std::stringstream(spec);
+            std::string segment;
+            std::vector<std::string> files;
+            while (std::getline(spec_stream, segment, INPUT_SPLIT_CHAR)) {
+                if (!segment.empty()) {
+                    files.push_back(segment);
+                }
+            }
+            if (files.empty()) {
+                std::cerr << "No input file given." << std::endl;
+                exit(2);
+            }
+            return files;
+        }
+
+        osmium::TagsFilter make_prefilter(const std::vector<config::ObjectProcessorEntry> &check_items) {
+            osmium::TagsFilter filter{false};
+            for (const config::ObjectProcessorEntry &item: check_items) {
+                if (item.required.empty() && item.forbidden.empty()) {
+                    continue;
+                }
+                if (item.required.empty()) {
+                    // Entries with only forbidden keys may match nearly everything
+                    filter.set_default_result(true);
+                    continue;
+                }
+
+                // Every required key must be present, so checking the most selective one is sufficient:
+                // a key restricted to the fewest values, or any key if none of them is restricted
+                auto selected = item.required.begin();
+                for (auto it = item.required.begin(); it != item.required.end(); ++it) {
+                    if (!it->second.empty() && (selected->second.empty() || it->second.size() < selected->second.size())) {
+                        selected = it;
+                    }
+                }
+                if (selected->second.empty()) {
+                    filter.add_rule(true, osmium::TagMatcher{selected->first});
+                } else {
+                    filter.add_rule(true, osmium::TagMatcher{selected->first, selected->second});
+                }
+            }
+            return filter;
+        }
+
     }
 
-    int WorldGenerator::get_details(const osmium::TagList &tags, const std::vector<config::ObjectProcessorEntry> &check_items, std::vector<int> &spawns) {
+    int WorldGenerator::get_details(const osmium::TagList &tags, const std::vector<config::ObjectProcessorEntry> &check_items, SpawnSet &spawns) {
         for (const config::ObjectProcessorEntry &item: check_items) {
             if (item.required.empty() && item.forbidden.empty()) {
                 continue;
@@ -112,9 +157,7 @@ namespace rustymon {
             }
 
             if (allowed) {
-                for (const int &s: item.spawns) {
-                    spawns.push_back(s);
-                }
+                spawns |= item.spawns;
                 return item.type;
             }
         }
@@ -122,9 +165,13 @@ namespace rustymon {
         return -1;
     }
 
+    inline void WorldGenerator::mark_changed(const int x_section, const int y_section) {
+        changed_tiles.insert((static_cast<std::uint64_t>(static_cast<std::uint32_t>(x_section)) << 32) | static_cast<std::uint32_t>(y_section));
+    }
+
     inline void WorldGenerator::ensure_exists_in_world(const int &x_section, const int &y_section) {
         tiles.insert(std::pair<int, std::map<int, structs::Tile>>{x_section, std::map<int, structs::Tile>()});
-        tiles.at(x_section).insert(std::pair<int, structs::Tile>{y_section, structs::Tile{
+        bool inserted = tiles.at(x_section).insert(std::pair<int, structs::Tile>{y_section, structs::Tile{
                 structs::BoundingBox(
                         static_cast<double>(x_section) / x_size_factor,
                         static_cast<double>(y_section) / y_size_factor,
@@ -134,12 +181,96 @@ namespace rustymon {
                 std::vector<structs::POI>{},
                 std::vector<structs::Street>{},
                 std::vector<structs::Area>{}
-        }});
+        }}).second;
+        if (inserted) {
+            memory_tracker.add(memory::Component::WORLD, sizeof(structs::Tile));
+        }
+        if (track_changes) {
+            mark_changed(x_section, y_section);
+        }
+    }
+
+    std::vector<std::pair<int, int>> WorldGenerator::take_changed_tiles() {
+        std::vector<std::pair<int, int>> result;
+        result.reserve(changed_tiles.size());
+        for (const std::uint64_t &key: changed_tiles) {
+            result.emplace_back(static_cast<int>(static_cast<std::uint32_t>(key >> 32)), static_cast<int>(static_cast<std::uint32_t>(key)));
+        }
+        changed_tiles.clear();
+        return result;
+    }
+
+    checkpoint::State WorldGenerator::restore(checkpoint::Checkpointer &checkpointer) {
+        checkpoint::State state = checkpointer.restore(tiles);
+        std::size_t world_size = 0;
+        for (auto const &x: tiles) {
+            for (auto const &y: x.second) {
+                world_size += structs::memory_usage(y.second);
+            }
+        }
+        memory_tracker.set(memory::Component::WORLD, world_size);
+        return state;
+    }
+
+    bool WorldGenerator::needs_node_locations(const osmium::Way &way) const {
+        SpawnSet spawns;
+        if (!way.ends_have_same_id() && get_details(way.tags(), config.streets, spawns) >= 0) {
+            return true;
+        }
+        if (config.coastline.enabled && coastline::is_coastline(way)) {
+            return true;
+        }
+        return way.nodes().size() > 3 && way.ends_have_same_id() && get_details(way.tags(), config.areas, spawns) >= 0;
+    }
+
+    std::size_t WorldGenerator::add_coastline(coastline::Coastline &coastline, const int worker_threads) {
+        coastline.prepare(x_size_factor, y_size_factor);
+        memory_tracker.set(memory::Component::COASTLINES, coastline.used_memory());
+
+        if (config.coastline.create_tiles) {
+            const structs::BoundingBox box(bbox.bottom_left().lon(), bbox.bottom_left().lat(), bbox.top_right().lon(), bbox.top_right().lat());
+            for (const std::pair<int, int> &position: coastline.crossed_tiles(box)) {
+                ensure_exists_in_world(position.first, position.second);
+            }
+        }
+
+        std::mutex mutex;
+        std::unordered_set<const structs::Tile *> changed;
+        std::atomic<std::size_t> added{0};
+        structs::for_each_tile_parallel(tiles, worker_threads, [this, &coastline, &mutex, &changed, &added](structs::Tile &tile) {
+            std::vector<coastline::Polygon> polygons = coastline.water_polygons(tile.bbox);
+            if (polygons.empty()) {
+                return;
+            }
+            for (coastline::Polygon &polygon: polygons) {
+                if (config.layout.shared_areas && polygon.holes.empty() && polygon.border == geometry::box_ring(tile.bbox)) {
+                    tile.covering.push_back(structs::AreaRef{0, config.coastline.type, config.coastline.spawns});
+                    memory_tracker.add(memory::Component::WORLD, structs::memory_usage(tile.covering.back()));
+                    continue;
+                }
+                tile.areas.push_back(structs::Area{0, config.coastline.type, std::move(polygon.border), config.coastline.spawns, std::move(polygon.holes)});
+                memory_tracker.add(memory::Component::WORLD, structs::memory_usage(tile.areas.back()));
+            }
+            added += polygons.size();
+            std::lock_guard<std::mutex> lock(mutex);
+            changed.insert(&tile);
+        });
+
+        if (track_changes) {
+            for (auto const &x: tiles) {
+                for (auto const &y: x.second) {
+                    if (changed.count(&y.second) > 0) {
+                        mark_changed(x.first, y.first);
+                    }
+                }
+            }
+        }
+        return added;
     }
 
     void WorldGenerator::node(const osmium::Node &node) {
         if (node.visible()) {
-            std::vector<int> spawns;
+            SpawnSet spawns;
             int type = get_details(node.tags(), config.poi, spawns);
             if (type < 0) {
                 return;
@@ -152,138 +283,666 @@ namespace rustymon {
                     node.id(),
                     type,
                     std::pair<double, double>{node.location().lon(), node.location().lat()},
-                    std::move(spawns)
+                    spawns
             });
+            memory_tracker.add(memory::Component::WORLD, structs::memory_usage(tiles.at(pos_x).at(pos_y).poi.back()));
+        }
+    }
+
+    void WorldGenerator::add_street(const long oid, const int type, const std::vector<std::pair<double, double>> &points) {
+        bool started = false;
+        int tile_x = 0;
+        int tile_y = 0;
+        std::vector<std::pair<double, double>> partial_street{points.front()};
+
+        auto flush = [&]() {
+            if (started && partial_street.size() > 1) {
+                ensure_exists_in_world(tile_x, tile_y);
+                tiles.at(tile_x).at(tile_y).streets.push_back(structs::Street{oid, type, std::move(partial_street)});
+                memory_tracker.add(memory::Component::WORLD, structs::memory_usage(tiles.at(tile_x).at(tile_y).streets.back()));
+            }
+        };
+
+        std::vector<double> cuts;
+        for (std::size_t i = 1; i < points.size(); i++) {
+            const std::pair<double, double> &a = points[i - 1];
+            const std::pair<double, double> &b = points[i];
+            const double dx = b.first - a.first;
+            const double dy = b.second - a.second;
+
+            // Parameters of all intersections of the segment with the tile borders
+            cuts.clear();
+            const int a_x = std::floor(a.first * x_size_factor);
+            const int b_x = std::floor(b.first * x_size_factor);
+            for (int x = std::min(a_x, b_x) + 1; x <= std::max(a_x, b_x); x++) {
+                cuts.push_back((static_cast<double>(x) / x_size_factor - a.first) / dx);
+            }
+            const int a_y = std::floor(a.second * y_size_factor);
+            const int b_y = std::floor(b.second * y_size_factor);
+            for (int y = std::min(a_y, b_y) + 1; y <= std::max(a_y, b_y); y++) {
+                cuts.push_back((static_cast<double>(y) / y_size_factor - a.second) / dy);
+            }
+            std::sort(cuts.begin(), cuts.end());
+            cuts.push_back(1);
+
+            double previous = 0;
+            for (const double &t: cuts) {
+                if (t - previous < STREET_SPLIT_EPSILON) {
+                    continue;
+                }
+                // The middle of every part of the segment decides about its tile
+                const double middle = (previous + t) / 2;
+                const int x = std::floor((a.first + middle * dx) * x_size_factor);
+                const int y = std::floor((a.second + middle * dy) * y_size_factor);
+                if (!started || x != tile_x || y != tile_y) {
+                    const std::pair<double, double> border = partial_street.back();
+                    flush();
+                    partial_street = {border};
+                    tile_x = x;
+                    tile_y = y;
+                    started = true;
+                }
+                partial_street.push_back(t >= 1 ? b : std::pair<double, double>{a.first + t * dx, a.second + t * dy});
+                previous = t;
+            }
         }
+        flush();
     }
 
     void WorldGenerator::way(const osmium::Way &way) {
         if (!way.ends_have_same_id() && !way.ends_have_same_location()) {
-            std::vector<int> spawns;
+            SpawnSet spawns;
             int type = get_details(way.tags(), config.streets, spawns);
             if (type < 0) {
                 return;
             }
 
-            const osmium::NodeRefList &nodes = way.nodes();
-            unsigned long way_length = nodes.size();
-            osmium::Box last_bbox;
-            std::vector<std::pair<double, double>> last_partial_street{};
-            for (int i = 0; i < way_length; i++) {
-                const osmium::NodeRef &node = nodes[i];
+            std::vector<std::pair<double, double>> points;
+            points.reserve(way.nodes().size());
+            for (const osmium::NodeRef &node: way.nodes()) {
                 if (!node.location() || !node.location().valid()) {
                     continue;
                 }
-                int pos_x = std::floor(node.location().lon() * x_size_factor);
-                int pos_y = std::floor(node.location().lat() * y_size_factor);
-                ensure_exists_in_world(pos_x, pos_y);
+                const std::pair<double, double> point{node.location().lon(), node.location().lat()};
+                if (points.empty() || points.back() != point) {
+                    points.push_back(point);
+                }
+            }
+            if (points.size() < 2) {
+                return;
+            }
 
-                if (!last_bbox.valid()) {
-                    last_bbox = osmium::Box{
-                            static_cast<double>(pos_x) / x_size_factor,
-                            static_cast<double>(pos_y) / y_size_factor,
-                            (static_cast<double>(pos_x) + 1) / x_size_factor,
-                            (static_cast<double>(pos_y) + 1) / y_size_factor
-                    };
+            // The street is split at the tile borders, the intersection with the
+            // border becomes the last point in one tile and the first in the next
+            add_street(way.id(), type, points);
+        }
+    }
+
+    void WorldGenerator::build_areas(const osmium::Area &area, std::vector<AreaPiece> &pieces) const {
+        if (!area.visible()) {
+            return;
+        }
+        SpawnSet spawns;
+        const int type = get_details(area.tags(), config.areas, spawns);
+        if (type < 0) {
+            return;
+        }
+
+        auto make_ring = [](const osmium::NodeRefList &nodes) {
+            geometry::Ring ring;
+            ring.reserve(nodes.size());
+            for (const osmium::NodeRef &node: nodes) {
+                const geometry::Point point{node.location().lon(), node.location().lat()};
+                if (ring.empty() || ring.back() != point) {
+                    ring.push_back(point);
                 }
+            }
+            return ring;
+        };
 
-                if (last_bbox.contains(node.location())) {
-                    // This node is in the same bounding box as the previous or the current
-                    // node, so we can just add it to the street in the current bounding box
-                    last_partial_street.emplace_back(node.lon(), node.lat());
-                } else {
-                    // This node is in another bounding box compared to the previous
-                    // node, so we "close" the current street and create a new one,
-                    // where "closing" implies:
-                    //   - the intersection of the line between the current node
-                    //     and the last node with the line of the bounding box forms
-                    //     a new location, which must be added to both partial streets
-                    //   - this node should always have a previous node, since the first
-                    //     node creates the bounding box by replacing the invalid old one
-                    //   - the completely constructed street should be added to the list
-                    //     of streets of the current tile before being replaced
-                    //   - the bounding box must be set to the correct values according
-                    //     to the new node (special care is required if the new node
-                    //     lies on the intersection of two or four bounding boxes!)
-                    // TODO: Implement the things mentioned above
+        for (const osmium::OuterRing &outer_ring: area.outer_rings()) {
+            const geometry::Ring border = make_ring(outer_ring);
+            if (border.size() < 4) {
+                continue;
+            }
+            std::vector<geometry::Ring> holes;
+            for (const osmium::InnerRing &inner_ring: area.inner_rings(outer_ring)) {
+                geometry::Ring hole = make_ring(inner_ring);
+                if (hole.size() >= 4) {
+                    holes.push_back(std::move(hole));
                 }
             }
 
+            double min_x = border.front().first;
+            double min_y = border.front().second;
+            double max_x = min_x;
+            double max_y = min_y;
+            for (const geometry::Point &point: border) {
+                min_x = std::min(min_x, point.first);
+                min_y = std::min(min_y, point.second);
+                max_x = std::max(max_x, point.first);
+                max_y = std::max(max_y, point.second);
+            }
+            // A ring ending exactly on a tile border doesn't reach into the next tile
+            const int x1 = std::floor(min_x * x_size_factor);
+            const int y1 = std::floor(min_y * y_size_factor);
+            const int x2 = std::max(x1, static_cast<int>(std::ceil(max_x * x_size_factor)) - 1);
+            const int y2 = std::max(y1, static_cast<int>(std::ceil(max_y * y_size_factor)) - 1);
+            const long tile_count = (static_cast<long>(x2) - x1 + 1) * (static_cast<long>(y2) - y1 + 1);
+            if (tile_count > AREA_MAX_TILES) {
+                std::cerr << "Skipping area " << area.orig_id() << " covering " << tile_count << " tiles" << std::endl;
+                continue;
+            }
+
+            geometry::CoveredCallback covered;
+            if (config.layout.shared_areas) {
+                covered = [&pieces, &area, type, spawns](int cx1, int cy1, int cx2, int cy2) {
+                    for (int x = cx1; x <= cx2; x++) {
+                        for (int y = cy1; y <= cy2; y++) {
+                            pieces.push_back(AreaPiece{x, y, structs::Area{area.orig_id(), type, {}, spawns}, true});
+                        }
+                    }
+                };
+            }
+            geometry::split_polygon(border, holes, x_size_factor, y_size_factor, x1, y1, x2, y2,
+                                    [&pieces, &area, type, spawns](int x, int y, geometry::Ring &part, std::vector<geometry::Ring> &part_holes) {
+                pieces.push_back(AreaPiece{x, y, structs::Area{area.orig_id(), type, std::move(part), spawns, std::move(part_holes)}, false});
+            }, covered);
+        }
+    }
+
+    void WorldGenerator::add_areas(std::vector<AreaPiece> &pieces) {
+        for (AreaPiece &piece: pieces) {
+            ensure_exists_in_world(piece.x, piece.y);
+            structs::Tile &tile = tiles.at(piece.x).at(piece.y);
+            if (piece.covering) {
+                tile.covering.push_back(structs::AreaRef{piece.area.oid, piece.area.type, piece.area.spawns});
+                memory_tracker.add(memory::Component::WORLD, structs::memory_usage(tile.covering.back()));
+                continue;
+            }
+            tile.areas.push_back(std::move(piece.area));
+            memory_tracker.add(memory::Component::WORLD, structs::memory_usage(tile.areas.back()));
         }
     }
 
     void WorldGenerator::area(const osmium::Area &area) {
-        if (area.visible()) {
-            std::vector<int> spawns;
-            int type = get_details(area.tags(), config.areas, spawns);
-            if (type < 0) {
+        std::vector<AreaPiece> pieces;
+        build_areas(area, pieces);
+        add_areas(pieces);
+    }
+
+    namespace reader {
+
+        void AreaMemberCollector::relation(const osmium::Relation &relation) {
+            const char *type = relation.tags().get_value_by_key("type");
+            if (type == nullptr || (std::strcmp(type, "multipolygon") != 0 && std::strcmp(type, "boundary") != 0)) {
                 return;
             }
+            if (!osmium::tags::match_any_of(relation.tags(), filter)) {
+                return;
+            }
+            for (const osmium::RelationMember &member: relation.members()) {
+                if (member.type() == osmium::item_type::way) {
+                    way_ids.set(member.positive_ref());
+                }
+            }
+        }
+
+        AreaAssemblyManager::AreaAssemblyManager(WorldGenerator &data_handler, const osmium::area::Assembler::config_type &assembler_config, const osmium::TagsFilter &filter, const int worker_threads) :
+                data_handler(data_handler),
+                assembler_config(assembler_config),
+                filter(filter),
+                pool(worker_threads),
+                max_pending(static_cast<std::size_t>(std::max(1, worker_threads)) * AREA_PENDING_JOBS_PER_THREAD) {
+        }
 
-            int outer_rings = 0;
-            int inner_rings = 0;
-            for (const auto &item: area) {
-                if (item.type() == osmium::item_type::outer_ring) {
-                    outer_rings++;
-                } else if (item.type() == osmium::item_type::inner_ring) {
-                    inner_rings++;
+        bool AreaAssemblyManager::new_relation(const osmium::Relation &relation) const {
+            const char *type = relation.tags().get_value_by_key("type");
+            if (type == nullptr || (std::strcmp(type, "multipolygon") != 0 && std::strcmp(type, "boundary") != 0)) {
+                return false;
+            }
+            return osmium::tags::match_any_of(relation.tags(), filter);
+        }
+
+        void AreaAssemblyManager::complete_relation(const osmium::Relation &relation) {
+            if (skip) {
+                return;
+            }
+            // The member ways are released after this call, so the job gets copies of them
+            osmium::memory::Buffer job{AREA_JOB_BUFFER_SIZE, osmium::memory::Buffer::auto_grow::yes};
+            job.add_item(relation);
+            job.commit();
+            for (const osmium::RelationMember &member: relation.members()) {
+                if (member.ref() == 0 || member.type() != osmium::item_type::way) {
+                    continue;
+                }
+                const osmium::Way *way = this->get_member_way(member.ref());
+                if (way != nullptr) {
+                    job.add_item(*way);
+                    job.commit();
                 }
             }
+            submit(std::move(job), true);
+        }
 
-            if (outer_rings < 1) {
-                std::cerr << "Invalid area definition found in area " << area.id() << std::endl;
+        void AreaAssemblyManager::way_not_in_any_relation(const osmium::Way &way) {
+            // Same conditions as in the multipolygon manager of libosmium
+            if (skip || way.nodes().size() <= 3 || !way.nodes().front().location() || !way.nodes().back().location()) {
                 return;
-            } else if (area.is_multipolygon() || outer_rings > 1 || inner_rings > 0) {
-                // TODO: add support for multi polygons
-                std::cerr << "Unsupported multi polygon in area " << area.id() << std::endl;
+            }
+            if (!way.ends_have_same_location() || way.tags().has_tag("area", "no") || osmium::tags::match_none_of(way.tags(), filter)) {
                 return;
             }
+            osmium::memory::Buffer job{AREA_JOB_BUFFER_SIZE, osmium::memory::Buffer::auto_grow::yes};
+            job.add_item(way);
+            job.commit();
+            submit(std::move(job), false);
+        }
 
-            Json::Value waypoints = Json::Value(Json::arrayValue);
-            for (const auto &item: area) {
-                if (item.type() == osmium::item_type::outer_ring) {
-                    const auto &ring = static_cast<const osmium::OuterRing &>(item);
-                    osmium::Location last_location;
-                    for (const osmium::NodeRef &node: ring) {
-                        if (last_location != node.location()) {
-                            last_location = node.location();
-                            //waypoints.append(helpers::make_point(last_location));
+        void AreaAssemblyManager::submit(osmium::memory::Buffer &&job, const bool is_relation) {
+            if (pending.size() >= max_pending) {
+                std::vector<AreaPiece> pieces = pending.front().get();
+                pending.pop_front();
+                data_handler.add_areas(pieces);
+            }
+            job_count++;
+
+            const WorldGenerator &generator = data_handler;
+            const osmium::area::Assembler::config_type &config = assembler_config;
+            trace::counter("pending area jobs", static_cast<std::int64_t>(pending.size()));
+            pending.push_back(pool.submit([&generator, &config, is_relation, job = std::move(job)]() {
+                trace::Scope scope{"assemble", "area"};
+                osmium::memory::Buffer areas{AREA_JOB_BUFFER_SIZE, osmium::memory::Buffer::auto_grow::yes};
+                osmium::area::Assembler assembler{config};
+                try {
+                    if (is_relation) {
+                        std::vector<const osmium::Way *> ways;
+                        for (const osmium::Way &way: job.select<osmium::Way>()) {
+                            ways.push_back(&way);
                         }
+                        assembler(job.get<osmium::Relation>(0), ways, areas);
+                    } else {
+                        assembler(job.get<osmium::Way>(0), areas);
                     }
+                } catch (const osmium::invalid_location &) {
+                    return std::vector<AreaPiece>{};
+                }
+
+                std::vector<AreaPiece> pieces;
+                for (const osmium::Area &area: areas.select<osmium::Area>()) {
+                    generator.build_areas(area, pieces);
+                }
+                return pieces;
+            }));
+        }
+
+        void AreaAssemblyManager::merge(const bool wait) {
+            trace::Scope scope{"merge areas", "reader"};
+            while (!pending.empty()) {
+                if (!wait && pending.front().wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                    return;
                 }
+                std::vector<AreaPiece> pieces = pending.front().get();
+                pending.pop_front();
+                data_handler.add_areas(pieces);
             }
+        }
 
-            Json::Value entry;
-            entry["type"] = type;
-            entry["oid"] = Json::Value::UInt64(static_cast<unsigned long>(area.id()));
-            entry["points"] = waypoints;
+        void ResumeGate::node(const osmium::Node &node) {
+            if (resume_after < checkpoint::Position{static_cast<std::uint16_t>(osmium::item_type::node), node.id()}) {
+                data_handler.node(node);
+            }
         }
-    }
 
-    namespace reader {
+        void ResumeGate::way(const osmium::Way &way) {
+            if (resume_after < checkpoint::Position{static_cast<std::uint16_t>(osmium::item_type::way), way.id()}) {
+                data_handler.way(way);
+            }
+        }
 
-        void read_from_file(WorldGenerator &data_handler, const std::string &in_file) {
-            const osmium::io::File input_file{in_file};
+        void SelectiveNodeLocations::node(const osmium::Node &node) {
+            if (node.id() > 0 && node_ids.get(node.positive_id())) {
+                index.set(node.positive_id(), node.location());
+            }
+        }
+
+        void SelectiveNodeLocations::way(osmium::Way &way) {
+            for (osmium::NodeRef &node_ref: way.nodes()) {
+                if (node_ref.ref() > 0) {
+                    node_ref.set_location(index.get_noexcept(node_ref.positive_ref()));
+                }
+            }
+        }
+
+        void configure_queue_sizes(const config::Reader &reader_config) {
+            // libosmium reads the queue sizes from the environment when a Reader is constructed
+            if (reader_config.input_queue > 0) {
+                setenv("OSMIUM_MAX_INPUT_QUEUE_SIZE", std::to_string(reader_config.input_queue).c_str(), 1);
+            }
+            if (reader_config.osmdata_queue > 0) {
+                setenv("OSMIUM_MAX_OSMDATA_QUEUE_SIZE", std::to_string(reader_config.osmdata_queue).c_str(), 1);
+            }
+        }
+
+        MergingReader::MergingReader(const std::vector<osmium::io::File> &files, osmium::thread::Pool &pool, const osmium::osm_entity_bits::type entities) {
+            // Versions are only needed to choose between duplicates, they're part of the skipped metadata otherwise
+            const osmium::io::read_meta meta = (files.size() > 1) ? osmium::io::read_meta::yes : osmium::io::read_meta::no;
+            inputs.reserve(files.size());
+            for (const osmium::io::File &file: files) {
+                inputs.push_back(Input{std::unique_ptr<osmium::io::Reader>(new osmium::io::Reader{file, pool, entities, meta}), {}, {}, {}});
+            }
+        }
+
+        bool MergingReader::advance(Input &input) {
+            if (input.buffer) {
+                ++input.current;
+            }
+            while (!input.buffer || input.current == input.end) {
+                input.buffer = input.reader->read();
+                if (!input.buffer) {
+                    return false;
+                }
+                input.current = input.buffer.begin<osmium::OSMObject>();
+                input.end = input.buffer.end<osmium::OSMObject>();
+            }
+            return true;
+        }
+
+        bool MergingReader::later(const std::size_t a, const std::size_t b) const {
+            return osmium::object_order_type_id_version()(*inputs[b].current, *inputs[a].current);
+        }
+
+        osmium::memory::Buffer MergingReader::read() {
+            if (inputs.size() == 1) {
+                return inputs.front().reader->read();
+            }
+            auto order = [this](const std::size_t a, const std::size_t b) {
+                return later(a, b);
+            };
+            if (!started) {
+                started = true;
+                for (std::size_t i = 0; i < inputs.size(); i++) {
+                    if (advance(inputs[i])) {
+                        heap.push_back(i);
+                    }
+                }
+                std::make_heap(heap.begin(), heap.end(), order);
+            }
+            if (heap.empty()) {
+                return osmium::memory::Buffer{};
+            }
+
+            osmium::memory::Buffer output{READER_MERGE_BUFFER_SIZE, osmium::memory::Buffer::auto_grow::yes};
+            std::vector<std::size_t> group;
+            while (!heap.empty() && output.committed() < READER_MERGE_BUFFER_SIZE) {
+                // Take the inputs of all copies of the next object, versions are in ascending order
+                group.clear();
+                std::pop_heap(heap.begin(), heap.end(), order);
+                group.push_back(heap.back());
+                heap.pop_back();
+                const osmium::OSMObject &first = *inputs[group.front()].current;
+                while (!heap.empty() && inputs[heap.front()].current->type() == first.type() && inputs[heap.front()].current->id() == first.id()) {
+                    std::pop_heap(heap.begin(), heap.end(), order);
+                    group.push_back(heap.back());
+                    heap.pop_back();
+                }
+                duplicates += group.size() - 1;
+
+                output.add_item(*inputs[group.back()].current);
+                output.commit();
+                for (const std::size_t i: group) {
+                    if (advance(inputs[i])) {
+                        heap.push_back(i);
+                        std::push_heap(heap.begin(), heap.end(), order);
+                    }
+                }
+            }
+            return output;
+        }
+
+        std::size_t MergingReader::file_size() const {
+            std::size_t size = 0;
+            for (const Input &input: inputs) {
+                size += input.reader->file_size();
+            }
+            return size;
+        }
+
+        bool MergingReader::sorted() {
+            return inputs.size() > 1 || inputs.front().reader->header().get("sorting") == "Type_then_ID";
+        }
+
+        void MergingReader::close() {
+            for (Input &input: inputs) {
+                input.reader->close();
+            }
+        }
+
+        void read_from_file(WorldGenerator &data_handler, const std::vector<std::string> &in_files, std::ostream &logger, checkpoint::Checkpointer *checkpointer, const checkpoint::Position resume_after) {
+            const std::vector<osmium::io::File> input_files(in_files.begin(), in_files.end());
+            const config::Config &config = data_handler.get_config();
+            memory::MemoryTracker &tracker = data_handler.get_memory_tracker();
+
+            configure_queue_sizes(config.reader);
+            const int decode_threads = (config.workers.decode > 0) ? config.workers.decode : DECODE_DEFAULT_WORKER_THREADS;
+            const int work_queue = (config.reader.work_queue > 0) ? config.reader.work_queue : READER_WORK_QUEUE_DEFAULT;
+            osmium::thread::Pool pool{decode_threads, static_cast<std::size_t>(work_queue)};
+            logger << "Using " << pool.num_threads() << " threads for decoding the input file." << std::endl;
+            if (input_files.size() > 1) {
+                logger << "Merging " << input_files.size() << " input files, which have to be sorted." << std::endl;
+            }
+
+            const auto start_time = std::chrono::steady_clock::now();
 
             osmium::area::Assembler::config_type assembler_config;
             assembler_config.create_empty_areas = false;
 
-            osmium::area::MultipolygonManager <osmium::area::Assembler> mp_manager{assembler_config};
-
-            osmium::relations::read_relations(input_file, mp_manager);
+            // Only relations and closed ways which could match an area rule are stored and assembled
+            const osmium::TagsFilter area_filter = helpers::make_prefilter(config.areas);
+            const int area_threads = (config.workers.area > 0) ? config.workers.area : AREA_DEFAULT_WORKER_THREADS;
+            AreaAssemblyManager mp_manager{data_handler, assembler_config, area_filter, area_threads};
+
+            const bool selective = config.reader.selective_locations;
+            id_set_type member_way_ids;
+            id_set_type node_ids;
+            AreaMemberCollector member_collector{area_filter, member_way_ids};
+
+            MergingReader relation_reader{input_files, pool, osmium::osm_entity_bits::relation};
+            {
+                trace::Scope scope{"relations", "reader"};
+                while (osmium::memory::Buffer buffer = relation_reader.read()) {
+                    if (selective) {
+                        osmium::apply(buffer, mp_manager, member_collector);
+                    } else {
+                        osmium::apply(buffer, mp_manager);
+                    }
+                }
+            }
+            relation_reader.close();
+            mp_manager.prepare_for_lookup();
             index_type index;
 
+            if (selective) {
+                // Collect the nodes of all ways which may become streets or areas, so that
+                // only their locations have to be stored in the index during the main pass
+                MergingReader way_reader{input_files, pool, osmium::osm_entity_bits::way};
+                trace::Scope scope{"referenced nodes", "reader"};
+                while (osmium::memory::Buffer buffer = way_reader.read()) {
+                    for (const osmium::Way &way: buffer.select<osmium::Way>()) {
+                        if (member_way_ids.get(way.positive_id()) || data_handler.needs_node_locations(way)) {
+                            for (const osmium::NodeRef &node_ref: way.nodes()) {
+                                if (node_ref.ref() > 0) {
+                                    node_ids.set(node_ref.positive_ref());
+                                }
+                            }
+                        }
+                    }
+                }
+                way_reader.close();
+                logger << "Storing the locations of " << node_ids.size() << " referenced nodes only." << std::endl;
+            }
+
+            // Coastlines are needed completely, so they are also collected while replaying
+            coastline::Coastline coastline{config.coastline.enabled};
+
+            auto update_memory_usage = [&tracker, &index, &node_ids, &member_way_ids, &mp_manager, &coastline]() {
+                const auto mp_usage = mp_manager.used_memory();
+                tracker.set(memory::Component::LOCATION_INDEX, index.used_memory() + node_ids.used_memory() + member_way_ids.used_memory());
+                tracker.set(memory::Component::MULTIPOLYGON_MANAGER, mp_usage.relations_db + mp_usage.members_db + mp_usage.stash);
+                tracker.set(memory::Component::COASTLINES, coastline.used_memory());
+            };
+            auto check_memory_budget = [&tracker, &update_memory_usage](const char *stage) {
+                update_memory_usage();
+                if (tracker.exceeded()) {
+                    std::cerr << "Memory budget exceeded " << stage << ". Current memory usage:" << std::endl;
+                    tracker.report(std::cerr);
+                    std::cerr << "Use a smaller bounding box or input file, or increase 'memory.budget'." << std::endl;
+                    exit(3);
+                }
+            };
+            check_memory_budget("after reading the relations");
+
             location_handler_type location_handler{index};
             location_handler.ignore_errors();
+            SelectiveNodeLocations selective_location_handler{index, node_ids};
+
+            // Areas are assembled by the area workers, the results of all objects completed before a checkpoint
+            // are merged before saving it, so the areas completed before the resume position have already been processed
+            auto mp_handler = mp_manager.handler([](osmium::memory::Buffer &&) {});
+            ResumeGate resume_gate{data_handler, resume_after};
+            if (resume_after.valid()) {
+                logger << "Resuming after object " << resume_after.id << " of type " << resume_after.type << "." << std::endl;
+            }
+
+            MergingReader reader{input_files, pool, osmium::osm_entity_bits::all};
+
+            // While tracing, the handlers are applied to every buffer one after the other, so each of them
+            // gets a span of its own; the result is the same since the locations are set before the ways are used
+            auto apply_handlers = [&](osmium::memory::Buffer &buffer, const bool skip) {
+                if (!trace::enabled) {
+                    if (skip) {
+                        if (selective) {
+                            osmium::apply(buffer, selective_location_handler, mp_handler, coastline);
+                        } else {
+                            osmium::apply(buffer, location_handler, mp_handler, coastline);
+                        }
+                    } else if (resume_after.valid()) {
+                        if (selective) {
+                            osmium::apply(buffer, selective_location_handler, resume_gate, mp_handler, coastline);
+                        } else {
+                            osmium::apply(buffer, location_handler, resume_gate, mp_handler, coastline);
+                        }
+                    } else if (selective) {
+                        osmium::apply(buffer, selective_location_handler, data_handler, mp_handler, coastline);
+                    } else {
+                        osmium::apply(buffer, location_handler, data_handler, mp_handler, coastline);
+                    }
+                    return;
+                }
+
+                {
+                    trace::Scope scope{"locations", "reader"};
+                    if (selective) {
+                        osmium::apply(buffer, selective_location_handler);
+                    } else {
+                        osmium::apply(buffer, location_handler);
+                    }
+                }
+                if (!skip) {
+                    trace::Scope scope{"objects", "generator"};
+                    if (resume_after.valid()) {
+                        osmium::apply(buffer, resume_gate);
+                    } else {
+                        osmium::apply(buffer, data_handler);
+                    }
+                }
+                {
+                    trace::Scope scope{"multipolygon", "reader"};
+                    osmium::apply(buffer, mp_handler);
+                }
+                if (config.coastline.enabled) {
+                    trace::Scope scope{"coastline", "reader"};
+                    osmium::apply(buffer, coastline);
+                }
+            };
+
+            // Without a sort order relations may be followed by further nodes and ways
+            const bool sorted = reader.sorted();
+            if (!sorted) {
+                logger << "The input file isn't declared as sorted, it's read to the end." << std::endl;
+            }
+
+            unsigned long buffer_count = 0;
+            checkpoint::Position position{0, 0};
+            while (true) {
+                osmium::memory::Buffer buffer;
+                {
+                    trace::Scope scope{"read", "reader"};
+                    buffer = reader.read();
+                }
+                if (!buffer) {
+                    break;
+                }
+                // Relations were read in the first pass and none of the handlers below uses them, so nothing
+                // after the first block of relations of a sorted file can change any tile anymore
+                auto objects = buffer.select<osmium::OSMObject>();
+                if (sorted && objects.begin() != objects.end() && objects.begin()->type() == osmium::item_type::relation) {
+                    logger << "Stopped reading at the relations, all tiles are complete." << std::endl;
+                    break;
+                }
+                for (const osmium::OSMObject &object: objects) {
+                    position = checkpoint::Position{static_cast<std::uint16_t>(object.type()), object.id()};
+                }
 
-            osmium::io::Reader reader{input_file, osmium::io::read_meta::no};
+                if (resume_after.valid() && !(resume_after < position)) {
+                    mp_manager.set_skip(true);
+                    apply_handlers(buffer, true);
+                    continue;
+                }
+                mp_manager.set_skip(false);
 
-            osmium::apply(reader, location_handler, data_handler,
-                          mp_manager.handler([&data_handler](const osmium::memory::Buffer &area_buffer) {
-                              osmium::apply(area_buffer, data_handler);
-                          }));
+                apply_handlers(buffer, false);
+                mp_manager.merge(false);
+                if (++buffer_count % MEMORY_CHECK_INTERVAL_BUFFERS == 0) {
+                    check_memory_budget("while reading the input file");
+                }
+                if (checkpointer != nullptr && checkpointer->due()) {
+                    trace::Scope scope{"checkpoint", "reader"};
+                    mp_manager.merge(true);
+                    checkpointer->save(data_handler.get_world(), data_handler.take_changed_tiles(), position, false);
+                }
+            }
 
+            const std::size_t input_size = reader.file_size();
+            if (input_files.size() > 1) {
+                logger << "Skipped " << reader.get_duplicates() << " objects contained in more than one input file." << std::endl;
+            }
             reader.close();
+            mp_manager.merge(true);
+            update_memory_usage();
+            logger << "Assembled " << mp_manager.get_job_count() << " relations and closed ways on "
+                   << mp_manager.get_thread_count() << " area worker threads." << std::endl;
+
+            if (config.coastline.enabled) {
+                trace::Scope scope{"coastline", "generator"};
+                const std::size_t water_areas = data_handler.add_coastline(coastline, area_threads);
+                logger << "Joined " << coastline.way_count() << " coastline ways into " << coastline.chain_count()
+                       << " chains and added " << water_areas << " water areas." << std::endl;
+            }
+
+            if (checkpointer != nullptr) {
+                trace::Scope scope{"checkpoint", "reader"};
+                if (checkpointer->save(data_handler.get_world(), data_handler.take_changed_tiles(), position, true, true)) {
+                    logger << "Saved the final checkpoint to " << checkpointer->get_directory() << "." << std::endl;
+                }
+            }
+
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+            logger << "Read " << buffer_count << " buffers (" << input_size / (1024 * 1024) << " MiB) in " << seconds << " s";
+            if (seconds > 0 && input_size > 0) {
+                logger << " (" << static_cast<double>(input_size) / (1024 * 1024) / seconds << " MiB/s)";
+            }
+            logger << "." << std::endl;
         }
 
     }
@@ -1,27 +1,47 @@
 #ifndef WORLD_GENERATOR_GENERATOR_HPP
 #define WORLD_GENERATOR_GENERATOR_HPP
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
 
 #include <json/json.h>
 #include <osmium/handler.hpp>
 #include <osmium/visitor.hpp>
 #include <osmium/area/assembler.hpp>
-#include <osmium/area/multipolygon_manager.hpp>
 #include <osmium/geom/coordinates.hpp>
 #include <osmium/handler/node_locations_for_ways.hpp>
+#include <osmium/index/id_set.hpp>
 #include <osmium/index/map/flex_mem.hpp>
 #include <osmium/io/any_input.hpp>
 #include <osmium/osm/area.hpp>
 #include <osmium/osm/node.hpp>
+#include <osmium/osm/object_comparisons.hpp>
 #include <osmium/osm/way.hpp>
 #include <osmium/relations/relations_manager.hpp>
+#include <osmium/tags/taglist.hpp>
+#include <osmium/tags/tags_filter.hpp>
+#include <osmium/thread/pool.hpp>
 
 #include "constants.hpp"
 #include "structs.hpp"
 #include "config.hpp"
+#include "memory.hpp"
+#include "checkpoint.hpp"
+#include "coastline.hpp"
+#include "geometry.hpp"
+#include "trace.hpp"
 
 namespace rustymon {
 
@@ -37,8 +57,27 @@ namespace rustymon {
 
         osmium::Box get_bbox(const std::string& spec);
 
+        /// Names of the input files in a comma separated list
+        std::vector<std::string> get_input_files(const std::string& spec);
+
+        /**
+         * Build a tags filter accepting every object which could possibly match one of the given entries.
+         * It's a conservative pre-filter: it checks only one required key per entry and ignores
+         * forbidden keys, so the final decision is still up to the full check in get_details.
+         */
+        osmium::TagsFilter make_prefilter(const std::vector<config::ObjectProcessorEntry> &check_items);
+
     }
 
+    /// Part of an area inside a single tile
+    struct AreaPiece {
+        int x;
+        int y;
+        structs::Area area;
+        /// The area covers the whole tile, so only a reference to it is stored (the border is empty)
+        bool covering;
+    };
+
     class WorldGenerator : public osmium::handler::Handler {
         int x_size_factor = X_SIZE_FACTOR_DEFAULT;
         int y_size_factor = Y_SIZE_FACTOR_DEFAULT;
@@ -46,8 +85,12 @@ namespace rustymon {
         osmium::Box bbox;
         config::Config config;
         structs::World tiles;
+        memory::MemoryTracker memory_tracker;
 
-        static int get_details(const osmium::TagList &tags, const std::vector<config::ObjectProcessorEntry> &check_items, std::vector<int> &spawns);
+        bool track_changes = false;
+        std::unordered_set<std::uint64_t> changed_tiles;
+
+        static int get_details(const osmium::TagList &tags, const std::vector<config::ObjectProcessorEntry> &check_items, SpawnSet &spawns);
 
         inline void check_valid_bbox() {
             if (!this->bbox.valid()) {
@@ -56,13 +99,19 @@ namespace rustymon {
             }
         }
 
+        inline void mark_changed(int x_section, int y_section);
+
         inline void ensure_exists_in_world(const int &x_section, const int &y_section);
 
+        /// Add the street to the world, split into one part per tile it crosses
+        void add_street(long oid, int type, const std::vector<std::pair<double, double>> &points);
+
     public:
 
         explicit WorldGenerator() :
             config(config::load_config_from_file(DEFAULT_CONFIG_FILENAME)),
-            bbox(osmium::Box(-180, -90, 180, 90)) {
+            bbox(osmium::Box(-180, -90, 180, 90)),
+            memory_tracker(this->config.memory.budget) {
             check_valid_bbox();
             x_size_factor = (config.size.x > 0) ? config.size.x : X_SIZE_FACTOR_DEFAULT;
             y_size_factor = (config.size.y > 0) ? config.size.y : Y_SIZE_FACTOR_DEFAULT;
@@ -70,7 +119,8 @@ namespace rustymon {
 
         explicit WorldGenerator(const config::Config &config, const osmium::Box &bbox = osmium::Box(-180, -90, 180, 90)) :
             config(config),
-            bbox(bbox) {
+            bbox(bbox),
+            memory_tracker(config.memory.budget) {
             check_valid_bbox();
             x_size_factor = (config.size.x > 0) ? config.size.x : X_SIZE_FACTOR_DEFAULT;
             y_size_factor = (config.size.y > 0) ? config.size.y : Y_SIZE_FACTOR_DEFAULT;
@@ -78,7 +128,8 @@ namespace rustymon {
 
         explicit WorldGenerator(const std::string &config_filename, const osmium::Box &bbox = osmium::Box(-180, -90, 180, 90)) :
             config(config::load_config_from_file(config_filename)),
-            bbox(bbox) {
+            bbox(bbox),
+            memory_tracker(this->config.memory.budget) {
             check_valid_bbox();
             x_size_factor = (config.size.x > 0) ? config.size.x : X_SIZE_FACTOR_DEFAULT;
             y_size_factor = (config.size.y > 0) ? config.size.y : Y_SIZE_FACTOR_DEFAULT;
@@ -88,6 +139,43 @@ namespace rustymon {
             return this->tiles;
         }
 
+        inline const config::Config& get_config() const {
+            return this->config;
+        }
+
+        inline memory::MemoryTracker& get_memory_tracker() {
+            return this->memory_tracker;
+        }
+
+        /// Remember which tiles have been changed, to be retrieved via take_changed_tiles
+        inline void enable_change_tracking() {
+            this->track_changes = true;
+        }
+
+        /// Get the positions of all tiles changed since the last call and reset the list
+        std::vector<std::pair<int, int>> take_changed_tiles();
+
+        /// Restore the world from the given checkpoints
+        checkpoint::State restore(checkpoint::Checkpointer &checkpointer);
+
+        /// Check whether the way may be used as street or area, i.e. whether its node locations are needed
+        bool needs_node_locations(const osmium::Way &way) const;
+
+        /**
+         * Prepare the collected coastlines and add the water areas to all tiles covered by the sea.
+         * Returns the number of added areas.
+         */
+        std::size_t add_coastline(coastline::Coastline &coastline, int worker_threads);
+
+        /**
+         * Classify the area and split it into the parts in every tile it covers. This doesn't
+         * change the generator, so it may be called from any thread.
+         */
+        void build_areas(const osmium::Area &area, std::vector<AreaPiece> &pieces) const;
+
+        /// Add the area parts to their tiles
+        void add_areas(std::vector<AreaPiece> &pieces);
+
         void node(const osmium::Node &node);
 
         void way(const osmium::Way &way);
@@ -99,8 +187,163 @@ namespace rustymon {
 
         using index_type = osmium::index::map::FlexMem<osmium::unsigned_object_id_type, osmium::Location>;
         using location_handler_type = osmium::handler::NodeLocationsForWays<index_type>;
+        using id_set_type = osmium::index::IdSetDense<osmium::unsigned_object_id_type>;
+
+        /**
+         * Collect the IDs of all member ways of relations which may be assembled to areas
+         */
+        class AreaMemberCollector : public osmium::handler::Handler {
+            const osmium::TagsFilter &filter;
+            id_set_type &way_ids;
+
+        public:
+
+            AreaMemberCollector(const osmium::TagsFilter &filter, id_set_type &way_ids) : filter(filter), way_ids(way_ids) {}
+
+            void relation(const osmium::Relation &relation);
+        };
+
+        /**
+         * Multipolygon manager assembling the areas on a thread pool instead of the reading thread. Every
+         * completed relation (and closed way which isn't a member of any relation) is copied into a job
+         * buffer of its own, then assembled and split into tile parts by a worker. The results are merged
+         * into the world in the order the objects were completed, so they don't depend on the number of threads.
+         */
+        class AreaAssemblyManager : public osmium::relations::RelationsManager<AreaAssemblyManager, false, true, false> {
+            WorldGenerator &data_handler;
+            const osmium::area::Assembler::config_type assembler_config;
+            const osmium::TagsFilter filter;
+            osmium::thread::Pool pool;
+            std::deque<std::future<std::vector<AreaPiece>>> pending;
+            const std::size_t max_pending;
+            std::size_t job_count = 0;
+            bool skip = false;
+
+            void submit(osmium::memory::Buffer &&job, bool is_relation);
+
+        public:
+
+            AreaAssemblyManager(WorldGenerator &data_handler, const osmium::area::Assembler::config_type &assembler_config, const osmium::TagsFilter &filter, int worker_threads);
+
+            /// Drop the objects completed from now on, used while replaying the input up to a resume position
+            inline void set_skip(const bool value) {
+                skip = value;
+            }
+
+            inline std::size_t get_job_count() const {
+                return job_count;
+            }
 
-        void read_from_file(WorldGenerator &data_handler, const std::string &in_file);
+            inline int get_thread_count() const {
+                return pool.num_threads();
+            }
+
+            bool new_relation(const osmium::Relation &relation) const;
+
+            void complete_relation(const osmium::Relation &relation);
+
+            void way_not_in_any_relation(const osmium::Way &way);
+
+            /// Merge the results of the finished jobs into the world in order, waiting for all jobs if `wait` is set
+            void merge(bool wait);
+        };
+
+        /**
+         * Handler forwarding only the nodes and ways after the resume position of a checkpoint
+         */
+        class ResumeGate : public osmium::handler::Handler {
+            WorldGenerator &data_handler;
+            const checkpoint::Position resume_after;
+
+        public:
+
+            ResumeGate(WorldGenerator &data_handler, const checkpoint::Position resume_after) : data_handler(data_handler), resume_after(resume_after) {}
+
+            void node(const osmium::Node &node);
+
+            void way(const osmium::Way &way);
+        };
+
+        /**
+         * Location handler storing only the locations of the nodes in the given set of IDs,
+         * the locations of all other nodes will be invalid when they are added to ways
+         */
+        class SelectiveNodeLocations : public osmium::handler::Handler {
+            index_type &index;
+            const id_set_type &node_ids;
+
+        public:
+
+            SelectiveNodeLocations(index_type &index, const id_set_type &node_ids) : index(index), node_ids(node_ids) {}
+
+            void node(const osmium::Node &node);
+
+            void way(osmium::Way &way);
+        };
+
+        void configure_queue_sizes(const config::Reader &reader_config);
+
+        /**
+         * Reads several sorted input files at the same time, all of them decoded by the shared thread pool,
+         * and merges them into one stream of buffers in the order of object type and ID. Objects contained in
+         * more than one file, e.g. at the borders of overlapping extracts, are passed on once in their highest
+         * version. The buffers of a single input file are passed on unchanged.
+         */
+        class MergingReader {
+            struct Input {
+                std::unique_ptr<osmium::io::Reader> reader;
+                osmium::memory::Buffer buffer;
+                osmium::memory::Buffer::t_iterator<osmium::OSMObject> current;
+                osmium::memory::Buffer::t_iterator<osmium::OSMObject> end;
+            };
+
+            std::vector<Input> inputs;
+            /// Min-heap of the inputs which aren't exhausted, ordered by their current object
+            std::vector<std::size_t> heap;
+            bool started = false;
+            std::size_t duplicates = 0;
+
+            /// Move to the next object of the input, reading its next buffer if necessary; false if it's exhausted
+            bool advance(Input &input);
+
+            /// Whether the current object of input b comes before the current object of input a
+            bool later(std::size_t a, std::size_t b) const;
+
+        public:
+
+            MergingReader(const std::vector<osmium::io::File> &files, osmium::thread::Pool &pool, osmium::osm_entity_bits::type entities);
+
+            /// Next buffer of objects, an invalid buffer after the end of all inputs
+            osmium::memory::Buffer read();
+
+            /// Total size of all input files
+            std::size_t file_size() const;
+
+            /**
+             * Whether the objects are read in the order of their type and ID: merged inputs have to be
+             * sorted, a single input only counts as sorted if its header declares sorting=Type_then_ID
+             */
+            bool sorted();
+
+            void close();
+
+            /// Number of objects dropped because they were contained in another input file
+            std::size_t get_duplicates() const {
+                return duplicates;
+            }
+        };
+
+        /**
+         * Read the input files into the generator, optionally writing checkpoints. If a valid resume position
+         * is given, the objects up to this position have already been processed by the generator and are
+         * only used for building the location index and the multipolygon relations. Several (overlapping)
+         * input files are read concurrently and merged, see MergingReader.
+         */
+        void read_from_file(WorldGenerator &data_handler, const std::vector<std::string> &in_files, std::ostream &logger = std::cout, checkpoint::Checkpointer *checkpointer = nullptr, checkpoint::Position resume_after = checkpoint::Position{0, 0});
+
+        inline void read_from_file(WorldGenerator &data_handler, const std::string &in_file, std::ostream &logger = std::cout, checkpoint::Checkpointer *checkpointer = nullptr, checkpoint::Position resume_after = checkpoint::Position{0, 0}) {
+            read_from_file(data_handler, std::vector<std::string>{in_file}, logger, checkpointer, resume_after);
+        }
 
     }
 
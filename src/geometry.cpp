@@ -0,0 +1,266 @@
+#include "geometry.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+namespace rustymon {
+
+    namespace geometry {
+
+        static const double BORDER_TOLERANCE = 1e-9;
+
+        namespace {
+
+            inline Point clamp_to_box(const structs::BoundingBox &box, const Point &point) {
+                return Point{
+                        std::min(std::max(point.first, box.bottom_left.first), box.top_right.first),
+                        std::min(std::max(point.second, box.bottom_left.second), box.top_right.second)
+                };
+            }
+
+        }
+
+        bool clip_segment(const structs::BoundingBox &box, Point &a, Point &b, double &entry, double &exit) {
+            const double dx = b.first - a.first;
+            const double dy = b.second - a.second;
+            const double p[4] = {-dx, dx, -dy, dy};
+            const double q[4] = {
+                    a.first - box.bottom_left.first,
+                    box.top_right.first - a.first,
+                    a.second - box.bottom_left.second,
+                    box.top_right.second - a.second
+            };
+
+            entry = 0;
+            exit = 1;
+            for (int i = 0; i < 4; i++) {
+                if (p[i] == 0) {
+                    if (q[i] < 0) {
+                        return false;
+                    }
+                    continue;
+                }
+                const double r = q[i] / p[i];
+                if (p[i] < 0) {
+                    if (r > exit) {
+                        return false;
+                    }
+                    entry = std::max(entry, r);
+                } else {
+                    if (r < entry) {
+                        return false;
+                    }
+                    exit = std::min(exit, r);
+                }
+            }
+
+            // Points inside the box are kept exactly, so that they can be compared with the original ones
+            const Point start = a;
+            if (entry > 0) {
+                a = clamp_to_box(box, Point{start.first + entry * dx, start.second + entry * dy});
+            }
+            if (exit < 1) {
+                b = clamp_to_box(box, Point{start.first + exit * dx, start.second + exit * dy});
+            }
+            return true;
+        }
+
+        std::vector<Ring> clip_polyline(const structs::BoundingBox &box, const Ring &points) {
+            std::vector<Ring> parts;
+            Ring current;
+            for (std::size_t i = 0; i + 1 < points.size(); i++) {
+                Point a = points[i];
+                Point b = points[i + 1];
+                double entry, exit;
+                if (!clip_segment(box, a, b, entry, exit) || a == b) {
+                    continue;
+                }
+                if (!current.empty() && (entry > 0 || current.back() != a)) {
+                    parts.push_back(std::move(current));
+                    current.clear();
+                }
+                if (current.empty()) {
+                    current.push_back(a);
+                }
+                current.push_back(b);
+            }
+            if (current.size() > 1) {
+                parts.push_back(std::move(current));
+            }
+            return parts;
+        }
+
+        Ring clip_ring(const structs::BoundingBox &box, const Ring &ring) {
+            Ring output = ring;
+            if (output.size() > 1 && output.front() == output.back()) {
+                output.pop_back();
+            }
+
+            // Clip against the left, right, bottom and top edge of the box in turn
+            for (int edge = 0; edge < 4 && !output.empty(); edge++) {
+                const bool vertical = edge < 2;
+                const double border = (edge == 0) ? box.bottom_left.first :
+                                      (edge == 1) ? box.top_right.first :
+                                      (edge == 2) ? box.bottom_left.second : box.top_right.second;
+                auto inside = [edge, vertical, border](const Point &p) {
+                    const double value = vertical ? p.first : p.second;
+                    return (edge % 2 == 0) ? value >= border : value <= border;
+                };
+                auto intersection = [vertical, border](const Point &a, const Point &b) {
+                    if (vertical) {
+                        const double t = (border - a.first) / (b.first - a.first);
+                        return Point{border, a.second + t * (b.second - a.second)};
+                    }
+                    const double t = (border - a.second) / (b.second - a.second);
+                    return Point{a.first + t * (b.first - a.first), border};
+                };
+
+                const Ring input = std::move(output);
+                output.clear();
+                Point previous = input.back();
+                for (const Point &point: input) {
+                    if (inside(point)) {
+                        if (!inside(previous)) {
+                            output.push_back(intersection(previous, point));
+                        }
+                        output.push_back(point);
+                    } else if (inside(previous)) {
+                        output.push_back(intersection(previous, point));
+                    }
+                    previous = point;
+                }
+            }
+
+            if (output.size() < 3) {
+                return Ring{};
+            }
+            output.push_back(output.front());
+            return output;
+        }
+
+        void split_polygon(const Ring &border, const std::vector<Ring> &holes, const int x_size_factor, const int y_size_factor,
+                           const int x1, const int y1, const int x2, const int y2, const PolygonCallback &callback, const CoveredCallback &covered) {
+            const structs::BoundingBox box(
+                    static_cast<double>(x1) / x_size_factor,
+                    static_cast<double>(y1) / y_size_factor,
+                    (static_cast<double>(x2) + 1) / x_size_factor,
+                    (static_cast<double>(y2) + 1) / y_size_factor
+            );
+            Ring part = clip_ring(box, border);
+            const double area = std::abs(signed_area(part));
+            if (part.empty() || area == 0) {
+                return;
+            }
+            std::vector<Ring> part_holes;
+            for (const Ring &hole: holes) {
+                Ring clipped = clip_ring(box, hole);
+                const double hole_area = std::abs(signed_area(clipped));
+                if (clipped.empty() || hole_area == 0) {
+                    continue;
+                }
+                // Holes lie inside the border, so this hole covers everything which is left in the box
+                if (hole_area >= area * (1 - BORDER_TOLERANCE)) {
+                    return;
+                }
+                part_holes.push_back(std::move(clipped));
+            }
+
+            const double box_area = (box.top_right.first - box.bottom_left.first) * (box.top_right.second - box.bottom_left.second);
+            if (covered && part_holes.empty() && area >= box_area * (1 - BORDER_TOLERANCE)) {
+                covered(x1, y1, x2, y2);
+            } else if (x1 == x2 && y1 == y2) {
+                callback(x1, y1, part, part_holes);
+            } else if (x2 - x1 >= y2 - y1) {
+                const int middle = x1 + (x2 - x1) / 2;
+                split_polygon(part, part_holes, x_size_factor, y_size_factor, x1, y1, middle, y2, callback, covered);
+                split_polygon(part, part_holes, x_size_factor, y_size_factor, middle + 1, y1, x2, y2, callback, covered);
+            } else {
+                const int middle = y1 + (y2 - y1) / 2;
+                split_polygon(part, part_holes, x_size_factor, y_size_factor, x1, y1, x2, middle, callback, covered);
+                split_polygon(part, part_holes, x_size_factor, y_size_factor, x1, middle + 1, x2, y2, callback, covered);
+            }
+        }
+
+        double signed_area(const Ring &ring) {
+            double area = 0;
+            for (std::size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+                area += (ring[j].first - ring[i].first) * (ring[j].second + ring[i].second);
+            }
+            return area / 2;
+        }
+
+        bool contains(const Ring &ring, const Point &point) {
+            bool inside = false;
+            for (std::size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+                const Point &a = ring[i];
+                const Point &b = ring[j];
+                if ((a.second > point.second) != (b.second > point.second) &&
+                        point.first < (b.first - a.first) * (point.second - a.second) / (b.second - a.second) + a.first) {
+                    inside = !inside;
+                }
+            }
+            return inside;
+        }
+
+        bool on_border(const structs::BoundingBox &box, const Point &point) {
+            return std::abs(point.first - box.bottom_left.first) < BORDER_TOLERANCE ||
+                   std::abs(point.first - box.top_right.first) < BORDER_TOLERANCE ||
+                   std::abs(point.second - box.bottom_left.second) < BORDER_TOLERANCE ||
+                   std::abs(point.second - box.top_right.second) < BORDER_TOLERANCE;
+        }
+
+        Point nearest_border_point(const structs::BoundingBox &box, const Point &point) {
+            const Point inner = clamp_to_box(box, point);
+            const double left = inner.first - box.bottom_left.first;
+            const double right = box.top_right.first - inner.first;
+            const double bottom = inner.second - box.bottom_left.second;
+            const double top = box.top_right.second - inner.second;
+            const double nearest = std::min(std::min(left, right), std::min(bottom, top));
+            if (nearest == left) {
+                return Point{box.bottom_left.first, inner.second};
+            } else if (nearest == right) {
+                return Point{box.top_right.first, inner.second};
+            } else if (nearest == bottom) {
+                return Point{inner.first, box.bottom_left.second};
+            }
+            return Point{inner.first, box.top_right.second};
+        }
+
+        double border_position(const structs::BoundingBox &box, const Point &point) {
+            const Point border = nearest_border_point(box, point);
+            const double width = box.top_right.first - box.bottom_left.first;
+            const double height = box.top_right.second - box.bottom_left.second;
+
+            double position;
+            if (border.first == box.bottom_left.first && border.second < box.top_right.second) {
+                position = (border.second - box.bottom_left.second) / height;
+            } else if (border.second == box.top_right.second && border.first < box.top_right.first) {
+                position = 1 + (border.first - box.bottom_left.first) / width;
+            } else if (border.first == box.top_right.first && border.second > box.bottom_left.second) {
+                position = 2 + (box.top_right.second - border.second) / height;
+            } else {
+                position = 3 + (box.top_right.first - border.first) / width;
+            }
+            return position >= 4 ? 0 : position;
+        }
+
+        Point border_corner(const structs::BoundingBox &box, const int position) {
+            switch (((position % 4) + 4) % 4) {
+                case 0:
+                    return box.bottom_left;
+                case 1:
+                    return Point{box.bottom_left.first, box.top_right.second};
+                case 2:
+                    return box.top_right;
+                default:
+                    return Point{box.top_right.first, box.bottom_left.second};
+            }
+        }
+
+        Ring box_ring(const structs::BoundingBox &box) {
+            return Ring{border_corner(box, 0), border_corner(box, 3), border_corner(box, 2), border_corner(box, 1), border_corner(box, 0)};
+        }
+
+    }
+
+}
@@ -0,0 +1,72 @@
+#ifndef WORLD_GENERATOR_GEOMETRY_HPP
+#define WORLD_GENERATOR_GEOMETRY_HPP
+
+#include <vector>
+#include <functional>
+#include <utility>
+
+#include "structs.hpp"
+
+namespace rustymon {
+
+    namespace geometry {
+
+        using Point = std::pair<double, double>;
+        using Ring = std::vector<Point>;
+
+        /**
+         * Clip the segment from a to b to the bounding box (Liang-Barsky). Returns false if the segment
+         * doesn't touch the box. Otherwise a and b are moved onto the box border where required and
+         * entry and exit are set to the parameters (0 <= entry <= exit <= 1) of the clipped segment.
+         */
+        bool clip_segment(const structs::BoundingBox &box, Point &a, Point &b, double &entry, double &exit);
+
+        /// Parts of the polyline inside the box
+        std::vector<Ring> clip_polyline(const structs::BoundingBox &box, const Ring &points);
+
+        /// Clip the closed ring to the box (Sutherland-Hodgman), the result is empty or closed again
+        Ring clip_ring(const structs::BoundingBox &box, const Ring &ring);
+
+        using PolygonCallback = std::function<void(int x, int y, Ring &border, std::vector<Ring> &holes)>;
+
+        using CoveredCallback = std::function<void(int x1, int y1, int x2, int y2)>;
+
+        /**
+         * Split the polygon (border and holes) along the tile grid of the size factors and call the function
+         * with the part in every tile of the inclusive range which isn't empty. The range is halved recursively,
+         * so every ring is only clipped against boxes it actually overlaps. If the covered function is set,
+         * ranges lying completely inside the polygon are passed to it instead and aren't clipped any further.
+         */
+        void split_polygon(const Ring &border, const std::vector<Ring> &holes, int x_size_factor, int y_size_factor,
+                           int x1, int y1, int x2, int y2, const PolygonCallback &callback, const CoveredCallback &covered = nullptr);
+
+        /// Signed area of the ring, positive for counter-clockwise rings
+        double signed_area(const Ring &ring);
+
+        /// Even-odd test whether the point lies in the ring
+        bool contains(const Ring &ring, const Point &point);
+
+        /// Check whether the point lies on the border of the box (with a small tolerance)
+        bool on_border(const structs::BoundingBox &box, const Point &point);
+
+        /// Nearest point on the border of the box
+        Point nearest_border_point(const structs::BoundingBox &box, const Point &point);
+
+        /**
+         * Position of a point on the border of the box, running clockwise from the bottom left
+         * corner: the left edge maps to [0, 1), the top edge to [1, 2), the right edge to [2, 3)
+         * and the bottom edge to [3, 4). The point is projected to the nearest edge first.
+         */
+        double border_position(const structs::BoundingBox &box, const Point &point);
+
+        /// Corner of the box at the given integral border position
+        Point border_corner(const structs::BoundingBox &box, int position);
+
+        /// Closed counter-clockwise ring along the border of the box
+        Ring box_ring(const structs::BoundingBox &box);
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_GEOMETRY_HPP
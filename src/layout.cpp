@@ -0,0 +1,214 @@
+#include "layout.hpp"
+
+#include <map>
+#include <atomic>
+#include <numeric>
+#include <algorithm>
+
+namespace rustymon {
+
+    namespace layout {
+
+        namespace {
+
+            const int MORTON_AXIS_BITS = 16;
+
+            std::uint32_t quantize(const double value, const double lower, const double upper) {
+                if (!(upper > lower)) {
+                    return 0;
+                }
+                const double scaled = (value - lower) / (upper - lower) * (1 << MORTON_AXIS_BITS);
+                return static_cast<std::uint32_t>(std::min(std::max(scaled, 0.0), static_cast<double>((1 << MORTON_AXIS_BITS) - 1)));
+            }
+
+            std::uint32_t spread_bits(std::uint32_t value) {
+                value = (value | (value << 8)) & 0x00FF00FF;
+                value = (value | (value << 4)) & 0x0F0F0F0F;
+                value = (value | (value << 2)) & 0x33333333;
+                value = (value | (value << 1)) & 0x55555555;
+                return value;
+            }
+
+            std::pair<double, double> center(const std::vector<std::pair<double, double>> &points) {
+                if (points.empty()) {
+                    return std::pair<double, double>{0, 0};
+                }
+                std::pair<double, double> lower = points.front();
+                std::pair<double, double> upper = points.front();
+                for (const std::pair<double, double> &point: points) {
+                    lower.first = std::min(lower.first, point.first);
+                    lower.second = std::min(lower.second, point.second);
+                    upper.first = std::max(upper.first, point.first);
+                    upper.second = std::max(upper.second, point.second);
+                }
+                return std::pair<double, double>{(lower.first + upper.first) / 2, (lower.second + upper.second) / 2};
+            }
+
+            /// Reorder the objects by their keys and compute the offsets of all sub-cells of the level
+            template<typename T>
+            void reorder(std::vector<T> &objects, const std::vector<std::uint32_t> &keys, const int level, std::vector<std::uint32_t> &offsets) {
+                std::vector<std::uint32_t> order(objects.size());
+                std::iota(order.begin(), order.end(), 0);
+                std::stable_sort(order.begin(), order.end(), [&keys](std::uint32_t a, std::uint32_t b){
+                    return keys[a] < keys[b];
+                });
+
+                // The objects can't be swapped in place, because their IDs and types are const
+                std::vector<T> ordered;
+                ordered.reserve(objects.size());
+                for (const std::uint32_t &index: order) {
+                    ordered.push_back(std::move(objects[index]));
+                }
+                objects.swap(ordered);
+
+                const int shift = 2 * (MORTON_AXIS_BITS - level);
+                offsets.assign((static_cast<std::size_t>(1) << (2 * level)) + 1, 0);
+                for (const std::uint32_t &key: keys) {
+                    offsets[(key >> shift) + 1]++;
+                }
+                std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+            }
+
+            const std::uint32_t NO_END = UINT32_MAX;
+
+            std::size_t serialized_size(const std::vector<structs::Street> &streets) {
+                std::size_t size = 0;
+                for (const structs::Street &street: streets) {
+                    size += structs::serialized_size(street) + 1;
+                }
+                return size;
+            }
+
+        }
+
+        std::uint32_t morton_key(const structs::BoundingBox &bbox, const std::pair<double, double> &point) {
+            const std::uint32_t x = quantize(point.first, bbox.bottom_left.first, bbox.top_right.first);
+            const std::uint32_t y = quantize(point.second, bbox.bottom_left.second, bbox.top_right.second);
+            return spread_bits(x) | (spread_bits(y) << 1);
+        }
+
+        void order_tile(structs::Tile &tile, const int level) {
+            std::vector<std::uint32_t> keys;
+            keys.reserve(tile.poi.size());
+            for (const structs::POI &poi: tile.poi) {
+                keys.push_back(morton_key(tile.bbox, poi.pos));
+            }
+            reorder(tile.poi, keys, level, tile.bucket_index.poi);
+
+            keys.clear();
+            for (const structs::Street &street: tile.streets) {
+                keys.push_back(morton_key(tile.bbox, center(street.waypoints)));
+            }
+            reorder(tile.streets, keys, level, tile.bucket_index.streets);
+
+            keys.clear();
+            for (const structs::Area &area: tile.areas) {
+                keys.push_back(morton_key(tile.bbox, center(area.border)));
+            }
+            reorder(tile.areas, keys, level, tile.bucket_index.areas);
+
+            tile.bucket_index.level = level;
+        }
+
+        void order_world(structs::World &world, const int level, const int worker_threads) {
+            structs::for_each_tile_parallel(world, worker_threads, [level](structs::Tile &tile){
+                order_tile(tile, level);
+            });
+        }
+
+        MergeStatistics merge_streets(structs::Tile &tile) {
+            std::vector<structs::Street> &streets = tile.streets;
+            MergeStatistics statistics{streets.size(), streets.size(), 0, 0};
+            statistics.bytes_before = serialized_size(streets);
+
+            // End point 2 * i is the first point of street i, 2 * i + 1 its last point
+            std::map<std::pair<int, std::pair<double, double>>, std::vector<std::uint32_t>> ends;
+            for (std::uint32_t i = 0; i < streets.size(); i++) {
+                if (streets[i].waypoints.size() < 2) {
+                    continue;
+                }
+                ends[{streets[i].type, streets[i].waypoints.front()}].push_back(2 * i);
+                ends[{streets[i].type, streets[i].waypoints.back()}].push_back(2 * i + 1);
+            }
+            std::vector<std::uint32_t> partner(2 * streets.size(), NO_END);
+            bool any_partner = false;
+            for (const auto &end: ends) {
+                if (end.second.size() == 2 && end.second[0] / 2 != end.second[1] / 2) {
+                    partner[end.second[0]] = end.second[1];
+                    partner[end.second[1]] = end.second[0];
+                    any_partner = true;
+                }
+            }
+            if (!any_partner) {
+                statistics.bytes_after = statistics.bytes_before;
+                return statistics;
+            }
+
+            std::vector<bool> visited(streets.size(), false);
+            std::vector<structs::Street> merged;
+            auto join = [&streets, &partner, &visited, &merged](std::uint32_t current, bool reversed) {
+                const structs::Street &first = streets[current];
+                std::vector<std::pair<double, double>> waypoints;
+                std::vector<long> oids;
+                std::size_t parts = 0;
+                while (true) {
+                    visited[current] = true;
+                    parts++;
+                    std::vector<std::pair<double, double>> &points = streets[current].waypoints;
+                    if (reversed) {
+                        std::reverse(points.begin(), points.end());
+                    }
+                    waypoints.insert(waypoints.end(), points.begin() + (waypoints.empty() ? 0 : 1), points.end());
+                    oids.push_back(streets[current].oid);
+
+                    const std::uint32_t next = partner[2 * current + (reversed ? 0 : 1)];
+                    if (next == NO_END || visited[next / 2]) {
+                        break;
+                    }
+                    current = next / 2;
+                    reversed = next % 2 == 1;
+                }
+                if (parts == 1) {
+                    oids.clear();
+                }
+                merged.push_back(structs::Street{first.oid, first.type, std::move(waypoints), std::move(oids)});
+            };
+
+            // Start at the open ends first, the remaining streets form closed loops
+            for (std::uint32_t i = 0; i < streets.size(); i++) {
+                if (!visited[i] && partner[2 * i] == NO_END) {
+                    join(i, false);
+                } else if (!visited[i] && partner[2 * i + 1] == NO_END) {
+                    join(i, true);
+                }
+            }
+            for (std::uint32_t i = 0; i < streets.size(); i++) {
+                if (!visited[i]) {
+                    join(i, false);
+                }
+            }
+
+            streets.swap(merged);
+            statistics.streets_after = streets.size();
+            statistics.bytes_after = serialized_size(streets);
+            return statistics;
+        }
+
+        MergeStatistics merge_world_streets(structs::World &world, const int worker_threads) {
+            std::atomic<std::size_t> streets_before{0};
+            std::atomic<std::size_t> streets_after{0};
+            std::atomic<std::size_t> bytes_before{0};
+            std::atomic<std::size_t> bytes_after{0};
+            structs::for_each_tile_parallel(world, worker_threads, [&](structs::Tile &tile){
+                const MergeStatistics statistics = merge_streets(tile);
+                streets_before += statistics.streets_before;
+                streets_after += statistics.streets_after;
+                bytes_before += statistics.bytes_before;
+                bytes_after += statistics.bytes_after;
+            });
+            return MergeStatistics{streets_before, streets_after, bytes_before, bytes_after};
+        }
+
+    }
+
+}
@@ -0,0 +1,47 @@
+#ifndef WORLD_GENERATOR_LAYOUT_HPP
+#define WORLD_GENERATOR_LAYOUT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "structs.hpp"
+
+namespace rustymon {
+
+    namespace layout {
+
+        /// Morton key of a point relative to the bounding box, using 16 bits per axis
+        std::uint32_t morton_key(const structs::BoundingBox &bbox, const std::pair<double, double> &point);
+
+        /**
+         * Sort the objects of a tile by the Morton key of their centers (the center of the bounding box
+         * of all points for streets and areas) and build the bucket index of the tile with the given level.
+         * Objects with equal keys keep their input order, so the result is deterministic.
+         */
+        void order_tile(structs::Tile &tile, int level);
+
+        void order_world(structs::World &world, int level, int worker_threads);
+
+        struct MergeStatistics {
+            std::size_t streets_before;
+            std::size_t streets_after;
+            /// Sizes of the serialized streets in bytes
+            std::size_t bytes_before;
+            std::size_t bytes_after;
+        };
+
+        /**
+         * Join the streets of a tile which meet end to end into longer streets. Two streets are joined
+         * if they have the same type and share an end point which no other street of this type has, so
+         * junctions are kept. Streets may be reversed for that. A joined street keeps the ID of its first
+         * part, the IDs of all parts are stored in its list of merged IDs.
+         */
+        MergeStatistics merge_streets(structs::Tile &tile);
+
+        MergeStatistics merge_world_streets(structs::World &world, int worker_threads);
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_LAYOUT_HPP
@@ -1,12 +1,28 @@
+#include <cstdio>
+#include <memory>
 #include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
 #include <cstring>
 #include <iostream>
+#include <stdexcept>
 
 #include "structs.hpp"
 #include "constants.hpp"
 #include "config.hpp"
 #include "generator.hpp"
 #include "exporter.hpp"
+#include "spawns.hpp"
+#include "layout.hpp"
+#include "quadtree.hpp"
+#include "elevation.hpp"
+#include "pipeline.hpp"
+#include "sinks.hpp"
+#include "block_index.hpp"
+#include "synth.hpp"
+#include "bench.hpp"
+#include "trace.hpp"
 
 
 void print_help() {
@@ -15,13 +31,154 @@ void print_help() {
 }
 
 
+/**
+ * Write the trace (if enabled) when leaving main, i.e. after all worker threads have been joined
+ */
+struct TraceWriter {
+    const std::string filename;
+
+    explicit TraceWriter(std::string filename) : filename(std::move(filename)) {
+        if (!this->filename.empty()) {
+            rustymon::trace::start();
+            rustymon::trace::set_thread_name("main");
+        }
+    }
+
+    ~TraceWriter() {
+        if (filename.empty()) {
+            return;
+        }
+        if (rustymon::trace::write(filename)) {
+            std::cout << "Wrote the trace to " << filename << "." << std::endl;
+        } else {
+            std::cerr << "Failed to write the trace to " << filename << "." << std::endl;
+        }
+    }
+};
+
+
+/**
+ * Post-process the generated world before exporting it. If the export is pipelined, only the stages
+ * which need the whole world run here, the others are left to the pipeline::TileProcessor.
+ */
+void post_process(rustymon::WorldGenerator &generator, const rustymon::config::Config &config, const bool pipelined) {
+    const int threads = (config.workers.serialize > 0) ? config.workers.serialize : rustymon::SERIALIZE_DEFAULT_WORKER_THREADS;
+    if (config.layout.merge_streets && !pipelined) {
+        rustymon::trace::Scope scope{"merge streets", "post-process"};
+        const rustymon::layout::MergeStatistics statistics = rustymon::layout::merge_world_streets(generator.get_world(), threads);
+        std::cout << "Merged streets: " << statistics.streets_before << " -> " << statistics.streets_after << " objects, "
+                  << statistics.bytes_before << " -> " << statistics.bytes_after << " bytes." << std::endl;
+    }
+    if (config.tiling.coarsen) {
+        rustymon::trace::Scope scope{"coarsen", "post-process"};
+        const int x_size_factor = (config.size.x > 0) ? config.size.x : rustymon::X_SIZE_FACTOR_DEFAULT;
+        const int y_size_factor = (config.size.y > 0) ? config.size.y : rustymon::Y_SIZE_FACTOR_DEFAULT;
+        const std::size_t removed = rustymon::quadtree::coarsen_world(generator.get_world(), config.tiling, x_size_factor, y_size_factor);
+        std::cout << "Coarsened tiles: " << removed << " tiles joined into their neighbours." << std::endl;
+    }
+    if (pipelined) {
+        return;
+    }
+    if (config.tiling.adaptive) {
+        rustymon::trace::Scope scope{"split", "post-process"};
+        const rustymon::quadtree::SplitStatistics statistics = rustymon::quadtree::split_world(generator.get_world(), config.tiling, threads);
+        std::cout << "Split tiles: " << statistics.split << " tiles split, " << statistics.leaves
+                  << " tiles without children, maximum level " << statistics.depth << "." << std::endl;
+    }
+    if (!config.elevation.directory.empty()) {
+        rustymon::trace::Scope scope{"elevation", "post-process"};
+        const rustymon::elevation::ElevationStatistics statistics = rustymon::elevation::add_elevation(generator.get_world(), config.elevation, config.layout.shared_areas, threads, &generator.get_memory_tracker());
+        std::cout << "Elevation: " << statistics.covered << " of " << statistics.tiles << " tiles covered by "
+                  << statistics.files << " elevation files, " << statistics.areas << " terrain areas added." << std::endl;
+    }
+    if (config.layout.spatial_order) {
+        rustymon::trace::Scope scope{"spatial order", "post-process"};
+        rustymon::layout::order_world(generator.get_world(), config.layout.bucket_level, threads);
+    }
+    if (config.spawn_conditions.enabled) {
+        rustymon::trace::Scope scope{"spawn tables", "post-process"};
+        rustymon::spawns::build_spawn_tables(generator.get_world(), config.spawn_conditions, threads);
+    }
+}
+
+
+/**
+ * Fill the world of the generator from the input files, using checkpoints if they are configured.
+ * Returns the checkpointer (if any), which must be kept alive until its journal isn't needed anymore.
+ */
+std::unique_ptr<rustymon::checkpoint::Checkpointer> generate_world(rustymon::WorldGenerator &generator, const rustymon::config::Config &config, const std::vector<std::string> &input_files, bool resume, bool pipelined = false) {
+    std::unique_ptr<rustymon::checkpoint::Checkpointer> checkpointer;
+    if (config.checkpoint.directory.empty()) {
+        if (resume) {
+            std::cerr << "Resuming requires a checkpoint directory in the config file." << std::endl;
+            exit(2);
+        }
+        rustymon::reader::read_from_file(generator, input_files);
+        post_process(generator, config, pipelined);
+        return checkpointer;
+    }
+
+    checkpointer.reset(new rustymon::checkpoint::Checkpointer(config.checkpoint.directory, config.checkpoint.interval));
+    generator.enable_change_tracking();
+    rustymon::checkpoint::State state{0, rustymon::checkpoint::Position{0, 0}, false};
+    if (resume) {
+        state = generator.restore(*checkpointer);
+    } else {
+        checkpointer->clear();
+    }
+    if (!state.complete) {
+        rustymon::reader::read_from_file(generator, input_files, std::cout, checkpointer.get(), state.position);
+    }
+    post_process(generator, config, pipelined);
+    return checkpointer;
+}
+
+
+/**
+ * Fill the world of the generator with the objects inside the bounding box, reading only
+ * the required blocks of every input file which has an up-to-date block index
+ */
+std::unique_ptr<rustymon::checkpoint::Checkpointer> generate_world(rustymon::WorldGenerator &generator, const rustymon::config::Config &config, const std::vector<std::string> &input_files, const osmium::Box &bbox, bool resume) {
+    std::vector<std::string> files;
+    std::vector<std::string> extracts;
+    for (const std::string &input_file: input_files) {
+        const std::string extract = rustymon::block_index::prepare_extract(input_file, bbox);
+        files.push_back(extract.empty() ? input_file : extract);
+        if (!extract.empty()) {
+            extracts.push_back(extract);
+        }
+    }
+    auto checkpointer = generate_world(generator, config, files, resume);
+    for (const std::string &extract: extracts) {
+        std::remove(extract.c_str());
+    }
+    return checkpointer;
+}
+
+
 int main(int argc, char *argv[]) {
+    bool resume = false;
+    std::string trace_file;
+    int remaining_args = 0;
     for (int i = 0; i < argc; i++) {
         if (strcmp(argv[i], "--help") == 0) {
             print_help();
             return 0;
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            resume = true;
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            if (i + 1 >= argc) {
+                std::cerr << "The option --trace requires the name of the trace file." << std::endl;
+                std::cerr << "Usage: " << std::string(argv[0]) << " [--resume] [--trace <TraceFile>] <Command> ..." << std::endl;
+                return 2;
+            }
+            trace_file = argv[++i];
+        } else {
+            argv[remaining_args++] = argv[i];
         }
     }
+    argc = remaining_args;
+    const TraceWriter trace_writer{trace_file};
 
     if (argc >= 2 && strcmp(argv[1], "help") == 0) {
         print_help();
@@ -30,7 +187,7 @@ int main(int argc, char *argv[]) {
         std::cout << "Tests are not implemented yet." << std::endl;
         return 0;
     } else if (argc >= 2 && strcmp(argv[1], "http") == 0) {
-        const std::string usage = "Usage: " + std::string(argv[0]) + " http <InputFile> <PushResultURL> [<AuthorizationInfo>] [<ConfigFile>]";
+        const std::string usage = "Usage: " + std::string(argv[0]) + " http <InputFile>[,<InputFile>...] <PushResultURL> [<AuthorizationInfo>] [<ConfigFile>]";
         std::string config_file = rustymon::DEFAULT_CONFIG_FILENAME;
         std::string auth_info;
         if (argc == 6) {
@@ -45,8 +202,22 @@ int main(int argc, char *argv[]) {
 
         const rustymon::config::Config config = rustymon::config::load_config_from_file(config_file);
         rustymon::WorldGenerator generator(config);
-        rustymon::reader::read_from_file(generator, argv[2]);
-        rustymon::export_world_to_http(generator.get_world(), argv[3], auth_info);
+        const bool pipelined = config.http.async && config.http.pipelined;
+        auto checkpointer = generate_world(generator, config, rustymon::helpers::get_input_files(argv[2]), resume, pipelined);
+        std::unique_ptr<rustymon::checkpoint::ExportJournal> journal;
+        if (checkpointer) {
+            journal.reset(new rustymon::checkpoint::ExportJournal(checkpointer->get_directory(), resume));
+        }
+        if (pipelined) {
+            const rustymon::pipeline::TileProcessor processor(config, &generator.get_memory_tracker());
+            const int threads = (config.workers.serialize > 0) ? config.workers.serialize : rustymon::SERIALIZE_DEFAULT_WORKER_THREADS;
+            rustymon::export_world_to_http_pipelined(generator.get_world(), processor, threads, argv[3], config.http, auth_info, std::cout, &generator.get_memory_tracker(), journal.get());
+        } else if (config.http.async) {
+            rustymon::export_world_to_http_async(generator.get_world(), argv[3], config.http, auth_info, std::cout, &generator.get_memory_tracker(), journal.get());
+        } else {
+            rustymon::export_world_to_http(generator.get_world(), argv[3], auth_info, std::cout, (config.workers.upload > 0) ? config.workers.upload : rustymon::UPLOAD_DEFAULT_WORKER_THREADS, &generator.get_memory_tracker(), journal.get());
+        }
+        generator.get_memory_tracker().report_peaks(std::cout);
         return 0;
     } else if (argc >= 2 && strcmp(argv[1], "dir") == 0) {
         // TODO: add directory support
@@ -56,8 +227,115 @@ int main(int argc, char *argv[]) {
         // TODO: add support for stdout exporting
         std::cerr << "Stdout support is not implemented yet." << std::endl;
         return 1;
+    } else if (argc >= 2 && strcmp(argv[1], "index") == 0) {
+        if (argc != 3) {
+            std::cerr << "Usage: " << std::string(argv[0]) << " index <InputFile>" << std::endl;
+            return 2;
+        }
+        rustymon::block_index::write_index(argv[2], rustymon::block_index::build_index(argv[2]));
+        std::cout << "Wrote the block index " << rustymon::block_index::index_filename(argv[2]) << "." << std::endl;
+        return 0;
+    } else if (argc >= 2 && strcmp(argv[1], "synth") == 0) {
+        const std::string usage = "Usage: " + std::string(argv[0]) + " synth <OutputFile> <Scale> [<Density>] [<ConfigFile>]";
+        std::string config_file = rustymon::DEFAULT_CONFIG_FILENAME;
+        double scale = 0;
+        double density = rustymon::SYNTH_DENSITY_DEFAULT;
+        if (argc == 6) {
+            config_file = argv[5];
+        } else if (argc != 5 && argc != 4) {
+            std::cerr << usage << std::endl;
+            return 2;
+        }
+        try {
+            scale = std::stod(argv[3]);
+            if (argc >= 5) {
+                density = std::stod(argv[4]);
+            }
+        } catch (std::logic_error &) {
+            std::cerr << usage << std::endl;
+            return 2;
+        }
+
+        const rustymon::config::Config config = rustymon::config::load_config_from_file(config_file);
+        rustymon::synth::write_dataset(argv[2], config, rustymon::synth::Options{scale, density, rustymon::SYNTH_SEED_DEFAULT});
+        return 0;
+    } else if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        const std::string usage = "Usage: " + std::string(argv[0]) + " bench <Directory> [<ConfigFile>]";
+        std::string config_file = rustymon::DEFAULT_CONFIG_FILENAME;
+        if (argc == 4) {
+            config_file = argv[3];
+        } else if (argc != 3) {
+            std::cerr << usage << std::endl;
+            return 2;
+        }
+
+        const rustymon::config::Config config = rustymon::config::load_config_from_file(config_file);
+        const std::vector<rustymon::bench::Result> results = rustymon::bench::run_benchmark(argv[2], config, {1, 10, 100});
+        for (const rustymon::bench::Result &result: results) {
+            if (!result.success) {
+                return 1;
+            }
+        }
+        return 0;
+    } else if (argc >= 2 && strcmp(argv[1], "mock-ingest") == 0) {
+        const std::string usage = "Usage: " + std::string(argv[0]) + " mock-ingest <Port> <LatencyMs> <ErrorRate> <MaxRequestsPerSecond>";
+        if (argc != 6) {
+            std::cerr << usage << std::endl;
+            return 2;
+        }
+        rustymon::mock::Options options{};
+        try {
+            options = rustymon::mock::Options{std::stoi(argv[2]), std::stoi(argv[3]), std::stod(argv[4]), std::stoi(argv[5]), rustymon::SYNTH_SEED_DEFAULT};
+        } catch (std::logic_error &) {
+            std::cerr << usage << std::endl;
+            return 2;
+        }
+        std::unique_ptr<rustymon::mock::IngestServer> server;
+        try {
+            server.reset(new rustymon::mock::IngestServer(options));
+        } catch (std::runtime_error &error) {
+            std::cerr << "Failed to start the mock ingest server: " << error.what() << "." << std::endl;
+            return 1;
+        }
+        std::cout << "Accepting tiles on " << server->url() << " ..." << std::endl;
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::seconds(10));
+            const rustymon::mock::Statistics statistics = server->statistics();
+            std::cout << statistics.requests << " requests (" << statistics.bytes << " bytes): " << statistics.accepted << " accepted, "
+                      << statistics.errors << " errors, " << statistics.throttled << " throttled, " << statistics.invalid << " invalid; "
+                      << statistics.tiles << " different tiles." << std::endl;
+        }
+    } else if (argc >= 2 && strcmp(argv[1], "bench-upload") == 0) {
+        const std::string usage = "Usage: " + std::string(argv[0]) + " bench-upload <Tiles> <LatencyMs> <ErrorRate> <MaxRequestsPerSecond> [<ConfigFile>]";
+        std::string config_file = rustymon::DEFAULT_CONFIG_FILENAME;
+        if (argc == 7) {
+            config_file = argv[6];
+        } else if (argc != 6) {
+            std::cerr << usage << std::endl;
+            return 2;
+        }
+
+        std::size_t tiles = 0;
+        rustymon::mock::Options server_options{};
+        try {
+            tiles = std::stoul(argv[2]);
+            server_options = rustymon::mock::Options{0, std::stoi(argv[3]), std::stod(argv[4]), std::stoi(argv[5]), rustymon::SYNTH_SEED_DEFAULT};
+        } catch (std::logic_error &) {
+            std::cerr << usage << std::endl;
+            return 2;
+        }
+
+        const rustymon::config::Config config = rustymon::config::load_config_from_file(config_file);
+        const std::vector<rustymon::bench::UploadRun> runs = rustymon::bench::run_upload_benchmark(config, server_options, tiles, {1, 4, 16, 64, 256});
+        // Every tile uploaded without an error must have arrived at the server
+        for (const rustymon::bench::UploadRun &run: runs) {
+            if (run.tiles_received != run.requests - run.errors) {
+                return 1;
+            }
+        }
+        return 0;
     } else if (argc >= 2 && strcmp(argv[1], "file") == 0) {
-        const std::string usage = "Usage: " + std::string(argv[0]) + " file <InputFile> <OutputFile> <BoundingBox> [<ConfigFile>]";
+        const std::string usage = "Usage: " + std::string(argv[0]) + " file <InputFile>[,<InputFile>...] <OutputFile> <BoundingBox> [<ConfigFile>]";
         std::string config_file = rustymon::DEFAULT_CONFIG_FILENAME;
         if (argc == 6) {
             config_file = argv[5];
@@ -70,11 +348,84 @@ int main(int argc, char *argv[]) {
         std::cout << "Using bounding box " << bbox << "." << std::endl;
         const rustymon::config::Config config = rustymon::config::load_config_from_file(config_file);
         rustymon::WorldGenerator generator(config, bbox);
-        rustymon::reader::read_from_file(generator, argv[2]);
-        rustymon::export_world_to_file(generator.get_world(), argv[3]);
+        generate_world(generator, config, rustymon::helpers::get_input_files(argv[2]), bbox, resume);
+        rustymon::export_world_to_file(generator.get_world(), argv[3], std::cout, config.workers.serialize);
+        generator.get_memory_tracker().report_peaks(std::cout);
         return 0;
+    } else if (argc >= 2 && strcmp(argv[1], "archive") == 0) {
+        const std::string usage = "Usage: " + std::string(argv[0]) + " archive <InputFile>[,<InputFile>...] <OutputFile> <BoundingBox> [<ConfigFile>]";
+        std::string config_file = rustymon::DEFAULT_CONFIG_FILENAME;
+        if (argc == 6) {
+            config_file = argv[5];
+        } else if (argc != 5) {
+            std::cerr << usage << std::endl;
+            return 2;
+        }
+
+        osmium::Box bbox = rustymon::helpers::get_bbox(argv[4]);
+        std::cout << "Using bounding box " << bbox << "." << std::endl;
+        const rustymon::config::Config config = rustymon::config::load_config_from_file(config_file);
+        rustymon::WorldGenerator generator(config, bbox);
+        generate_world(generator, config, rustymon::helpers::get_input_files(argv[2]), bbox, resume);
+        rustymon::export_world_to_archive(generator.get_world(), argv[3], std::cout, config.workers.serialize);
+        generator.get_memory_tracker().report_peaks(std::cout);
+        return 0;
+    } else if (argc >= 2 && strcmp(argv[1], "export") == 0) {
+        const std::string usage = "Usage: " + std::string(argv[0]) + " export <InputFile>[,<InputFile>...] <BoundingBox> <ConfigFile> <Sink> [<Sink>...]\n"
+                "Sinks: archive:<OutputFile>, http:<PushResultURL> (optionally followed by auth:<AuthorizationInfo>)";
+        if (argc < 6) {
+            std::cerr << usage << std::endl;
+            return 2;
+        }
+
+        osmium::Box bbox = rustymon::helpers::get_bbox(argv[3]);
+        std::cout << "Using bounding box " << bbox << "." << std::endl;
+        const rustymon::config::Config config = rustymon::config::load_config_from_file(argv[4]);
+        rustymon::WorldGenerator generator(config, bbox);
+
+        // The sinks are validated before the world is generated, the journal is only known afterwards
+        struct SinkSpec {
+            std::string type;
+            std::string target;
+            std::string auth_info;
+        };
+        std::vector<SinkSpec> specs;
+        int http_sinks = 0;
+        for (int i = 5; i < argc; i++) {
+            const std::string spec = argv[i];
+            const std::size_t colon = spec.find(':');
+            const std::string type = spec.substr(0, colon);
+            const std::string target = (colon == std::string::npos) ? "" : spec.substr(colon + 1);
+            if (type == "auth" && !specs.empty() && specs.back().type == "http") {
+                specs.back().auth_info = target;
+            } else if ((type == "archive" || type == "http") && !target.empty()) {
+                specs.push_back(SinkSpec{type, target, ""});
+                http_sinks += (type == "http") ? 1 : 0;
+            } else {
+                std::cerr << "Invalid sink '" << spec << "'." << std::endl << usage << std::endl;
+                return 2;
+            }
+        }
+
+        auto checkpointer = generate_world(generator, config, rustymon::helpers::get_input_files(argv[2]), bbox, resume);
+        // The journal records uploaded tiles without their URL, so it can only be used by a single HTTP sink
+        std::unique_ptr<rustymon::checkpoint::ExportJournal> journal;
+        if (checkpointer && http_sinks == 1) {
+            journal.reset(new rustymon::checkpoint::ExportJournal(checkpointer->get_directory(), resume));
+        }
+        std::vector<std::unique_ptr<rustymon::sinks::Sink>> sinks;
+        for (const SinkSpec &spec: specs) {
+            if (spec.type == "archive") {
+                sinks.emplace_back(new rustymon::sinks::ArchiveSink(spec.target, std::cout));
+            } else {
+                sinks.emplace_back(new rustymon::sinks::HttpSink(spec.target, spec.auth_info, config.http, std::cout, &generator.get_memory_tracker(), journal.get()));
+            }
+        }
+        const std::size_t errors = rustymon::sinks::export_world_to_sinks(generator.get_world(), sinks, std::cout, config.workers.serialize, rustymon::SINK_BUFFER_UNITS);
+        generator.get_memory_tracker().report_peaks(std::cout);
+        return (errors > 0) ? 1 : 0;
     } else {
-        std::cerr << "Usage: " << std::string(argv[0]) << " {help,dir,file,http,stdout,test} [Options...]" << std::endl;
+        std::cerr << "Usage: " << std::string(argv[0]) << " {help,archive,bench,bench-upload,dir,export,file,http,index,mock-ingest,stdout,synth,test} [Options...]" << std::endl;
         return 2;
     }
 }
@@ -0,0 +1,123 @@
+#include "memory.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/resource.h>
+
+namespace rustymon {
+
+    namespace memory {
+
+        static const double MEBIBYTE = 1024.0 * 1024.0;
+
+        const char *component_name(const Component component) {
+            switch (component) {
+                case Component::LOCATION_INDEX:
+                    return "location index";
+                case Component::MULTIPOLYGON_MANAGER:
+                    return "multipolygon manager";
+                case Component::WORLD:
+                    return "world tiles";
+                case Component::EXPORT_BUFFERS:
+                    return "export buffers";
+                case Component::COASTLINES:
+                    return "coastlines";
+            }
+            return "unknown";
+        }
+
+        std::size_t get_current_rss() {
+            std::ifstream statm("/proc/self/statm");
+            std::size_t total_pages = 0;
+            std::size_t resident_pages = 0;
+            if (!(statm >> total_pages >> resident_pages)) {
+                return 0;
+            }
+            return resident_pages * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        }
+
+        std::size_t get_peak_rss() {
+            struct rusage usage{};
+            if (getrusage(RUSAGE_SELF, &usage) != 0) {
+                return 0;
+            }
+            // ru_maxrss is reported in kilobytes on Linux
+            return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+        }
+
+        void MemoryTracker::update_peak(const std::size_t index, const std::size_t value) {
+            std::size_t previous = peak[index].load();
+            while (value > previous && !peak[index].compare_exchange_weak(previous, value)) {}
+        }
+
+        void MemoryTracker::set(const Component component, const std::size_t bytes) {
+            auto index = static_cast<std::size_t>(component);
+            current[index].store(bytes);
+            update_peak(index, bytes);
+        }
+
+        void MemoryTracker::add(const Component component, const std::size_t bytes) {
+            auto index = static_cast<std::size_t>(component);
+            update_peak(index, current[index].fetch_add(bytes) + bytes);
+        }
+
+        void MemoryTracker::sub(const Component component, const std::size_t bytes) {
+            current[static_cast<std::size_t>(component)].fetch_sub(bytes);
+        }
+
+        std::size_t MemoryTracker::get(const Component component) const {
+            return current[static_cast<std::size_t>(component)].load();
+        }
+
+        std::size_t MemoryTracker::get_peak(const Component component) const {
+            return peak[static_cast<std::size_t>(component)].load();
+        }
+
+        std::size_t MemoryTracker::total() const {
+            std::size_t sum = 0;
+            for (const std::atomic<std::size_t> &value: current) {
+                sum += value.load();
+            }
+            return sum;
+        }
+
+        bool MemoryTracker::exceeded() const {
+            return would_exceed(0);
+        }
+
+        bool MemoryTracker::would_exceed(const std::size_t bytes) const {
+            if (budget == 0) {
+                return false;
+            }
+            return std::max(total(), get_current_rss()) + bytes > budget;
+        }
+
+        void MemoryTracker::report(std::ostream &stream) const {
+            stream << std::fixed << std::setprecision(1);
+            for (std::size_t i = 0; i < COMPONENT_COUNT; i++) {
+                stream << "  " << component_name(static_cast<Component>(i)) << ": "
+                       << current[i].load() / MEBIBYTE << " MiB" << std::endl;
+            }
+            stream << "  tracked total: " << total() / MEBIBYTE << " MiB, resident: "
+                   << get_current_rss() / MEBIBYTE << " MiB";
+            if (budget > 0) {
+                stream << ", budget: " << budget / MEBIBYTE << " MiB";
+            }
+            stream << std::endl << std::defaultfloat;
+        }
+
+        void MemoryTracker::report_peaks(std::ostream &stream) const {
+            stream << "Peak memory usage per component:" << std::endl << std::fixed << std::setprecision(1);
+            for (std::size_t i = 0; i < COMPONENT_COUNT; i++) {
+                stream << "  " << component_name(static_cast<Component>(i)) << ": "
+                       << peak[i].load() / MEBIBYTE << " MiB" << std::endl;
+            }
+            stream << "  process peak RSS: " << get_peak_rss() / MEBIBYTE << " MiB" << std::endl << std::defaultfloat;
+        }
+
+    }
+
+}
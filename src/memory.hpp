@@ -0,0 +1,81 @@
+#ifndef WORLD_GENERATOR_MEMORY_HPP
+#define WORLD_GENERATOR_MEMORY_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+
+namespace rustymon {
+
+    namespace memory {
+
+        enum class Component {
+            LOCATION_INDEX,
+            MULTIPOLYGON_MANAGER,
+            WORLD,
+            EXPORT_BUFFERS,
+            COASTLINES
+        };
+
+        static const std::size_t COMPONENT_COUNT = 5;
+
+        const char *component_name(Component component);
+
+        /// Resident set size of the current process in bytes (0 if unknown)
+        std::size_t get_current_rss();
+
+        /// Peak resident set size of the current process in bytes (0 if unknown)
+        std::size_t get_peak_rss();
+
+        /**
+         * Approximate accounting of the bytes held by the big components of the generator.
+         * The values are estimations based on the sizes reported by the components themselves,
+         * they don't include allocator overhead. A budget of zero disables the budget checks.
+         */
+        class MemoryTracker {
+            std::size_t budget;
+            std::array<std::atomic<std::size_t>, COMPONENT_COUNT> current{};
+            std::array<std::atomic<std::size_t>, COMPONENT_COUNT> peak{};
+
+            void update_peak(std::size_t index, std::size_t value);
+
+        public:
+
+            explicit MemoryTracker(std::size_t budget = 0) : budget(budget) {}
+
+            MemoryTracker(const MemoryTracker &) = delete;
+            MemoryTracker& operator = (const MemoryTracker &) = delete;
+
+            inline std::size_t get_budget() const {
+                return budget;
+            }
+
+            void set(Component component, std::size_t bytes);
+
+            void add(Component component, std::size_t bytes);
+
+            void sub(Component component, std::size_t bytes);
+
+            std::size_t get(Component component) const;
+
+            std::size_t get_peak(Component component) const;
+
+            std::size_t total() const;
+
+            /// Check whether the tracked memory (or the RSS, whichever is higher) exceeds the budget
+            bool exceeded() const;
+
+            /// Check whether adding the given number of bytes would exceed the budget
+            bool would_exceed(std::size_t bytes) const;
+
+            void report(std::ostream &stream) const;
+
+            void report_peaks(std::ostream &stream) const;
+        };
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_MEMORY_HPP
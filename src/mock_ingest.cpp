@@ -0,0 +1,260 @@
+#include "mock_ingest.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cctype>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "constants.hpp"
+
+namespace rustymon {
+
+    namespace mock {
+
+        namespace {
+
+            /// Value of the header with the given lower case name, empty if it's missing
+            std::string header_value(const std::string &headers, const std::string &name) {
+                std::size_t line_start = headers.find("\r\n");
+                while (line_start != std::string::npos && line_start + 2 < headers.size()) {
+                    line_start += 2;
+                    const std::size_t line_end = headers.find("\r\n", line_start);
+                    const std::size_t colon = headers.find(':', line_start);
+                    if (colon != std::string::npos && colon < line_end && colon - line_start == name.size()) {
+                        bool matches = true;
+                        for (std::size_t i = 0; i < name.size() && matches; i++) {
+                            matches = std::tolower(static_cast<unsigned char>(headers[line_start + i])) == name[i];
+                        }
+                        if (matches) {
+                            std::size_t value_start = colon + 1;
+                            while (value_start < line_end && headers[value_start] == ' ') {
+                                value_start++;
+                            }
+                            return headers.substr(value_start, line_end - value_start);
+                        }
+                    }
+                    line_start = line_end;
+                }
+                return "";
+            }
+
+            bool send_all(const int client, const std::string &data) {
+                std::size_t sent = 0;
+                while (sent < data.size()) {
+                    const ssize_t result = send(client, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+                    if (result <= 0) {
+                        return false;
+                    }
+                    sent += static_cast<std::size_t>(result);
+                }
+                return true;
+            }
+
+        }
+
+        IngestServer::IngestServer(const Options &options) : options(options), random(options.seed) {
+            server = socket(AF_INET, SOCK_STREAM, 0);
+            if (server < 0) {
+                throw std::runtime_error("failed to create the server socket");
+            }
+            int reuse = 1;
+            setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(static_cast<uint16_t>(options.port));
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t address_size = sizeof(address);
+            if (bind(server, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(server, 128) != 0 ||
+                    getsockname(server, reinterpret_cast<sockaddr *>(&address), &address_size) != 0) {
+                close(server);
+                throw std::runtime_error("failed to listen on port " + std::to_string(options.port));
+            }
+            bound_port = ntohs(address.sin_port);
+            acceptor = std::thread(&IngestServer::accept_connections, this);
+        }
+
+        IngestServer::~IngestServer() {
+            stop();
+        }
+
+        std::string IngestServer::url() const {
+            return "http://127.0.0.1:" + std::to_string(bound_port) + "/";
+        }
+
+        void IngestServer::stop() {
+            if (stopping.exchange(true)) {
+                return;
+            }
+            shutdown(server, SHUT_RDWR);
+            acceptor.join();
+            close(server);
+
+            std::vector<std::thread> threads;
+            {
+                std::lock_guard<std::mutex> lock(connections_mutex);
+                for (const int client: clients) {
+                    shutdown(client, SHUT_RDWR);
+                }
+                for (auto &connection: connections) {
+                    threads.push_back(std::move(connection.second));
+                }
+                connections.clear();
+                finished.clear();
+            }
+            for (std::thread &t: threads) {
+                t.join();
+            }
+        }
+
+        Statistics IngestServer::statistics() const {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            return Statistics{requests, accepted, errors, throttled, invalid, bytes, tiles.size()};
+        }
+
+        void IngestServer::accept_connections() {
+            while (!stopping) {
+                const int client = accept(server, nullptr, nullptr);
+                if (client < 0) {
+                    continue;
+                }
+                // Threads of closed connections are joined whenever a new connection is accepted
+                std::vector<std::thread> done;
+                {
+                    std::lock_guard<std::mutex> lock(connections_mutex);
+                    if (stopping) {
+                        close(client);
+                        break;
+                    }
+                    for (const std::thread::id &id: finished) {
+                        const auto connection = connections.find(id);
+                        done.push_back(std::move(connection->second));
+                        connections.erase(connection);
+                    }
+                    finished.clear();
+                    clients.insert(client);
+                    // The thread can't finish before it's stored, as it needs the lock for that
+                    std::thread thread(&IngestServer::handle_connection, this, client);
+                    const std::thread::id id = thread.get_id();
+                    connections.emplace(id, std::move(thread));
+                }
+                for (std::thread &thread: done) {
+                    thread.join();
+                }
+            }
+        }
+
+        void IngestServer::handle_connection(const int client) {
+            std::string buffer;
+            char chunk[16384];
+            auto receive = [&]() {
+                const ssize_t length = recv(client, chunk, sizeof(chunk), 0);
+                if (length <= 0) {
+                    return false;
+                }
+                buffer.append(chunk, static_cast<std::size_t>(length));
+                return true;
+            };
+
+            // Requests are handled one after the other, the connection is kept alive unless the client closes it
+            bool open = true;
+            while (open) {
+                std::size_t header_end;
+                while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+                    if (buffer.size() > MOCK_INGEST_MAX_HEADER_SIZE || !receive()) {
+                        open = false;
+                        break;
+                    }
+                }
+                if (!open) {
+                    break;
+                }
+                const std::string headers = buffer.substr(0, header_end + 2);
+                buffer.erase(0, header_end + 4);
+
+                std::size_t content_length = 0;
+                try {
+                    const std::string length = header_value(headers, "content-length");
+                    content_length = length.empty() ? 0 : std::stoul(length);
+                } catch (std::logic_error &) {
+                    send_all(client, "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+                    break;
+                }
+                if (buffer.size() < content_length && header_value(headers, "expect") == "100-continue") {
+                    send_all(client, "HTTP/1.1 100 Continue\r\n\r\n");
+                }
+                while (buffer.size() < content_length && open) {
+                    open = receive();
+                }
+                if (!open) {
+                    break;
+                }
+                buffer.erase(0, content_length);
+                requests++;
+                bytes += content_length;
+
+                open = header_value(headers, "connection") != "close";
+                const std::string response = "HTTP/1.1 " + respond(headers) + "\r\nContent-Length: 0\r\n" + (open ? "" : "Connection: close\r\n") + "\r\n";
+                open = send_all(client, response) && open;
+            }
+
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            clients.erase(client);
+            close(client);
+            finished.push_back(std::this_thread::get_id());
+        }
+
+        std::string IngestServer::respond(const std::string &headers) {
+            int x = 0;
+            int y = 0;
+            char end = '\0';
+            const std::string position = header_value(headers, "x-tile-position");
+            const std::string level = header_value(headers, "x-tile-level");
+            if (headers.compare(0, 5, "POST ") != 0 || std::sscanf(position.c_str(), "%d,%d%c", &x, &y, &end) != 2) {
+                invalid++;
+                return "400 Bad Request";
+            }
+
+            bool throttle = false;
+            bool fail = false;
+            {
+                std::lock_guard<std::mutex> lock(state_mutex);
+                const std::int64_t second = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+                if (second != window_second) {
+                    window_second = second;
+                    window_requests = 0;
+                }
+                if (options.max_rate > 0 && window_requests >= options.max_rate) {
+                    throttle = true;
+                } else {
+                    window_requests++;
+                    fail = std::uniform_real_distribution<double>(0, 1)(random) < options.error_rate;
+                }
+            }
+            // Throttled requests are rejected right away like a rate limiter in front of the server would do
+            if (throttle) {
+                throttled++;
+                return "429 Too Many Requests";
+            }
+            if (options.latency_ms > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(options.latency_ms));
+            }
+            if (fail) {
+                errors++;
+                return "500 Internal Server Error";
+            }
+
+            std::lock_guard<std::mutex> lock(state_mutex);
+            tiles.emplace(level.empty() ? 0 : std::atoi(level.c_str()), x, y);
+            accepted++;
+            return "200 OK";
+        }
+
+    }
+
+}
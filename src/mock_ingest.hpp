@@ -0,0 +1,117 @@
+#ifndef WORLD_GENERATOR_MOCK_INGEST_HPP
+#define WORLD_GENERATOR_MOCK_INGEST_HPP
+
+#include <map>
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <tuple>
+
+/*
+ * Local stand-in for the ingest server of the HTTP export: accepts tile POSTs on the loopback
+ * interface with keep-alive connections, checks their X-Tile-Position (and X-Tile-Level) headers
+ * and optionally injects latency, server errors and throttling. Nothing is stored except the
+ * set of received tile addresses, so uploads can be checked for completeness.
+ */
+
+namespace rustymon {
+
+    namespace mock {
+
+        struct Options {
+            /// Port on the loopback interface, zero picks a free port
+            int port;
+            /// Delay of every response in milliseconds
+            int latency_ms;
+            /// Fraction of the requests answered with 500 Internal Server Error
+            double error_rate;
+            /// Maximum number of requests per second, further requests get 429 Too Many Requests (zero disables throttling)
+            int max_rate;
+            /// Seed of the random error injection, so runs are reproducible
+            std::uint64_t seed;
+        };
+
+        struct Statistics {
+            std::uint64_t requests;
+            /// Requests answered with 200 OK
+            std::uint64_t accepted;
+            /// Injected server errors
+            std::uint64_t errors;
+            /// Requests answered with 429 Too Many Requests
+            std::uint64_t throttled;
+            /// Requests without a valid tile position
+            std::uint64_t invalid;
+            /// Bytes of all request bodies
+            std::uint64_t bytes;
+            /// Number of different tiles accepted at least once
+            std::size_t tiles;
+        };
+
+        class IngestServer {
+            const Options options;
+            int server = -1;
+            int bound_port = 0;
+            std::atomic<bool> stopping{false};
+            std::thread acceptor;
+
+            /// Connection threads by their ID and their sockets, the sockets are shut down when stopping
+            std::mutex connections_mutex;
+            std::map<std::thread::id, std::thread> connections;
+            /// Connection threads which are done and only wait to be joined
+            std::vector<std::thread::id> finished;
+            std::set<int> clients;
+
+            std::atomic<std::uint64_t> requests{0};
+            std::atomic<std::uint64_t> accepted{0};
+            std::atomic<std::uint64_t> errors{0};
+            std::atomic<std::uint64_t> throttled{0};
+            std::atomic<std::uint64_t> invalid{0};
+            std::atomic<std::uint64_t> bytes{0};
+
+            /// Random error injection, the throttling window and the received tiles
+            mutable std::mutex state_mutex;
+            std::mt19937_64 random;
+            std::int64_t window_second = 0;
+            int window_requests = 0;
+            std::set<std::tuple<int, int, int>> tiles;
+
+            void accept_connections();
+
+            void handle_connection(int client);
+
+            /// Status line of the response to a request with the given headers
+            std::string respond(const std::string &headers);
+
+        public:
+
+            /// Start listening on the loopback interface, throwing a std::runtime_error on failure
+            explicit IngestServer(const Options &options);
+
+            IngestServer(const IngestServer &) = delete;
+            IngestServer& operator = (const IngestServer &) = delete;
+
+            ~IngestServer();
+
+            int port() const {
+                return bound_port;
+            }
+
+            /// URL to push the tiles to
+            std::string url() const;
+
+            /// Stop accepting requests and close all connections
+            void stop();
+
+            Statistics statistics() const;
+        };
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_MOCK_INGEST_HPP
@@ -0,0 +1,124 @@
+#include "pipeline.hpp"
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "layout.hpp"
+#include "quadtree.hpp"
+#include "spawns.hpp"
+#include "trace.hpp"
+
+namespace rustymon {
+
+    namespace pipeline {
+
+        namespace {
+
+            void add_leaves(std::vector<structs::Tile *> &tiles, structs::Tile &tile) {
+                if (tile.children.empty()) {
+                    tiles.push_back(&tile);
+                }
+                for (structs::Tile &child: tile.children) {
+                    add_leaves(tiles, child);
+                }
+            }
+
+        }
+
+        TileProcessor::TileProcessor(const config::Config &config, memory::MemoryTracker *tracker) : config(config), tracker(tracker) {
+            if (!config.elevation.directory.empty()) {
+                elevation_model.reset(new elevation::ElevationModel(config.elevation.directory));
+            }
+        }
+
+        void TileProcessor::process(structs::Tile &tile) const {
+            trace::Scope scope{"post-process tile", "pipeline"};
+            tiles++;
+            if (config.layout.merge_streets) {
+                const layout::MergeStatistics statistics = layout::merge_streets(tile);
+                streets_before += statistics.streets_before;
+                streets_after += statistics.streets_after;
+                bytes_before += statistics.bytes_before;
+                bytes_after += statistics.bytes_after;
+            }
+            if (config.tiling.adaptive) {
+                const quadtree::SplitStatistics statistics = quadtree::split_tile(tile, config.tiling);
+                split += statistics.split;
+                leaves += statistics.leaves;
+                int current = depth.load();
+                while (statistics.depth > current && !depth.compare_exchange_weak(current, statistics.depth)) {
+                }
+            }
+
+            std::vector<structs::Tile *> tile_leaves;
+            add_leaves(tile_leaves, tile);
+            for (structs::Tile *leaf: tile_leaves) {
+                if (elevation_model) {
+                    const elevation::ElevationStatistics statistics = elevation::add_tile_elevation(*elevation_model, config.elevation, config.layout.shared_areas, *leaf, tracker);
+                    elevation_tiles += statistics.tiles;
+                    elevation_covered += statistics.covered;
+                    elevation_areas += statistics.areas;
+                }
+                if (config.layout.spatial_order) {
+                    layout::order_tile(*leaf, config.layout.bucket_level);
+                }
+                if (config.spawn_conditions.enabled) {
+                    leaf->spawn_table = spawns::build_spawn_table(*leaf, config.spawn_conditions.modifiers);
+                }
+            }
+        }
+
+        void TileProcessor::report(std::ostream &logger) const {
+            logger << "Post-processed " << tiles << " tiles while exporting." << std::endl;
+            if (config.layout.merge_streets) {
+                logger << "Merged streets: " << streets_before << " -> " << streets_after << " objects, "
+                       << bytes_before << " -> " << bytes_after << " bytes." << std::endl;
+            }
+            if (config.tiling.adaptive) {
+                logger << "Split tiles: " << split << " tiles split, " << leaves
+                       << " tiles without children, maximum level " << depth << "." << std::endl;
+            }
+            if (elevation_model) {
+                logger << "Elevation: " << elevation_covered << " of " << elevation_tiles << " tiles covered by "
+                       << elevation_model->mapped_files() << " elevation files, " << elevation_areas << " terrain areas added." << std::endl;
+            }
+        }
+
+        void process_world(structs::World &world, const TileProcessor &processor, const int worker_threads, const UnitConsumer &consumer) {
+            struct WorldTile {
+                int x;
+                int y;
+                structs::Tile *tile;
+            };
+            std::vector<WorldTile> tiles;
+            for (auto &x: world) {
+                for (auto &y: x.second) {
+                    tiles.push_back(WorldTile{x.first, y.first, &y.second});
+                }
+            }
+
+            std::atomic<std::size_t> next_index{0};
+            std::vector<std::thread> thread_pool;
+            const int threads = std::max(1, worker_threads);
+            thread_pool.reserve(threads);
+            for (int i = 0; i < threads; i++) {
+                thread_pool.emplace_back([&tiles, &processor, &consumer, &next_index, i](){
+                    trace::set_thread_name("pipeline worker " + std::to_string(i));
+                    for (std::size_t index = next_index++; index < tiles.size(); index = next_index++) {
+                        const WorldTile &entry = tiles[index];
+                        processor.process(*entry.tile);
+                        for (const structs::TileRef &unit: structs::export_units(entry.x, entry.y, *entry.tile)) {
+                            consumer(unit);
+                        }
+                    }
+                });
+            }
+            for (std::thread &t: thread_pool) {
+                t.join();
+            }
+        }
+
+    }
+
+}
@@ -0,0 +1,75 @@
+#ifndef WORLD_GENERATOR_PIPELINE_HPP
+#define WORLD_GENERATOR_PIPELINE_HPP
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <iostream>
+#include <functional>
+
+#include "config.hpp"
+#include "memory.hpp"
+#include "structs.hpp"
+#include "elevation.hpp"
+
+/*
+ * Pipelined post-processing: once the input can't change any tile anymore, the stages which
+ * only depend on a single tile (merging streets, splitting, elevation, spatial order and spawn
+ * tables) run tile by tile on worker threads, and the export units of every finished tile are
+ * handed to the exporter right away instead of waiting for the whole world.
+ */
+
+namespace rustymon {
+
+    namespace pipeline {
+
+        /// Called on the worker threads with every export unit of a finished tile, parents before their children
+        using UnitConsumer = std::function<void(const structs::TileRef &unit)>;
+
+        /**
+         * The per-tile stages of the post-processing in the same order as for the whole world. Coarsening
+         * joins neighbouring tiles, so it must run on the whole world before. It's safe to use this concurrently
+         * for different tiles, the statistics are collected over all of them.
+         */
+        class TileProcessor {
+            const config::Config &config;
+            memory::MemoryTracker *tracker;
+            std::unique_ptr<elevation::ElevationModel> elevation_model;
+
+            mutable std::atomic<std::size_t> tiles{0};
+            mutable std::atomic<std::size_t> streets_before{0};
+            mutable std::atomic<std::size_t> streets_after{0};
+            mutable std::atomic<std::size_t> bytes_before{0};
+            mutable std::atomic<std::size_t> bytes_after{0};
+            mutable std::atomic<std::size_t> split{0};
+            mutable std::atomic<std::size_t> leaves{0};
+            mutable std::atomic<int> depth{0};
+            mutable std::atomic<std::size_t> elevation_tiles{0};
+            mutable std::atomic<std::size_t> elevation_covered{0};
+            mutable std::atomic<std::size_t> elevation_areas{0};
+
+        public:
+
+            explicit TileProcessor(const config::Config &config, memory::MemoryTracker *tracker = nullptr);
+
+            TileProcessor(const TileProcessor &) = delete;
+            TileProcessor& operator = (const TileProcessor &) = delete;
+
+            /// Run all enabled stages on a tile of the world, which may get children by splitting it
+            void process(structs::Tile &tile) const;
+
+            /// Log the statistics of all stages like the post-processing of the whole world
+            void report(std::ostream &logger) const;
+        };
+
+        /**
+         * Process the tiles of the world with a number of worker threads and pass the export units of every
+         * tile to the consumer as soon as it's finished. Returns after all units were consumed.
+         */
+        void process_world(structs::World &world, const TileProcessor &processor, int worker_threads, const UnitConsumer &consumer);
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_PIPELINE_HPP
@@ -0,0 +1,220 @@
+#include "quadtree.hpp"
+
+#include <atomic>
+#include <algorithm>
+
+#include "geometry.hpp"
+
+namespace rustymon {
+
+    namespace quadtree {
+
+        namespace {
+
+            inline std::size_t object_count(const structs::Tile &tile) {
+                return tile.poi.size() + tile.streets.size() + tile.areas.size();
+            }
+
+            inline int floor_half(const int value) {
+                return value >= 0 ? value / 2 : -((1 - value) / 2);
+            }
+
+            structs::BoundingBox quadrant(const structs::BoundingBox &bbox, const int index) {
+                const double mid_x = (bbox.bottom_left.first + bbox.top_right.first) / 2;
+                const double mid_y = (bbox.bottom_left.second + bbox.top_right.second) / 2;
+                return structs::BoundingBox(
+                        (index & 1) ? mid_x : bbox.bottom_left.first,
+                        (index & 2) ? mid_y : bbox.bottom_left.second,
+                        (index & 1) ? bbox.top_right.first : mid_x,
+                        (index & 2) ? bbox.top_right.second : mid_y
+                );
+            }
+
+            void distribute(structs::Tile &tile) {
+                const double mid_x = (tile.bbox.bottom_left.first + tile.bbox.top_right.first) / 2;
+                const double mid_y = (tile.bbox.bottom_left.second + tile.bbox.top_right.second) / 2;
+                for (int i = 0; i < 4; i++) {
+                    tile.children.push_back(structs::Tile{quadrant(tile.bbox, i), {}, {}, {}});
+                    tile.children.back().level = tile.level + 1;
+                }
+
+                for (structs::POI &poi: tile.poi) {
+                    const int index = (poi.pos.first >= mid_x ? 1 : 0) + (poi.pos.second >= mid_y ? 2 : 0);
+                    tile.children[index].poi.push_back(std::move(poi));
+                }
+
+                for (structs::Tile &child: tile.children) {
+                    for (const structs::Street &street: tile.streets) {
+                        for (geometry::Ring &part: geometry::clip_polyline(child.bbox, street.waypoints)) {
+                            child.streets.push_back(structs::Street{street.oid, street.type, std::move(part), street.oids});
+                        }
+                    }
+                    for (const structs::Area &area: tile.areas) {
+                        geometry::Ring border = geometry::clip_ring(child.bbox, area.border);
+                        if (border.empty()) {
+                            continue;
+                        }
+                        std::vector<geometry::Ring> holes;
+                        for (const geometry::Ring &hole: area.holes) {
+                            geometry::Ring clipped = geometry::clip_ring(child.bbox, hole);
+                            if (!clipped.empty()) {
+                                holes.push_back(std::move(clipped));
+                            }
+                        }
+                        child.areas.push_back(structs::Area{area.oid, area.type, std::move(border), area.spawns, std::move(holes)});
+                    }
+                }
+
+                // Areas covering the tile also cover all of its quadrants
+                for (structs::Tile &child: tile.children) {
+                    child.covering.reserve(tile.covering.size());
+                    for (const structs::AreaRef &ref: tile.covering) {
+                        child.covering.push_back(ref);
+                    }
+                }
+
+                std::vector<structs::POI>().swap(tile.poi);
+                std::vector<structs::Street>().swap(tile.streets);
+                std::vector<structs::Area>().swap(tile.areas);
+                std::vector<structs::AreaRef>().swap(tile.covering);
+                tile.spawn_table = structs::SpawnTable{};
+                tile.bucket_index = structs::BucketIndex{};
+            }
+
+            template<typename T>
+            void append(std::vector<T> &target, std::vector<T> &source) {
+                // Objects can't be assigned because of their const members, so they are appended one by one
+                target.reserve(target.size() + source.size());
+                for (T &object: source) {
+                    target.push_back(std::move(object));
+                }
+            }
+
+        }
+
+        SplitStatistics split_tile(structs::Tile &tile, const config::Tiling &tiling, const int depth) {
+            SplitStatistics statistics{0, 1, tile.level};
+            if (depth >= tiling.max_depth || !tile.children.empty()) {
+                return statistics;
+            }
+            // The serialized size is only computed if the object count doesn't decide already
+            if (object_count(tile) <= static_cast<std::size_t>(tiling.max_objects) &&
+                    structs::serialized_size(tile) <= tiling.max_bytes) {
+                return statistics;
+            }
+
+            distribute(tile);
+            statistics = SplitStatistics{1, 0, tile.level};
+            for (structs::Tile &child: tile.children) {
+                const SplitStatistics child_statistics = split_tile(child, tiling, depth + 1);
+                statistics.split += child_statistics.split;
+                statistics.leaves += child_statistics.leaves;
+                statistics.depth = std::max(statistics.depth, child_statistics.depth);
+            }
+            return statistics;
+        }
+
+        SplitStatistics split_world(structs::World &world, const config::Tiling &tiling, const int worker_threads) {
+            std::atomic<std::size_t> split{0};
+            std::atomic<std::size_t> leaves{0};
+            std::atomic<int> depth{0};
+            structs::for_each_tile_parallel(world, worker_threads, [&](structs::Tile &tile){
+                const SplitStatistics statistics = split_tile(tile, tiling);
+                split += statistics.split;
+                leaves += statistics.leaves;
+                int current = depth.load();
+                while (statistics.depth > current && !depth.compare_exchange_weak(current, statistics.depth)) {
+                }
+            });
+            return SplitStatistics{split, leaves, depth};
+        }
+
+        std::size_t coarsen_world(structs::World &world, const config::Tiling &tiling, const int x_size_factor, const int y_size_factor) {
+            // Positions of the existing tiles of every 2x2 group, the group is keyed by its position on level -1
+            std::map<std::pair<int, int>, std::vector<std::pair<int, int>>> groups;
+            for (auto const &x: world) {
+                for (auto const &y: x.second) {
+                    groups[{floor_half(x.first), floor_half(y.first)}].emplace_back(x.first, y.first);
+                }
+            }
+
+            std::size_t removed = 0;
+            for (auto const &group: groups) {
+                if (group.second.size() < 2) {
+                    continue;
+                }
+                std::size_t objects = 0;
+                std::size_t bytes = 0;
+                bool joinable = true;
+                for (auto const &position: group.second) {
+                    const structs::Tile &tile = world[position.first].at(position.second);
+                    if (tile.level != 0 || !tile.children.empty()) {
+                        joinable = false;
+                        break;
+                    }
+                    objects += object_count(tile);
+                    bytes += structs::serialized_size(tile);
+                }
+                if (!joinable || objects > static_cast<std::size_t>(tiling.coarsen_max_objects) || bytes > tiling.max_bytes) {
+                    continue;
+                }
+
+                const int x = 2 * group.first.first;
+                const int y = 2 * group.first.second;
+                structs::Tile joined{structs::BoundingBox(
+                        static_cast<double>(x) / x_size_factor,
+                        static_cast<double>(y) / y_size_factor,
+                        (static_cast<double>(x) + 2) / x_size_factor,
+                        (static_cast<double>(y) + 2) / y_size_factor
+                ), {}, {}, {}};
+                joined.level = -1;
+
+                // Only areas covering all four tiles cover the joined tile, the others get the border of their tile
+                auto covers_all = [&world, &group](const structs::AreaRef &ref) {
+                    if (group.second.size() < 4) {
+                        return false;
+                    }
+                    for (auto const &position: group.second) {
+                        const std::vector<structs::AreaRef> &covering = world[position.first].at(position.second).covering;
+                        if (std::none_of(covering.begin(), covering.end(), [&ref](const structs::AreaRef &candidate) {
+                            return candidate.oid == ref.oid && candidate.type == ref.type;
+                        })) {
+                            return false;
+                        }
+                    }
+                    return true;
+                };
+                const structs::Tile &first = world[group.second.front().first].at(group.second.front().second);
+                for (const structs::AreaRef &ref: first.covering) {
+                    if (covers_all(ref)) {
+                        joined.covering.push_back(ref);
+                    }
+                }
+
+                for (auto const &position: group.second) {
+                    auto column = world.find(position.first);
+                    auto tile = column->second.find(position.second);
+                    append(joined.poi, tile->second.poi);
+                    append(joined.streets, tile->second.streets);
+                    append(joined.areas, tile->second.areas);
+                    for (const structs::AreaRef &ref: tile->second.covering) {
+                        if (std::none_of(joined.covering.begin(), joined.covering.end(), [&ref](const structs::AreaRef &candidate) {
+                            return candidate.oid == ref.oid && candidate.type == ref.type;
+                        })) {
+                            joined.areas.push_back(structs::Area{ref.oid, ref.type, geometry::box_ring(tile->second.bbox), ref.spawns});
+                        }
+                    }
+                    column->second.erase(tile);
+                    if (column->second.empty()) {
+                        world.erase(column);
+                    }
+                }
+                world[x].emplace(y, std::move(joined));
+                removed += group.second.size() - 1;
+            }
+            return removed;
+        }
+
+    }
+
+}
@@ -0,0 +1,42 @@
+#ifndef WORLD_GENERATOR_QUADTREE_HPP
+#define WORLD_GENERATOR_QUADTREE_HPP
+
+#include <cstddef>
+
+#include "config.hpp"
+#include "structs.hpp"
+
+namespace rustymon {
+
+    namespace quadtree {
+
+        struct SplitStatistics {
+            /// Number of tiles which were split into quadrants
+            std::size_t split;
+            /// Number of tiles without children after splitting
+            std::size_t leaves;
+            /// Highest level of any tile
+            int depth;
+        };
+
+        /**
+         * Split the tile into quadrants while it exceeds the object or size limits of the tiling and
+         * the maximum depth isn't reached. POIs are assigned to the quadrant containing them, streets
+         * and areas are clipped to the quadrants, so a street may end up as several parts with the same ID.
+         */
+        SplitStatistics split_tile(structs::Tile &tile, const config::Tiling &tiling, int depth = 0);
+
+        SplitStatistics split_world(structs::World &world, const config::Tiling &tiling, int worker_threads);
+
+        /**
+         * Join groups of 2x2 neighbouring tiles of level 0 into one tile of level -1 if all of them
+         * together stay below the coarsening limits. The joined tile is stored at the position of the
+         * south west tile of the group. Returns the number of tiles removed from the world.
+         */
+        std::size_t coarsen_world(structs::World &world, const config::Tiling &tiling, int x_size_factor, int y_size_factor);
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_QUADTREE_HPP
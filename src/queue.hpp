@@ -1,12 +1,21 @@
 #ifndef WORLD_GENERATOR_QUEUE_HPP
 #define WORLD_GENERATOR_QUEUE_HPP
 
+#include <mutex>
+#include <queue>
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <condition_variable>
+
+#include "constants.hpp"
+
 namespace rustymon {
 
     template<typename T>
     class ThreadSafeQueue {
 
-        static const std::size_t max_size = QUEUE_MAX_SIZE;
+        const std::size_t max_size;
 
         mutable std::mutex mutex{};
         std::queue<T> queue{};
@@ -19,6 +28,8 @@ namespace rustymon {
 
     public:
 
+        explicit ThreadSafeQueue(std::size_t max_size = QUEUE_MAX_SIZE) : max_size(max_size) {}
+
         /**
          * Push an element onto the queue. Block until space is available.
          * The element will be moved from the given space.
@@ -59,6 +70,21 @@ namespace rustymon {
             return pop(value, [](){return true;});
         }
 
+        /**
+         * Pop an element from the queue without waiting. Return false if the queue is empty.
+         * The element will be moved to the given space.
+         */
+        bool try_pop(T &value) {
+            std::unique_lock<std::mutex> lock{mutex};
+            if (queue.empty()) {
+                return false;
+            }
+            value = std::move(queue.front());
+            queue.pop();
+            space_available.notify_one();
+            return true;
+        }
+
         /**
          * Check if the queue is empty.
          */
@@ -0,0 +1,148 @@
+#include "sinks.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+
+#include "archive.hpp"
+#include "exporter.hpp"
+#include "queue.hpp"
+#include "trace.hpp"
+
+namespace rustymon {
+
+    namespace sinks {
+
+        ArchiveSink::ArchiveSink(const std::string &filename, std::ostream &logger) : Sink("archive " + filename), filename(filename), logger(logger) {
+        }
+
+        SinkResult ArchiveSink::run(const std::size_t unit_count, const UnitSource &source) {
+            SinkResult result{0, 0};
+            std::unique_ptr<archive::Writer> writer;
+            try {
+                writer.reset(new archive::Writer(filename, unit_count));
+            } catch (std::runtime_error &error) {
+                logger << error.what() << std::endl;
+            }
+
+            Unit unit;
+            while (source(unit, true) == UnitState::READY) {
+                result.units++;
+                if (!writer) {
+                    result.errors++;
+                    continue;
+                }
+                try {
+                    trace::Scope scope{"write", "export"};
+                    writer->add(unit.address.x, unit.address.y, unit.address.level, *unit.payload);
+                } catch (std::runtime_error &error) {
+                    logger << error.what() << std::endl;
+                    result.errors++;
+                }
+            }
+            if (writer) {
+                try {
+                    writer->close();
+                    logger << "Wrote " << result.units - result.errors << " tiles to the archive " << filename << "." << std::endl;
+                } catch (std::runtime_error &error) {
+                    // The archive is unusable without its index
+                    logger << error.what() << std::endl;
+                    result.errors = result.units;
+                }
+            }
+            return result;
+        }
+
+        HttpSink::HttpSink(const std::string &push_url, const std::string &auth_info, const config::Http &http_config, std::ostream &logger, memory::MemoryTracker *tracker, checkpoint::ExportJournal *journal) :
+                Sink("http " + push_url), push_url(push_url), auth_info(auth_info), http_config(http_config), logger(logger), tracker(tracker), journal(journal) {
+        }
+
+        SinkResult HttpSink::run(std::size_t, const UnitSource &source) {
+            std::atomic<std::size_t> skipped{0};
+            // The source is called from the event loops, which must not wait for the next unit
+            const upload::JobSource job_source = [this, &source, &skipped](upload::UploadJob &job) {
+                Unit unit;
+                while (true) {
+                    const UnitState state = source(unit, false);
+                    if (state != UnitState::READY) {
+                        return (state == UnitState::DONE) ? upload::JobState::DONE : upload::JobState::LATER;
+                    }
+                    if (journal == nullptr || !journal->contains(unit.address.x, unit.address.y, unit.address.level)) {
+                        break;
+                    }
+                    skipped++;
+                }
+                job.x = unit.address.x;
+                job.y = unit.address.y;
+                job.level = unit.address.level;
+                job.body = *unit.payload;
+                return upload::JobState::READY;
+            };
+            const upload::UploadResult result = detail::upload_from_source(detail::upload_options(push_url, http_config, auth_info), job_source, logger, tracker, journal);
+            return SinkResult{static_cast<std::size_t>(result.total_requests) + skipped, static_cast<std::size_t>(result.errors)};
+        }
+
+        std::size_t export_world_to_sinks(const structs::World &world, const std::vector<std::unique_ptr<Sink>> &sinks, std::ostream &logger, const int worker_threads, const std::size_t buffer_units) {
+            const std::vector<structs::TileRef> units = structs::export_units(world);
+
+            std::vector<std::unique_ptr<ThreadSafeQueue<Unit>>> queues;
+            std::vector<SinkResult> results(sinks.size(), SinkResult{0, 0});
+            // Time the serialization waited for space in the queue of each sink
+            std::vector<std::chrono::steady_clock::duration> blocked(sinks.size(), std::chrono::steady_clock::duration::zero());
+            std::atomic<bool> producing{true};
+
+            std::vector<std::thread> sink_threads;
+            sink_threads.reserve(sinks.size());
+            for (std::size_t i = 0; i < sinks.size(); i++) {
+                queues.emplace_back(new ThreadSafeQueue<Unit>(std::max<std::size_t>(1, buffer_units)));
+            }
+            for (std::size_t i = 0; i < sinks.size(); i++) {
+                sink_threads.emplace_back([&sinks, &queues, &results, &units, &producing, i](){
+                    trace::set_thread_name("sink " + sinks[i]->name);
+                    ThreadSafeQueue<Unit> &queue = *queues[i];
+                    results[i] = sinks[i]->run(units.size(), [&queue, &producing](Unit &unit, const bool wait) {
+                        if (!wait) {
+                            // The flag is read before the queue, the queue can only be empty and stay empty after the serialization stopped
+                            const bool done = !producing;
+                            if (queue.try_pop(unit)) {
+                                return UnitState::READY;
+                            }
+                            return done ? UnitState::DONE : UnitState::LATER;
+                        }
+                        try {
+                            queue.pop(unit, [&producing]() { return producing.load(); });
+                        } catch (std::runtime_error &) {
+                            // The queue is only empty after the serialization stopped when all units were taken
+                            return UnitState::DONE;
+                        }
+                        return UnitState::READY;
+                    });
+                });
+            }
+
+            logger << "Exporting " << units.size() << " tiles to " << sinks.size() << " sinks..." << std::endl;
+            detail::serialize_tiles_in_order(units, worker_threads, [&queues, &blocked](const structs::TileAddress &address, std::string &payload) {
+                const std::shared_ptr<const std::string> shared = std::make_shared<const std::string>(std::move(payload));
+                for (std::size_t i = 0; i < queues.size(); i++) {
+                    const auto start = std::chrono::steady_clock::now();
+                    queues[i]->push(Unit{address, shared});
+                    blocked[i] += std::chrono::steady_clock::now() - start;
+                }
+            }, false);
+            producing = false;
+
+            std::size_t errors = 0;
+            for (std::size_t i = 0; i < sinks.size(); i++) {
+                sink_threads[i].join();
+                errors += results[i].errors;
+                logger << "Sink " << sinks[i]->name << ": " << results[i].units << " of " << units.size() << " tiles with "
+                       << results[i].errors << " errors, blocked the export for "
+                       << std::chrono::duration<double>(blocked[i]).count() << " s." << std::endl;
+            }
+            return errors;
+        }
+
+    }
+
+}
@@ -0,0 +1,105 @@
+#ifndef WORLD_GENERATOR_SINKS_HPP
+#define WORLD_GENERATOR_SINKS_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <iostream>
+#include <functional>
+
+#include "config.hpp"
+#include "structs.hpp"
+#include "memory.hpp"
+#include "checkpoint.hpp"
+
+/*
+ * Export of one world to several sinks in a single run: every export unit is serialized once
+ * and the shared payload is passed to all sinks. Each sink consumes the units on a thread of its
+ * own from a bounded queue, so a slow sink only holds back the others when its queue is full.
+ */
+
+namespace rustymon {
+
+    namespace sinks {
+
+        /// Serialized export unit, the payload is shared by all sinks
+        struct Unit {
+            structs::TileAddress address;
+            std::shared_ptr<const std::string> payload;
+        };
+
+        enum class UnitState {
+            READY,
+            /// No unit is available yet, only returned when not waiting
+            LATER,
+            /// All units have been taken
+            DONE
+        };
+
+        /// Next unit for a sink, waiting for it if `wait` is true
+        using UnitSource = std::function<UnitState(Unit &unit, bool wait)>;
+
+        struct SinkResult {
+            /// Number of units stored by the sink, including failed ones
+            std::size_t units;
+            std::size_t errors;
+        };
+
+        class Sink {
+        public:
+
+            /// Short description of the sink for the log, e.g. "archive tiles.rta"
+            const std::string name;
+
+            explicit Sink(std::string name) : name(std::move(name)) {}
+
+            virtual ~Sink() = default;
+
+            /**
+             * Store all units of the source, which yields `unit_count` units. This must take
+             * every unit even after errors, otherwise the export waits for the sink forever.
+             */
+            virtual SinkResult run(std::size_t unit_count, const UnitSource &source) = 0;
+        };
+
+        /// Tile archive (see archive.hpp) written to the given file
+        class ArchiveSink : public Sink {
+            const std::string filename;
+            std::ostream &logger;
+
+        public:
+
+            ArchiveSink(const std::string &filename, std::ostream &logger);
+
+            SinkResult run(std::size_t unit_count, const UnitSource &source) override;
+        };
+
+        /// Upload with the asynchronous uploader, skipping the units recorded in the journal (if any)
+        class HttpSink : public Sink {
+            const std::string push_url;
+            const std::string auth_info;
+            const config::Http &http_config;
+            std::ostream &logger;
+            memory::MemoryTracker *tracker;
+            checkpoint::ExportJournal *journal;
+
+        public:
+
+            HttpSink(const std::string &push_url, const std::string &auth_info, const config::Http &http_config, std::ostream &logger, memory::MemoryTracker *tracker = nullptr, checkpoint::ExportJournal *journal = nullptr);
+
+            SinkResult run(std::size_t unit_count, const UnitSource &source) override;
+        };
+
+        /**
+         * Serialize the export units of the world with a number of worker threads and pass each of them
+         * to all sinks. At most `buffer_units` units wait for every sink, a sink with a full queue blocks the
+         * serialization until it took the next unit. Logs the results of the sinks and returns the total number of errors.
+         */
+        std::size_t export_world_to_sinks(const structs::World &world, const std::vector<std::unique_ptr<Sink>> &sinks, std::ostream &logger, int worker_threads, std::size_t buffer_units);
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_SINKS_HPP
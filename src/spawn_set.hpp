@@ -0,0 +1,109 @@
+#ifndef WORLD_GENERATOR_SPAWN_SET_HPP
+#define WORLD_GENERATOR_SPAWN_SET_HPP
+
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+namespace rustymon {
+
+    /**
+     * Set of spawn types stored as a bitmask. Spawn types are identified by their 1-indexed
+     * enum value like in the config file, the ID i is stored in bit i - 1.
+     */
+    class SpawnSet {
+
+        std::uint64_t bits{0};
+
+    public:
+
+        static const int MAX_ID = 64;
+
+        SpawnSet() = default;
+
+        explicit SpawnSet(std::uint64_t bits) : bits(bits) {}
+
+        static bool valid(const int id) {
+            return id >= 1 && id <= MAX_ID;
+        }
+
+        /// Add the spawn type, the ID has to be valid
+        void add(const int id) {
+            bits |= std::uint64_t{1} << (id - 1);
+        }
+
+        bool contains(const int id) const {
+            return valid(id) && (bits >> (id - 1)) & 1;
+        }
+
+        bool empty() const {
+            return bits == 0;
+        }
+
+        int size() const {
+            return __builtin_popcountll(bits);
+        }
+
+        std::uint64_t mask() const {
+            return bits;
+        }
+
+        /// Call the function with every ID of the set in ascending order
+        template<typename F>
+        void for_each(F function) const {
+            for (std::uint64_t remaining = bits; remaining != 0; remaining &= remaining - 1) {
+                function(__builtin_ctzll(remaining) + 1);
+            }
+        }
+
+        std::vector<int> ids() const {
+            std::vector<int> result;
+            result.reserve(size());
+            for_each([&result](int id) {
+                result.push_back(id);
+            });
+            return result;
+        }
+
+        SpawnSet &operator |= (const SpawnSet &other) {
+            bits |= other.bits;
+            return *this;
+        }
+
+        SpawnSet &operator &= (const SpawnSet &other) {
+            bits &= other.bits;
+            return *this;
+        }
+
+        friend SpawnSet operator | (const SpawnSet &a, const SpawnSet &b) {
+            return SpawnSet{a.bits | b.bits};
+        }
+
+        friend SpawnSet operator & (const SpawnSet &a, const SpawnSet &b) {
+            return SpawnSet{a.bits & b.bits};
+        }
+
+        friend bool operator == (const SpawnSet &a, const SpawnSet &b) {
+            return a.bits == b.bits;
+        }
+
+        friend bool operator != (const SpawnSet &a, const SpawnSet &b) {
+            return a.bits != b.bits;
+        }
+
+        /// Write the set as JSON list of IDs in ascending order
+        friend std::ostream& operator << (std::ostream &stream, const SpawnSet &spawns) {
+            stream << "[";
+            bool first = true;
+            spawns.for_each([&stream, &first](int id) {
+                stream << (first ? "" : ",") << id;
+                first = false;
+            });
+            stream << "]";
+            return stream;
+        }
+    };
+
+}
+
+#endif //WORLD_GENERATOR_SPAWN_SET_HPP
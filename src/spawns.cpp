@@ -0,0 +1,131 @@
+#include "spawns.hpp"
+
+#include <map>
+#include <cmath>
+#include <algorithm>
+
+namespace rustymon {
+
+    namespace spawns {
+
+        namespace {
+
+            const char *const DIMENSION_NAMES[] = {"time", "weather", "moon", "temperature"};
+            const int DIMENSION_SIZES[] = {TIME_TYPE_COUNT, WEATHER_TYPE_COUNT, MOON_TYPE_COUNT, TEMPERATURE_TYPE_COUNT};
+            const int DIMENSION_COUNT = 4;
+
+            const std::vector<int> &modifier_values(const config::ConditionModifier &modifier, const int dimension) {
+                switch (dimension) {
+                    case 0:
+                        return modifier.time;
+                    case 1:
+                        return modifier.weather;
+                    case 2:
+                        return modifier.moon;
+                    default:
+                        return modifier.temperature;
+                }
+            }
+
+            bool modifier_matches(const config::ConditionModifier &modifier, const int (&condition)[DIMENSION_COUNT]) {
+                for (int dimension = 0; dimension < DIMENSION_COUNT; dimension++) {
+                    const std::vector<int> &values = modifier_values(modifier, dimension);
+                    // Conditions are 1-indexed in the config file, like all other enum values
+                    if (!values.empty() && std::find(values.begin(), values.end(), condition[dimension] + 1) == values.end()) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+        }
+
+        structs::SpawnTable build_spawn_table(const structs::Tile &tile, const std::vector<config::ConditionModifier> &modifiers) {
+            // Weights are indexed by the bit of the spawn type
+            int base_weights[SpawnSet::MAX_ID] = {};
+            SpawnSet present;
+            auto count = [&base_weights](int spawn) {
+                base_weights[spawn - 1]++;
+            };
+            for (const structs::POI &poi: tile.poi) {
+                poi.spawns.for_each(count);
+                present |= poi.spawns;
+            }
+            for (const structs::Area &area: tile.areas) {
+                area.spawns.for_each(count);
+                present |= area.spawns;
+            }
+            for (const structs::AreaRef &ref: tile.covering) {
+                ref.spawns.for_each(count);
+                present |= ref.spawns;
+            }
+
+            structs::SpawnTable table;
+            if (present.empty()) {
+                return table;
+            }
+            table.spawns = present.ids();
+
+            // Only dimensions restricted by a relevant modifier are part of the table
+            std::vector<const config::ConditionModifier *> relevant;
+            bool used[DIMENSION_COUNT] = {false, false, false, false};
+            for (const config::ConditionModifier &modifier: modifiers) {
+                if (!present.contains(modifier.spawn)) {
+                    continue;
+                }
+                relevant.push_back(&modifier);
+                for (int dimension = 0; dimension < DIMENSION_COUNT; dimension++) {
+                    used[dimension] = used[dimension] || !modifier_values(modifier, dimension).empty();
+                }
+            }
+            std::vector<int> dimensions;
+            std::size_t combinations = 1;
+            for (int dimension = 0; dimension < DIMENSION_COUNT; dimension++) {
+                if (used[dimension]) {
+                    dimensions.push_back(dimension);
+                    table.dimensions.emplace_back(DIMENSION_NAMES[dimension]);
+                    combinations *= DIMENSION_SIZES[dimension];
+                }
+            }
+
+            std::map<std::vector<int>, std::uint16_t> known_rows;
+            table.index.reserve(combinations);
+            for (std::size_t combination = 0; combination < combinations; combination++) {
+                int condition[DIMENSION_COUNT] = {0, 0, 0, 0};
+                std::size_t remainder = combination;
+                for (auto it = dimensions.rbegin(); it != dimensions.rend(); ++it) {
+                    condition[*it] = static_cast<int>(remainder % DIMENSION_SIZES[*it]);
+                    remainder /= DIMENSION_SIZES[*it];
+                }
+
+                std::vector<int> row;
+                row.reserve(table.spawns.size());
+                for (const int &spawn: table.spawns) {
+                    double weight = base_weights[spawn - 1] * WEIGHT_SCALE;
+                    for (const config::ConditionModifier *modifier: relevant) {
+                        if (modifier->spawn == spawn && modifier_matches(*modifier, condition)) {
+                            weight *= modifier->factor;
+                        }
+                    }
+                    row.push_back(static_cast<int>(std::lround(weight)));
+                }
+
+                auto known = known_rows.find(row);
+                if (known == known_rows.end()) {
+                    known = known_rows.insert(std::pair<std::vector<int>, std::uint16_t>{row, static_cast<std::uint16_t>(table.rows.size())}).first;
+                    table.rows.push_back(std::move(row));
+                }
+                table.index.push_back(known->second);
+            }
+            return table;
+        }
+
+        void build_spawn_tables(structs::World &world, const config::SpawnConditions &conditions, const int worker_threads) {
+            structs::for_each_tile_parallel(world, worker_threads, [&conditions](structs::Tile &tile){
+                tile.spawn_table = build_spawn_table(tile, conditions.modifiers);
+            });
+        }
+
+    }
+
+}
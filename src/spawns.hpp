@@ -0,0 +1,33 @@
+#ifndef WORLD_GENERATOR_SPAWNS_HPP
+#define WORLD_GENERATOR_SPAWNS_HPP
+
+#include "enums.hpp"
+#include "config.hpp"
+#include "structs.hpp"
+
+namespace rustymon {
+
+    namespace spawns {
+
+        static const int TIME_TYPE_COUNT = static_cast<int>(TimeType::NIGHT) + 1;
+        static const int WEATHER_TYPE_COUNT = static_cast<int>(WeatherType::EXTREME_WARNING) + 1;
+        static const int MOON_TYPE_COUNT = static_cast<int>(MoonType::BLOODY) + 1;
+        static const int TEMPERATURE_TYPE_COUNT = static_cast<int>(TemperatureType::HOT) + 1;
+
+        /// Weights are stored as integers, scaled by this factor
+        static const int WEIGHT_SCALE = 100;
+
+        /**
+         * Build the spawn table of a tile. The base weight of every spawn type is the number of
+         * POIs and areas offering it, which is multiplied by the factors of all matching modifiers.
+         */
+        structs::SpawnTable build_spawn_table(const structs::Tile &tile, const std::vector<config::ConditionModifier> &modifiers);
+
+        /// Build the spawn tables of all tiles of the world with the given number of threads
+        void build_spawn_tables(structs::World &world, const config::SpawnConditions &conditions, int worker_threads);
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_SPAWNS_HPP
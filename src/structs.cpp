@@ -1,5 +1,9 @@
 #include "structs.hpp"
 
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
 namespace rustymon {
 
     namespace structs {
@@ -23,15 +27,8 @@ namespace rustymon {
                    << "\"type\":" << poi.type << ","
                    << "\"oid\":" << poi.oid << ","
                    << "\"point\":[" << poi.pos.first << "," << poi.pos.second << "],"
-                   << "\"spawns\":[";
-            int i = 0;
-            for (; i + 1 < poi.spawns.size(); i++) {
-                stream << poi.spawns[i] << ",";
-            }
-            if (!poi.spawns.empty()) {
-                stream << poi.spawns[i];
-            }
-            stream << "]}";
+                   << "\"spawns\":" << poi.spawns
+                   << "}";
             return stream;
         }
 
@@ -49,7 +46,15 @@ namespace rustymon {
                 const std::pair<double, double> &point = street.waypoints[i];
                 stream << "[" << point.first << "," << point.second << "]";
             }
-            stream << "]}";
+            stream << "]";
+            if (!street.oids.empty()) {
+                stream << ",\"oids\":[";
+                for (std::size_t j = 0; j < street.oids.size(); j++) {
+                    stream << (j > 0 ? "," : "") << street.oids[j];
+                }
+                stream << "]";
+            }
+            stream << "}";
             return stream;
         }
 
@@ -57,16 +62,9 @@ namespace rustymon {
             stream << "{"
                    << "\"type\":" << area.type << ","
                    << "\"oid\":" << area.oid << ","
-                   << "\"spawns\":[";
+                   << "\"spawns\":" << area.spawns
+                   << ",\"points\":[";
             int i = 0;
-            for (; i + 1 < area.spawns.size(); i++) {
-                stream << area.spawns[i] << ",";
-            }
-            if (!area.spawns.empty()) {
-                stream << area.spawns[i];
-            }
-            stream << "],\"points\":[";
-            i = 0;
             for (; i + 1 < area.border.size(); i++) {
                 const std::pair<double, double> &point = area.border[i];
                 stream << "[" << point.first << "," << point.second << "],";
@@ -75,10 +73,79 @@ namespace rustymon {
                 const std::pair<double, double> &point = area.border[i];
                 stream << "[" << point.first << "," << point.second << "]";
             }
+            stream << "]";
+            if (!area.holes.empty()) {
+                stream << ",\"holes\":[";
+                for (std::size_t j = 0; j < area.holes.size(); j++) {
+                    stream << (j > 0 ? ",[" : "[");
+                    for (std::size_t k = 0; k < area.holes[j].size(); k++) {
+                        const std::pair<double, double> &point = area.holes[j][k];
+                        stream << (k > 0 ? ",[" : "[") << point.first << "," << point.second << "]";
+                    }
+                    stream << "]";
+                }
+                stream << "]";
+            }
+            stream << "}";
+            return stream;
+        }
+
+        std::ostream& operator << (std::ostream &stream, const AreaRef &ref) {
+            stream << "{"
+                   << "\"type\":" << ref.type << ","
+                   << "\"oid\":" << ref.oid << ","
+                   << "\"spawns\":" << ref.spawns
+                   << "}";
+            return stream;
+        }
+
+        std::ostream& operator << (std::ostream &stream, const SpawnTable &table) {
+            stream << "{\"dimensions\":[";
+            for (std::size_t i = 0; i < table.dimensions.size(); i++) {
+                stream << (i > 0 ? "," : "") << "\"" << table.dimensions[i] << "\"";
+            }
+            stream << "],\"spawns\":[";
+            for (std::size_t i = 0; i < table.spawns.size(); i++) {
+                stream << (i > 0 ? "," : "") << table.spawns[i];
+            }
+            stream << "],\"rows\":[";
+            for (std::size_t i = 0; i < table.rows.size(); i++) {
+                stream << (i > 0 ? ",[" : "[");
+                for (std::size_t j = 0; j < table.rows[i].size(); j++) {
+                    stream << (j > 0 ? "," : "") << table.rows[i][j];
+                }
+                stream << "]";
+            }
+            stream << "],\"index\":[";
+            for (std::size_t i = 0; i < table.index.size(); i++) {
+                stream << (i > 0 ? "," : "") << table.index[i];
+            }
+            stream << "]}";
+            return stream;
+        }
+
+        std::ostream& operator << (std::ostream &stream, const BucketIndex &index) {
+            stream << "{\"level\":" << index.level << ",\"poi\":[";
+            for (std::size_t i = 0; i < index.poi.size(); i++) {
+                stream << (i > 0 ? "," : "") << index.poi[i];
+            }
+            stream << "],\"streets\":[";
+            for (std::size_t i = 0; i < index.streets.size(); i++) {
+                stream << (i > 0 ? "," : "") << index.streets[i];
+            }
+            stream << "],\"areas\":[";
+            for (std::size_t i = 0; i < index.areas.size(); i++) {
+                stream << (i > 0 ? "," : "") << index.areas[i];
+            }
             stream << "]}";
             return stream;
         }
 
+        std::ostream& operator << (std::ostream &stream, const Elevation &elevation) {
+            stream << "{\"min\":" << elevation.min << ",\"max\":" << elevation.max << ",\"mean\":" << elevation.mean << "}";
+            return stream;
+        }
+
         std::ostream& operator << (std::ostream &stream, const Tile &tile) {
             stream << "{";
             if (tile.bbox.valid()) {
@@ -88,6 +155,9 @@ namespace rustymon {
                        << tile.bbox.top_right.first << ","
                        << tile.bbox.top_right.second << "],";
             }
+            if (tile.level != 0) {
+                stream << "\"level\":" << tile.level << ",";
+            }
             stream << "\"poi\":[";
             int i = 0;
             for (; i + 1 < tile.poi.size(); i++) {
@@ -112,7 +182,31 @@ namespace rustymon {
             if (!tile.areas.empty()) {
                 stream << tile.areas[i];
             }
-            stream << "]}";
+            stream << "]";
+            if (!tile.covering.empty()) {
+                stream << ",\"covering\":[";
+                for (std::size_t j = 0; j < tile.covering.size(); j++) {
+                    stream << (j > 0 ? "," : "") << tile.covering[j];
+                }
+                stream << "]";
+            }
+            if (!tile.spawn_table.spawns.empty()) {
+                stream << ",\"spawn_table\":" << tile.spawn_table;
+            }
+            if (tile.bucket_index.level > 0) {
+                stream << ",\"buckets\":" << tile.bucket_index;
+            }
+            if (tile.elevation.samples > 0) {
+                stream << ",\"elevation\":" << tile.elevation;
+            }
+            if (!tile.children.empty()) {
+                stream << ",\"children\":[";
+                for (std::size_t j = 0; j < tile.children.size(); j++) {
+                    stream << (j > 0 ? "," : "") << tile.children[j];
+                }
+                stream << "]";
+            }
+            stream << "}";
             return stream;
         }
 
@@ -129,6 +223,141 @@ namespace rustymon {
             return stream;
         }
 
+        namespace {
+
+            inline int floor_shift(const int value, const int bits) {
+                return value >= 0 ? value >> bits : -((-value - 1) >> bits) - 1;
+            }
+
+            void add_units(std::vector<TileRef> &units, const TileAddress &address, const Tile &tile) {
+                units.emplace_back(address, &tile);
+                for (std::size_t i = 0; i < tile.children.size(); i++) {
+                    add_units(units, TileAddress{
+                            address.level + 1,
+                            2 * address.x + static_cast<int>(i & 1),
+                            2 * address.y + static_cast<int>(i >> 1)
+                    }, tile.children[i]);
+                }
+            }
+
+            void add_leaves(std::vector<Tile *> &tiles, Tile &tile) {
+                if (tile.children.empty()) {
+                    tiles.push_back(&tile);
+                }
+                for (Tile &child: tile.children) {
+                    add_leaves(tiles, child);
+                }
+            }
+
+        }
+
+        std::vector<TileRef> export_units(const World &world) {
+            std::vector<TileRef> units;
+            for (auto const &x: world) {
+                for (auto const &y: x.second) {
+                    const std::vector<TileRef> tile_units = export_units(x.first, y.first, y.second);
+                    units.insert(units.end(), tile_units.begin(), tile_units.end());
+                }
+            }
+            return units;
+        }
+
+        std::vector<TileRef> export_units(const int x, const int y, const Tile &tile) {
+            std::vector<TileRef> units;
+            const int level = tile.level;
+            const TileAddress address = (level < 0) ?
+                    TileAddress{level, floor_shift(x, -level), floor_shift(y, -level)} :
+                    TileAddress{level, x, y};
+            add_units(units, address, tile);
+            return units;
+        }
+
+        std::ostream& stream_unit(std::ostream &stream, const TileRef &unit) {
+            const Tile &tile = *unit.second;
+            if (tile.children.empty()) {
+                return stream << tile;
+            }
+            const TileAddress &address = unit.first;
+            stream << "{\"bbox\":["
+                   << tile.bbox.bottom_left.first << ","
+                   << tile.bbox.bottom_left.second << ","
+                   << tile.bbox.top_right.first << ","
+                   << tile.bbox.top_right.second << "],"
+                   << "\"level\":" << address.level << ","
+                   << "\"children\":[";
+            for (std::size_t i = 0; i < tile.children.size(); i++) {
+                stream << (i > 0 ? "," : "") << "["
+                       << address.level + 1 << ","
+                       << 2 * address.x + static_cast<int>(i & 1) << ","
+                       << 2 * address.y + static_cast<int>(i >> 1) << "]";
+            }
+            stream << "]}";
+            return stream;
+        }
+
+        void for_each_tile_parallel(World &world, const int worker_threads, const std::function<void(Tile &tile)> &function) {
+            std::vector<Tile *> tiles;
+            for (auto &x: world) {
+                for (auto &y: x.second) {
+                    add_leaves(tiles, y.second);
+                }
+            }
+
+            std::atomic<std::size_t> next_index{0};
+            std::vector<std::thread> thread_pool;
+            const int threads = std::max(1, worker_threads);
+            thread_pool.reserve(threads);
+            for (int i = 0; i < threads; i++) {
+                thread_pool.emplace_back([&tiles, &function, &next_index](){
+                    for (std::size_t index = next_index++; index < tiles.size(); index = next_index++) {
+                        function(*tiles[index]);
+                    }
+                });
+            }
+            for (std::thread &t: thread_pool) {
+                t.join();
+            }
+        }
+
+        std::size_t memory_usage(const POI &) {
+            return sizeof(POI);
+        }
+
+        std::size_t memory_usage(const Street &street) {
+            return sizeof(Street) + street.waypoints.capacity() * sizeof(std::pair<double, double>) + street.oids.capacity() * sizeof(long);
+        }
+
+        std::size_t memory_usage(const Area &area) {
+            std::size_t total = sizeof(Area) + area.border.capacity() * sizeof(std::pair<double, double>);
+            total += area.holes.capacity() * sizeof(std::vector<std::pair<double, double>>);
+            for (const std::vector<std::pair<double, double>> &hole: area.holes) {
+                total += hole.capacity() * sizeof(std::pair<double, double>);
+            }
+            return total;
+        }
+
+        std::size_t memory_usage(const AreaRef &) {
+            return sizeof(AreaRef);
+        }
+
+        std::size_t memory_usage(const Tile &tile) {
+            std::size_t total = sizeof(Tile);
+            for (const POI &poi: tile.poi) {
+                total += memory_usage(poi);
+            }
+            for (const Street &street: tile.streets) {
+                total += memory_usage(street);
+            }
+            for (const Area &area: tile.areas) {
+                total += memory_usage(area);
+            }
+            total += tile.covering.capacity() * sizeof(AreaRef);
+            for (const Tile &child: tile.children) {
+                total += memory_usage(child);
+            }
+            return total;
+        }
+
     }
 
 }
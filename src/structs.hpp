@@ -2,8 +2,13 @@
 #define WORLD_GENERATOR_STRUCTS_HPP
 
 #include <map>
+#include <string>
 #include <vector>
+#include <cstdint>
 #include <iostream>
+#include <functional>
+
+#include "spawn_set.hpp"
 
 namespace rustymon {
 
@@ -29,7 +34,7 @@ namespace rustymon {
             const long oid;
             const int type;
             std::pair<double, double> pos;
-            std::vector<int> spawns;
+            SpawnSet spawns;
 
             friend std::ostream& operator << (std::ostream &stream, const POI &poi);
         };
@@ -40,6 +45,8 @@ namespace rustymon {
             const long oid;
             const int type;
             std::vector<std::pair<double, double>> waypoints;
+            /// IDs of all ways merged into this street in the order of the waypoints, empty if it wasn't merged
+            std::vector<long> oids{};
 
             friend std::ostream& operator << (std::ostream &stream, const Street &street);
         };
@@ -50,18 +57,90 @@ namespace rustymon {
             const long oid;
             const int type;
             std::vector<std::pair<double, double>> border;
-            std::vector<int> spawns;
+            SpawnSet spawns;
+            /// Inner rings cut out of the border, e.g. islands in a water area
+            std::vector<std::vector<std::pair<double, double>>> holes{};
 
             friend std::ostream& operator << (std::ostream &stream, const Area &area);
         };
 
         std::ostream& operator << (std::ostream &stream, const Area &area);
 
+        /// Area covering a whole tile, its geometry is only stored in the tiles along its border
+        struct AreaRef {
+            const long oid;
+            const int type;
+            SpawnSet spawns;
+
+            friend std::ostream& operator << (std::ostream &stream, const AreaRef &ref);
+        };
+
+        std::ostream& operator << (std::ostream &stream, const AreaRef &ref);
+
+        /**
+         * Precomputed weighted spawn lists of a tile for all combinations of environment conditions.
+         * Only the condition dimensions which influence any weight are part of the table.
+         */
+        struct SpawnTable {
+            /// Names of the condition dimensions in the order of the combination index
+            std::vector<std::string> dimensions;
+            /// Spawn types the weights in every row refer to
+            std::vector<int> spawns;
+            /// Distinct rows of weights, one weight per spawn type
+            std::vector<std::vector<int>> rows;
+            /// Row index for every combination of conditions (mixed radix, first dimension varies slowest)
+            std::vector<std::uint16_t> index;
+
+            friend std::ostream& operator << (std::ostream &stream, const SpawnTable &table);
+        };
+
+        std::ostream& operator << (std::ostream &stream, const SpawnTable &table);
+
+        /**
+         * Index of the spatially ordered objects of a tile. The tile is split into 4^level sub-cells
+         * in Morton order; each list holds 4^level + 1 offsets, and the objects of sub-cell i are stored
+         * from offset i (inclusive) to offset i + 1 (exclusive) of the corresponding vector of the tile.
+         */
+        struct BucketIndex {
+            /// Number of subdivisions of the tile, zero if the objects are not spatially ordered
+            int level;
+            std::vector<std::uint32_t> poi;
+            std::vector<std::uint32_t> streets;
+            std::vector<std::uint32_t> areas;
+
+            friend std::ostream& operator << (std::ostream &stream, const BucketIndex &index);
+        };
+
+        std::ostream& operator << (std::ostream &stream, const BucketIndex &index);
+
+        /// Elevation of a tile in meters, summarized from samples of an elevation model
+        struct Elevation {
+            /// Number of samples with elevation data, zero if the elevation model doesn't cover the tile
+            int samples;
+            int min;
+            int max;
+            int mean;
+
+            friend std::ostream& operator << (std::ostream &stream, const Elevation &elevation);
+        };
+
+        std::ostream& operator << (std::ostream &stream, const Elevation &elevation);
+
         struct Tile {
             const BoundingBox bbox;
             std::vector<POI> poi;
             std::vector<Street> streets;
             std::vector<Area> areas;
+            /// Areas covering the whole tile (only used with shared areas)
+            std::vector<AreaRef> covering{};
+            SpawnTable spawn_table{};
+            BucketIndex bucket_index{};
+            Elevation elevation{};
+            /// Level in the tile hierarchy, see TileAddress
+            int level{0};
+            /// Quadrants of a split tile in Morton order (south west, south east, north west, north east);
+            /// the objects of a split tile are only stored in its children
+            std::vector<Tile> children{};
 
             friend std::ostream& operator << (std::ostream &stream, const Tile &tile);
         };
@@ -70,8 +149,82 @@ namespace rustymon {
 
         using World = std::map<int, std::map<int, structs::Tile>>;
 
+        /**
+         * Address of a tile in the tile hierarchy. Level 0 is the grid of the configured tile size, every
+         * higher level splits the tiles of the level below into quadrants, so tile (x, y) of level n has the
+         * children (2x, 2y), (2x + 1, 2y), (2x, 2y + 1) and (2x + 1, 2y + 1) of level n + 1. Negative levels
+         * join 2x2 tiles of the level above in the same way. Tiles of the world are stored by their position
+         * on level 0 (for joined tiles the position of the south west tile).
+         */
+        struct TileAddress {
+            int level;
+            int x;
+            int y;
+        };
+
+        using TileRef = std::pair<TileAddress, const Tile *>;
+
         std::ostream& stream(std::ostream &stream, const World &world);
 
+        /**
+         * All tiles which are exported on their own, in the canonical order of the world: every tile
+         * without children, and for split tiles an index entry (see stream_unit) followed by the children.
+         */
+        std::vector<TileRef> export_units(const World &world);
+
+        /// Export units of a single tile of the world stored at the given position
+        std::vector<TileRef> export_units(int x, int y, const Tile &tile);
+
+        /// Serialize a tile exported on its own: tiles without children as usual, split tiles as index entry of their children
+        std::ostream& stream_unit(std::ostream &stream, const TileRef &unit);
+
+        /// Call the function for every tile without children using the given number of threads
+        void for_each_tile_parallel(World &world, int worker_threads, const std::function<void(Tile &tile)> &function);
+
+        /// Stream buffer discarding its input, it only counts the characters
+        class CountingBuffer : public std::streambuf {
+            std::size_t count = 0;
+
+        protected:
+
+            int_type overflow(int_type c) override {
+                if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                    count++;
+                }
+                return traits_type::not_eof(c);
+            }
+
+            std::streamsize xsputn(const char *, std::streamsize n) override {
+                count += static_cast<std::size_t>(n);
+                return n;
+            }
+
+        public:
+
+            inline std::size_t get_count() const {
+                return count;
+            }
+        };
+
+        /// Number of bytes of the serialized object
+        template<typename T>
+        std::size_t serialized_size(const T &object) {
+            CountingBuffer buffer;
+            std::ostream stream(&buffer);
+            stream << object;
+            return buffer.get_count();
+        }
+
+        std::size_t memory_usage(const POI &poi);
+
+        std::size_t memory_usage(const Street &street);
+
+        std::size_t memory_usage(const Area &area);
+
+        std::size_t memory_usage(const AreaRef &ref);
+
+        std::size_t memory_usage(const Tile &tile);
+
     }
 
 }
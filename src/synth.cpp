@@ -0,0 +1,371 @@
+#include "synth.hpp"
+
+#include <map>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/io/any_output.hpp>
+#include <osmium/io/header.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/box.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/timestamp.hpp>
+
+namespace rustymon {
+
+    namespace synth {
+
+        namespace {
+
+            const std::size_t BUFFER_SIZE = 1024 * 1024;
+
+            // Number of features at scale 1, which covers a region of about 20 x 20 km
+            const double REGION_CENTER_LON = 8.0;
+            const double REGION_CENTER_LAT = 50.0;
+            const double REGION_HALF_EXTENT = 0.1;
+            const int CLUSTERS = 8;
+            const int POIS_PER_CLUSTER = 250;
+            const int STREETS_PER_CLUSTER = 60;
+            const int HIGHWAYS = 4;
+            const int HIGHWAY_NODES = 400;
+            const int FORESTS = 12;
+            const int SMALL_AREAS = 40;
+
+            using Tags = std::vector<std::pair<std::string, std::string>>;
+            using Points = std::vector<std::pair<double, double>>;
+
+            struct WayPlan {
+                std::int64_t first_node;
+                std::uint32_t node_count;
+                bool closed;
+                int tags;
+            };
+
+            struct RelationPlan {
+                std::int64_t first_way;
+                std::uint32_t way_count;
+                int tags;
+            };
+
+            class DatasetWriter {
+                const config::Config &config;
+                const Options &options;
+                osmium::io::Writer writer;
+                osmium::memory::Buffer buffer{BUFFER_SIZE, osmium::memory::Buffer::auto_grow::yes};
+                std::mt19937_64 random;
+                const osmium::Timestamp timestamp{"2020-01-01T00:00:00Z"};
+
+                std::vector<Tags> tag_sets;
+                std::map<Tags, int> known_tag_sets;
+                std::vector<WayPlan> ways;
+                std::vector<RelationPlan> relations;
+                std::int64_t next_node = 1;
+
+                double min_lon;
+                double min_lat;
+                double max_lon;
+                double max_lat;
+
+                void flush(bool force = false) {
+                    if (buffer.committed() > 0 && (force || buffer.committed() >= BUFFER_SIZE)) {
+                        writer(std::move(buffer));
+                        buffer = osmium::memory::Buffer{BUFFER_SIZE, osmium::memory::Buffer::auto_grow::yes};
+                    }
+                }
+
+                double uniform(const double from, const double to) {
+                    return std::uniform_real_distribution<double>(from, to)(random);
+                }
+
+                double normal(const double mean, const double deviation) {
+                    return std::normal_distribution<double>(mean, deviation)(random);
+                }
+
+                std::size_t choose(const std::size_t count) {
+                    return std::uniform_int_distribution<std::size_t>(0, count - 1)(random);
+                }
+
+                std::pair<double, double> clamp(const std::pair<double, double> &point) const {
+                    return std::pair<double, double>{
+                            std::min(std::max(point.first, min_lon), max_lon),
+                            std::min(std::max(point.second, min_lat), max_lat)
+                    };
+                }
+
+                int intern(Tags tags) {
+                    auto it = known_tag_sets.find(tags);
+                    if (it != known_tag_sets.end()) {
+                        return it->second;
+                    }
+                    const int index = static_cast<int>(tag_sets.size());
+                    known_tag_sets.insert(std::pair<Tags, int>{tags, index});
+                    tag_sets.push_back(std::move(tags));
+                    return index;
+                }
+
+                /// Tags satisfying the required attributes of a config entry, picking one of the listed values
+                Tags tags_for(const config::ObjectProcessorEntry &entry) {
+                    Tags tags;
+                    for (const auto &required: entry.required) {
+                        tags.emplace_back(required.first, required.second.empty() ? "yes" : required.second[choose(required.second.size())]);
+                    }
+                    return tags;
+                }
+
+                Tags random_tags(const std::vector<config::ObjectProcessorEntry> &entries, const Tags &fallback) {
+                    return entries.empty() ? fallback : tags_for(entries[choose(entries.size())]);
+                }
+
+                /// Tags of the first entry requiring any of the given attributes, or of a random entry
+                Tags preferred_tags(const std::vector<config::ObjectProcessorEntry> &entries, const Tags &preferred, const Tags &fallback) {
+                    for (const config::ObjectProcessorEntry &entry: entries) {
+                        for (const std::pair<std::string, std::string> &tag: preferred) {
+                            auto it = entry.required.find(tag.first);
+                            if (it != entry.required.end() && std::find(it->second.begin(), it->second.end(), tag.second) != it->second.end()) {
+                                Tags tags = tags_for(entry);
+                                for (std::pair<std::string, std::string> &existing: tags) {
+                                    if (existing.first == tag.first) {
+                                        existing.second = tag.second;
+                                    }
+                                }
+                                return tags;
+                            }
+                        }
+                    }
+                    return random_tags(entries, fallback);
+                }
+
+                std::int64_t add_node(const std::pair<double, double> &point, const Tags *tags = nullptr) {
+                    const std::int64_t id = next_node++;
+                    {
+                        osmium::builder::NodeBuilder builder{buffer};
+                        builder.set_id(id)
+                                .set_version(1)
+                                .set_visible(true)
+                                .set_timestamp(timestamp)
+                                .set_location(osmium::Location{point.first, point.second});
+                        if (tags != nullptr) {
+                            osmium::builder::TagListBuilder tag_builder{builder};
+                            for (const std::pair<std::string, std::string> &tag: *tags) {
+                                tag_builder.add_tag(tag.first, tag.second);
+                            }
+                        }
+                    }
+                    buffer.commit();
+                    flush();
+                    return id;
+                }
+
+                /// Plan a way over new nodes at the given points, returning the ID of the way
+                std::int64_t add_way(const Points &points, const bool closed, const int tags) {
+                    std::int64_t first_node = 0;
+                    for (const std::pair<double, double> &point: points) {
+                        const std::int64_t id = add_node(clamp(point));
+                        if (first_node == 0) {
+                            first_node = id;
+                        }
+                    }
+                    ways.push_back(WayPlan{first_node, static_cast<std::uint32_t>(points.size()), closed, tags});
+                    return static_cast<std::int64_t>(ways.size());
+                }
+
+                Points ring(const std::pair<double, double> &center, const double radius, const int node_count) {
+                    Points points;
+                    points.reserve(node_count);
+                    for (int i = 0; i < node_count; i++) {
+                        const double angle = 2 * M_PI * i / node_count;
+                        const double distance = radius * uniform(0.85, 1.15);
+                        points.emplace_back(center.first + distance * std::cos(angle), center.second + distance * std::sin(angle));
+                    }
+                    return points;
+                }
+
+                void add_cluster() {
+                    const std::pair<double, double> center{uniform(min_lon, max_lon), uniform(min_lat, max_lat)};
+                    const int pois = static_cast<int>(std::lround(POIS_PER_CLUSTER * options.density));
+                    for (int i = 0; i < pois; i++) {
+                        const Tags tags = random_tags(config.poi, Tags{{"amenity", "restaurant"}});
+                        add_node(clamp(std::pair<double, double>{normal(center.first, 0.005), normal(center.second, 0.005)}), &tags);
+                    }
+
+                    // Streets are short random walks through the cluster
+                    const int streets = static_cast<int>(std::lround(STREETS_PER_CLUSTER * options.density));
+                    for (int i = 0; i < streets; i++) {
+                        Points points;
+                        std::pair<double, double> point{normal(center.first, 0.006), normal(center.second, 0.006)};
+                        double direction = uniform(0, 2 * M_PI);
+                        const int segments = 4 + static_cast<int>(choose(9));
+                        for (int j = 0; j <= segments; j++) {
+                            points.push_back(point);
+                            direction += normal(0, 0.3);
+                            point.first += 0.0008 * std::cos(direction);
+                            point.second += 0.0008 * std::sin(direction);
+                        }
+                        add_way(points, false, intern(random_tags(config.streets, Tags{{"highway", "residential"}})));
+                    }
+                }
+
+                void add_highway() {
+                    // Highways cross the whole region from one side to the other
+                    Points points;
+                    const bool horizontal = choose(2) == 0;
+                    const double offset = uniform(0, 1);
+                    for (int i = 0; i < HIGHWAY_NODES; i++) {
+                        const double progress = static_cast<double>(i) / (HIGHWAY_NODES - 1);
+                        const double along = horizontal ? min_lon + progress * (max_lon - min_lon) : min_lat + progress * (max_lat - min_lat);
+                        const double across = (horizontal ? min_lat + offset * (max_lat - min_lat) : min_lon + offset * (max_lon - min_lon)) +
+                                0.002 * std::sin(progress * 12) + normal(0, 0.0002);
+                        points.emplace_back(horizontal ? along : across, horizontal ? across : along);
+                    }
+                    const Tags tags = preferred_tags(config.streets, Tags{{"highway", "motorway"}, {"highway", "trunk"}}, Tags{{"highway", "motorway"}});
+                    add_way(points, false, intern(tags));
+                }
+
+                void add_forest() {
+                    const std::pair<double, double> center{uniform(min_lon, max_lon), uniform(min_lat, max_lat)};
+                    const double radius = uniform(0.01, 0.03);
+                    const std::int64_t outer = add_way(ring(center, radius, 96), true, -1);
+                    const int holes = 1 + static_cast<int>(choose(3));
+                    for (int i = 0; i < holes; i++) {
+                        // Holes are placed around the center, so they don't overlap each other
+                        const double angle = 2 * M_PI * i / holes;
+                        const std::pair<double, double> hole_center{center.first + 0.45 * radius * std::cos(angle), center.second + 0.45 * radius * std::sin(angle)};
+                        add_way(ring(hole_center, uniform(0.1, 0.25) * radius, 24), true, -1);
+                    }
+
+                    Tags tags = preferred_tags(config.areas, Tags{{"landuse", "forest"}, {"natural", "wood"}}, Tags{{"landuse", "forest"}});
+                    tags.emplace_back("type", "multipolygon");
+                    relations.push_back(RelationPlan{outer, static_cast<std::uint32_t>(holes + 1), intern(tags)});
+                }
+
+                void add_small_area() {
+                    const std::pair<double, double> center{uniform(min_lon, max_lon), uniform(min_lat, max_lat)};
+                    add_way(ring(center, uniform(0.001, 0.004), 12), true, intern(random_tags(config.areas, Tags{{"natural", "water"}})));
+                }
+
+                void add_tags(osmium::builder::Builder &builder, const int tags) {
+                    if (tags < 0) {
+                        return;
+                    }
+                    osmium::builder::TagListBuilder tag_builder{builder};
+                    for (const std::pair<std::string, std::string> &tag: tag_sets[tags]) {
+                        tag_builder.add_tag(tag.first, tag.second);
+                    }
+                }
+
+                void write_ways() {
+                    for (std::size_t i = 0; i < ways.size(); i++) {
+                        const WayPlan &plan = ways[i];
+                        {
+                            osmium::builder::WayBuilder builder{buffer};
+                            builder.set_id(static_cast<osmium::object_id_type>(i + 1))
+                                    .set_version(1)
+                                    .set_visible(true)
+                                    .set_timestamp(timestamp);
+                            {
+                                osmium::builder::WayNodeListBuilder node_builder{builder};
+                                for (std::uint32_t j = 0; j < plan.node_count; j++) {
+                                    node_builder.add_node_ref(plan.first_node + j);
+                                }
+                                if (plan.closed) {
+                                    node_builder.add_node_ref(plan.first_node);
+                                }
+                            }
+                            add_tags(builder, plan.tags);
+                        }
+                        buffer.commit();
+                        flush();
+                    }
+                }
+
+                void write_relations() {
+                    for (std::size_t i = 0; i < relations.size(); i++) {
+                        const RelationPlan &plan = relations[i];
+                        {
+                            osmium::builder::RelationBuilder builder{buffer};
+                            builder.set_id(static_cast<osmium::object_id_type>(i + 1))
+                                    .set_version(1)
+                                    .set_visible(true)
+                                    .set_timestamp(timestamp);
+                            {
+                                osmium::builder::RelationMemberListBuilder member_builder{builder};
+                                for (std::uint32_t j = 0; j < plan.way_count; j++) {
+                                    member_builder.add_member(osmium::item_type::way, plan.first_way + j, j == 0 ? "outer" : "inner");
+                                }
+                            }
+                            add_tags(builder, plan.tags);
+                        }
+                        buffer.commit();
+                        flush();
+                    }
+                }
+
+            public:
+
+                DatasetWriter(const std::string &filename, const osmium::io::Header &header, const config::Config &config, const Options &options, const osmium::Box &region) :
+                        config(config),
+                        options(options),
+                        writer(filename, header, osmium::io::overwrite::allow),
+                        random(options.seed),
+                        min_lon(region.bottom_left().lon()),
+                        min_lat(region.bottom_left().lat()),
+                        max_lon(region.top_right().lon()),
+                        max_lat(region.top_right().lat()) {}
+
+                Statistics run() {
+                    const int clusters = static_cast<int>(std::lround(CLUSTERS * options.scale));
+                    for (int i = 0; i < clusters; i++) {
+                        add_cluster();
+                    }
+                    const int highways = std::max(1, static_cast<int>(std::lround(HIGHWAYS * options.scale)));
+                    for (int i = 0; i < highways; i++) {
+                        add_highway();
+                    }
+                    const int forests = static_cast<int>(std::lround(FORESTS * options.scale));
+                    for (int i = 0; i < forests; i++) {
+                        add_forest();
+                    }
+                    const int small_areas = static_cast<int>(std::lround(SMALL_AREAS * options.scale));
+                    for (int i = 0; i < small_areas; i++) {
+                        add_small_area();
+                    }
+
+                    // All nodes have been written, the file must be sorted by type and ID
+                    flush(true);
+                    write_ways();
+                    flush(true);
+                    write_relations();
+                    flush(true);
+                    writer.close();
+                    return Statistics{static_cast<std::uint64_t>(next_node - 1), ways.size(), relations.size()};
+                }
+            };
+
+        }
+
+        Statistics write_dataset(const std::string &filename, const config::Config &config, const Options &options, std::ostream &logger) {
+            const double half_extent = REGION_HALF_EXTENT * std::sqrt(std::max(options.scale, 0.0));
+            const osmium::Box region{
+                    REGION_CENTER_LON - half_extent, REGION_CENTER_LAT - half_extent,
+                    REGION_CENTER_LON + half_extent, REGION_CENTER_LAT + half_extent
+            };
+
+            osmium::io::Header header;
+            header.set("generator", "rustymon synth");
+            header.set("sorting", "Type_then_ID");
+            header.add_box(region);
+
+            DatasetWriter writer(filename, header, config, options, region);
+            const Statistics statistics = writer.run();
+            logger << "Wrote " << statistics.nodes << " nodes, " << statistics.ways << " ways and "
+                   << statistics.relations << " relations to " << filename << "." << std::endl;
+            return statistics;
+        }
+
+    }
+
+}
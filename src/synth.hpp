@@ -0,0 +1,41 @@
+#ifndef WORLD_GENERATOR_SYNTH_HPP
+#define WORLD_GENERATOR_SYNTH_HPP
+
+#include <string>
+#include <cstdint>
+#include <iostream>
+
+#include "config.hpp"
+
+namespace rustymon {
+
+    namespace synth {
+
+        struct Options {
+            /// Multiplier of the number of objects; the covered region grows with it, so the density stays the same
+            double scale;
+            /// Multiplier of the number of objects per urban cluster
+            double density;
+            std::uint64_t seed;
+        };
+
+        struct Statistics {
+            std::uint64_t nodes;
+            std::uint64_t ways;
+            std::uint64_t relations;
+        };
+
+        /**
+         * Write a synthetic OSM file (any format supported by libosmium, detected by the file name).
+         * The tags are taken from the required attributes of the config, so the objects are picked up
+         * by the generator: urban clusters of POIs and streets, long highways across the region,
+         * large forests as multipolygons with holes and smaller closed-way areas. The output is
+         * sorted by type and ID and depends only on the options and the config.
+         */
+        Statistics write_dataset(const std::string &filename, const config::Config &config, const Options &options, std::ostream &logger = std::cout);
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_SYNTH_HPP
@@ -0,0 +1,144 @@
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "archive.hpp"
+
+static const int DEFAULT_SERVE_PORT = 8081;
+static const std::size_t MAX_REQUEST_SIZE = 8192;
+
+
+void send_response(int client, const std::string &status, const char *body, std::size_t body_size) {
+    std::stringstream header;
+    header << "HTTP/1.1 " << status << "\r\n"
+           << "Content-Type: application/json\r\n"
+           << "Content-Length: " << body_size << "\r\n"
+           << "Connection: close\r\n\r\n";
+    const std::string header_string = header.str();
+    send(client, header_string.data(), header_string.size(), MSG_NOSIGNAL);
+    std::size_t sent = 0;
+    while (sent < body_size) {
+        ssize_t result = send(client, body + sent, body_size - sent, MSG_NOSIGNAL);
+        if (result <= 0) {
+            return;
+        }
+        sent += static_cast<std::size_t>(result);
+    }
+}
+
+
+void handle_request(int client, const rustymon::archive::Reader &reader) {
+    char request[MAX_REQUEST_SIZE];
+    ssize_t length = recv(client, request, sizeof(request) - 1, 0);
+    if (length <= 0) {
+        return;
+    }
+    request[length] = '\0';
+
+    // Only the request line is of interest: "GET /<x>/<y>[/<level>] HTTP/1.1"
+    int x = 0;
+    int y = 0;
+    int level = 0;
+    char end = '\0';
+    const bool valid = (std::sscanf(request, "GET /%d/%d/%d%c", &x, &y, &level, &end) == 4 ||
+                        std::sscanf(request, "GET /%d/%d%c", &x, &y, &end) == 3) && (end == ' ' || end == '?');
+    if (!valid) {
+        const std::string message = "{\"error\":\"expected GET /<x>/<y>[/<level>]\"}";
+        send_response(client, "400 Bad Request", message.data(), message.size());
+        return;
+    }
+
+    const rustymon::archive::TileData tile = reader.get(x, y, level);
+    if (tile.data == nullptr) {
+        const std::string message = "{\"error\":\"tile not found\"}";
+        send_response(client, "404 Not Found", message.data(), message.size());
+        return;
+    }
+    send_response(client, "200 OK", tile.data, tile.size);
+}
+
+
+int serve(const rustymon::archive::Reader &reader, int port) {
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    if (server < 0) {
+        std::cerr << "Failed to create the server socket." << std::endl;
+        return 1;
+    }
+    int reuse = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(server, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(server, 64) != 0) {
+        std::cerr << "Failed to listen on port " << port << "." << std::endl;
+        close(server);
+        return 1;
+    }
+
+    std::cout << "Serving " << reader.size() << " tiles on http://127.0.0.1:" << port << "/<x>/<y>[/<level>] ..." << std::endl;
+    while (true) {
+        int client = accept(server, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        handle_request(client, reader);
+        close(client);
+    }
+}
+
+
+int main(int argc, char *argv[]) {
+    const std::string usage = "Usage: " + std::string(argv[0]) + " <ArchiveFile> {get <X> <Y> [<Level>],list,serve [<Port>]}";
+    if (argc < 3) {
+        std::cerr << usage << std::endl;
+        return 2;
+    }
+
+    try {
+        const rustymon::archive::Reader reader(argv[1]);
+
+        if (strcmp(argv[2], "get") == 0 && (argc == 5 || argc == 6)) {
+            const int level = (argc == 6) ? std::stoi(argv[5]) : 0;
+            const rustymon::archive::TileData tile = reader.get(std::stoi(argv[3]), std::stoi(argv[4]), level);
+            if (tile.data == nullptr) {
+                std::cerr << "Tile " << argv[3] << "," << argv[4] << " (level " << level << ") not found." << std::endl;
+                return 1;
+            }
+            std::cout.write(tile.data, static_cast<std::streamsize>(tile.size));
+            std::cout << std::endl;
+            return 0;
+        } else if (strcmp(argv[2], "list") == 0 && argc == 3) {
+            for (const auto &position: reader.positions()) {
+                std::cout << position.x << "," << position.y;
+                if (position.level != 0) {
+                    std::cout << "," << position.level;
+                }
+                std::cout << std::endl;
+            }
+            return 0;
+        } else if (strcmp(argv[2], "serve") == 0 && argc <= 4) {
+            return serve(reader, (argc == 4) ? std::stoi(argv[3]) : DEFAULT_SERVE_PORT);
+        }
+    } catch (std::logic_error &) {
+        // Thrown by std::stoi for values which aren't integers or out of range
+        std::cerr << "Tile positions and ports have to be integer values." << std::endl;
+        std::cerr << usage << std::endl;
+        return 2;
+    } catch (std::runtime_error &error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    std::cerr << usage << std::endl;
+    return 2;
+}
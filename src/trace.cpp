@@ -0,0 +1,137 @@
+#include "trace.hpp"
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <fstream>
+
+namespace rustymon {
+
+    namespace trace {
+
+        bool enabled = false;
+
+        namespace {
+
+            enum class Phase : char {
+                COMPLETE = 'X',
+                ASYNC = 'b',
+                COUNTER = 'C'
+            };
+
+            struct Event {
+                const char *name;
+                const char *category;
+                std::int64_t start;
+                /// Duration of spans, value of counters
+                std::int64_t value;
+                std::uint64_t id;
+                Phase phase;
+            };
+
+            struct ThreadBuffer {
+                int id;
+                std::string name;
+                std::vector<Event> events;
+            };
+
+            std::chrono::steady_clock::time_point trace_start;
+
+            /// Buffers of all threads which recorded anything, they outlive their threads
+            std::mutex registry_mutex;
+            std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+            ThreadBuffer &thread_buffer() {
+                thread_local ThreadBuffer *buffer = nullptr;
+                if (buffer == nullptr) {
+                    std::lock_guard<std::mutex> lock(registry_mutex);
+                    registry.emplace_back(new ThreadBuffer{static_cast<int>(registry.size()) + 1, {}, {}});
+                    buffer = registry.back().get();
+                }
+                return *buffer;
+            }
+
+            void write_string(std::ostream &stream, const std::string &value) {
+                stream << '"';
+                for (const char c: value) {
+                    if (c == '"' || c == '\\') {
+                        stream << '\\';
+                    }
+                    stream << c;
+                }
+                stream << '"';
+            }
+
+        }
+
+        void start() {
+            trace_start = std::chrono::steady_clock::now();
+            enabled = true;
+        }
+
+        std::int64_t now() {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - trace_start).count();
+        }
+
+        void record(const char *name, const char *category, const std::int64_t start, const std::int64_t end) {
+            thread_buffer().events.push_back(Event{name, category, start, end - start, 0, Phase::COMPLETE});
+        }
+
+        void record_async(const char *name, const char *category, const std::uint64_t id, const std::int64_t start, const std::int64_t end) {
+            thread_buffer().events.push_back(Event{name, category, start, end - start, id, Phase::ASYNC});
+        }
+
+        void counter(const char *name, const std::int64_t value) {
+            if (enabled) {
+                thread_buffer().events.push_back(Event{name, "counter", now(), value, 0, Phase::COUNTER});
+            }
+        }
+
+        void set_thread_name(const std::string &name) {
+            if (enabled) {
+                thread_buffer().name = name;
+            }
+        }
+
+        bool write(const std::string &filename) {
+            std::ofstream output(filename);
+            if (!output.is_open()) {
+                return false;
+            }
+
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+            bool first = true;
+            for (const std::unique_ptr<ThreadBuffer> &buffer: registry) {
+                output << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":";
+                write_string(output, buffer->name.empty() ? "thread " + std::to_string(buffer->id) : buffer->name);
+                output << "}}";
+                first = false;
+
+                for (const Event &event: buffer->events) {
+                    output << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"pid\":1,\"tid\":" << buffer->id;
+                    switch (event.phase) {
+                        case Phase::COMPLETE:
+                            output << ",\"ph\":\"X\",\"ts\":" << event.start << ",\"dur\":" << event.value << "}";
+                            break;
+                        case Phase::ASYNC:
+                            // Async spans are written as pair of begin and end events with the same ID
+                            output << ",\"ph\":\"b\",\"id\":" << event.id << ",\"ts\":" << event.start << "}";
+                            output << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"pid\":1,\"tid\":" << buffer->id
+                                   << ",\"ph\":\"e\",\"id\":" << event.id << ",\"ts\":" << event.start + event.value << "}";
+                            break;
+                        case Phase::COUNTER:
+                            output << ",\"ph\":\"C\",\"ts\":" << event.start << ",\"args\":{\"value\":" << event.value << "}}";
+                            break;
+                    }
+                }
+            }
+            output << "\n]}\n";
+            output.close();
+            return !output.fail();
+        }
+
+    }
+
+}
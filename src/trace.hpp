@@ -0,0 +1,70 @@
+#ifndef WORLD_GENERATOR_TRACE_HPP
+#define WORLD_GENERATOR_TRACE_HPP
+
+#include <string>
+#include <cstdint>
+
+/*
+ * Opt-in timeline of the pipeline in the Trace Event Format of Chrome (chrome://tracing,
+ * Perfetto). Every thread records its events into a buffer of its own without any locking,
+ * the buffers are only merged when the trace is written. While tracing isn't enabled,
+ * recording an event costs a single branch.
+ */
+
+namespace rustymon {
+
+    namespace trace {
+
+        /// Set by start() before any worker thread is created, never reset afterwards
+        extern bool enabled;
+
+        /// Enable tracing, the timestamps of all events are relative to this call
+        void start();
+
+        /// Microseconds since the start of the trace
+        std::int64_t now();
+
+        /// Record a completed span of the calling thread (names and categories must be string literals)
+        void record(const char *name, const char *category, std::int64_t start, std::int64_t end);
+
+        /// Record a span which may overlap other spans of the calling thread, e.g. a request of an event loop
+        void record_async(const char *name, const char *category, std::uint64_t id, std::int64_t start, std::int64_t end);
+
+        /// Record the current value of a counter, e.g. the length of a queue
+        void counter(const char *name, std::int64_t value);
+
+        /// Name the calling thread in the trace
+        void set_thread_name(const std::string &name);
+
+        /// Write all recorded events as JSON, all threads must have stopped recording; returns false on errors
+        bool write(const std::string &filename);
+
+        /// Record the lifetime of the scope as span of the calling thread
+        class Scope {
+            const char *name;
+            const char *category;
+            std::int64_t start = 0;
+
+        public:
+
+            Scope(const char *name, const char *category) : name(name), category(category) {
+                if (enabled) {
+                    start = now();
+                }
+            }
+
+            Scope(const Scope &) = delete;
+            Scope& operator = (const Scope &) = delete;
+
+            ~Scope() {
+                if (enabled) {
+                    record(name, category, start, now());
+                }
+            }
+        };
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_TRACE_HPP
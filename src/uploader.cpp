@@ -0,0 +1,299 @@
+#include "uploader.hpp"
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+
+#include <curl/curl.h>
+
+#include "trace.hpp"
+
+namespace rustymon {
+
+    namespace upload {
+
+        namespace {
+
+            std::once_flag curl_initialized;
+
+            struct Transfer {
+                CURL *handle = nullptr;
+                curl_slist *headers = nullptr;
+                UploadJob job{};
+                std::size_t tracked_bytes = 0;
+                /// Start of the request in the trace, if tracing is enabled
+                std::int64_t trace_start = 0;
+                std::chrono::steady_clock::time_point started{};
+                /// Number of retries of the current job
+                int retries = 0;
+                /// Time at which a failed request is repeated
+                std::chrono::steady_clock::time_point retry_at{};
+            };
+
+            std::size_t discard_response(char *, std::size_t size, std::size_t count, void *) {
+                return size * count;
+            }
+
+            class EventLoop {
+                const Options &options;
+                const JobSource &source;
+                const CompletionCallback &on_success;
+                const RequestCallback &on_request;
+                std::ostream &logger;
+                std::mutex &logger_mutex;
+                memory::MemoryTracker *tracker;
+
+                CURLM *multi;
+                std::vector<std::unique_ptr<Transfer>> transfers;
+                std::vector<Transfer *> idle;
+                /// Transfers waiting for their retry, which don't count as active
+                std::vector<Transfer *> waiting;
+                int active = 0;
+                bool exhausted = false;
+                /// The source had no job ready at the last request
+                bool starved = false;
+
+                UploadResult result{0, 0, 0, 0};
+
+                void log_error(const Transfer &transfer, const std::string &message) {
+                    std::unique_lock<std::mutex> lock(logger_mutex);
+                    logger << message << " while uploading Tile " << transfer.job.x << "," << transfer.job.y;
+                    if (transfer.job.level != 0) {
+                        logger << " (level " << transfer.job.level << ")";
+                    }
+                    logger << std::endl;
+                }
+
+                bool start_next() {
+                    if (tracker != nullptr && active > 0 && tracker->exceeded()) {
+                        // Don't allocate further bodies while the memory budget is exhausted
+                        return false;
+                    }
+
+                    Transfer *transfer = idle.back();
+                    const JobState state = source(transfer->job);
+                    if (state != JobState::READY) {
+                        exhausted = state == JobState::DONE;
+                        starved = state == JobState::LATER;
+                        return false;
+                    }
+                    starved = false;
+                    idle.pop_back();
+
+                    if (tracker != nullptr) {
+                        transfer->tracked_bytes = transfer->job.body.capacity();
+                        tracker->add(memory::Component::EXPORT_BUFFERS, transfer->tracked_bytes);
+                    }
+
+                    const std::string position = "X-Tile-Position: " + std::to_string(transfer->job.x) + "," + std::to_string(transfer->job.y);
+                    transfer->headers = curl_slist_append(nullptr, "Content-Type: application/json");
+                    transfer->headers = curl_slist_append(transfer->headers, position.c_str());
+                    if (transfer->job.level != 0) {
+                        const std::string level = "X-Tile-Level: " + std::to_string(transfer->job.level);
+                        transfer->headers = curl_slist_append(transfer->headers, level.c_str());
+                    }
+                    if (!options.auth_info.empty()) {
+                        transfer->headers = curl_slist_append(transfer->headers, ("Authorization: " + options.auth_info).c_str());
+                    }
+
+                    // The easy handles are reused, so they keep their connections alive in the multi handle
+                    CURL *handle = transfer->handle;
+                    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, transfer->headers);
+                    curl_easy_setopt(handle, CURLOPT_POSTFIELDS, transfer->job.body.data());
+                    curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(transfer->job.body.size()));
+                    transfer->retries = 0;
+                    submit(transfer);
+                    return true;
+                }
+
+                void submit(Transfer *transfer) {
+                    curl_multi_add_handle(multi, transfer->handle);
+                    active++;
+                    result.bytes_sent += transfer->job.body.size();
+                    transfer->started = std::chrono::steady_clock::now();
+                    if (trace::enabled) {
+                        transfer->trace_start = trace::now();
+                    }
+                }
+
+                /// Submit the waiting transfers whose retry is due
+                void submit_due_retries() {
+                    const auto now = std::chrono::steady_clock::now();
+                    for (std::size_t i = 0; i < waiting.size();) {
+                        if (waiting[i]->retry_at <= now) {
+                            submit(waiting[i]);
+                            waiting[i] = waiting.back();
+                            waiting.pop_back();
+                        } else {
+                            i++;
+                        }
+                    }
+                }
+
+                /// Milliseconds to wait for network activity before the next retry is due or the source is asked again
+                long poll_timeout() const {
+                    long timeout = starved ? UPLOAD_SOURCE_WAIT_MS : UPLOAD_POLL_TIMEOUT_MS;
+                    const auto now = std::chrono::steady_clock::now();
+                    for (const Transfer *transfer: waiting) {
+                        const long due = static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(transfer->retry_at - now).count());
+                        timeout = std::max(0L, std::min(timeout, due));
+                    }
+                    return timeout;
+                }
+
+                void finish(CURL *handle, CURLcode code) {
+                    Transfer *transfer = nullptr;
+                    curl_easy_getinfo(handle, CURLINFO_PRIVATE, reinterpret_cast<char **>(&transfer));
+                    curl_multi_remove_handle(multi, handle);
+                    active--;
+                    if (trace::enabled) {
+                        trace::record_async("request", "http", reinterpret_cast<std::uintptr_t>(transfer), transfer->trace_start, trace::now());
+                    }
+
+                    long status_code = 0;
+                    curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status_code);
+                    if (on_request) {
+                        const auto duration = std::chrono::steady_clock::now() - transfer->started;
+                        on_request(transfer->job, (code == CURLE_OK) ? status_code : 0, std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+                    }
+
+                    // Throttled requests and server errors are repeated with an exponential backoff
+                    const bool retryable = code != CURLE_OK || status_code == 429 || status_code >= 500;
+                    if (retryable && transfer->retries < options.max_retries) {
+                        transfer->retry_at = std::chrono::steady_clock::now() + std::chrono::milliseconds(HTTP_RETRY_BACKOFF_MS << std::min(transfer->retries, 10));
+                        transfer->retries++;
+                        result.retries++;
+                        waiting.push_back(transfer);
+                        return;
+                    }
+
+                    result.total_requests++;
+                    if (code != CURLE_OK) {
+                        result.errors++;
+                        log_error(*transfer, "Request failed (" + std::string(curl_easy_strerror(code)) + ")");
+                    } else if (status_code != 200) {
+                        result.errors++;
+                        log_error(*transfer, "Received status code " + std::to_string(status_code));
+                    } else if (on_success) {
+                        on_success(transfer->job);
+                    }
+
+                    curl_slist_free_all(transfer->headers);
+                    transfer->headers = nullptr;
+                    std::string().swap(transfer->job.body);
+                    if (tracker != nullptr) {
+                        tracker->sub(memory::Component::EXPORT_BUFFERS, transfer->tracked_bytes);
+                        transfer->tracked_bytes = 0;
+                    }
+                    idle.push_back(transfer);
+                }
+
+            public:
+
+                EventLoop(const Options &options, const JobSource &source, const CompletionCallback &on_success, const RequestCallback &on_request, std::ostream &logger, std::mutex &logger_mutex, memory::MemoryTracker *tracker, int slots) :
+                        options(options), source(source), on_success(on_success), on_request(on_request), logger(logger), logger_mutex(logger_mutex), tracker(tracker) {
+                    multi = curl_multi_init();
+                    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(std::max(1, options.max_connections)));
+                    if (options.http2) {
+                        curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+                    }
+
+                    for (int i = 0; i < slots; i++) {
+                        std::unique_ptr<Transfer> transfer(new Transfer());
+                        transfer->handle = curl_easy_init();
+                        curl_easy_setopt(transfer->handle, CURLOPT_URL, options.push_url.c_str());
+                        curl_easy_setopt(transfer->handle, CURLOPT_POST, 1L);
+                        curl_easy_setopt(transfer->handle, CURLOPT_NOSIGNAL, 1L);
+                        curl_easy_setopt(transfer->handle, CURLOPT_WRITEFUNCTION, discard_response);
+                        curl_easy_setopt(transfer->handle, CURLOPT_PRIVATE, transfer.get());
+                        if (options.http2) {
+                            curl_easy_setopt(transfer->handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+                            // Wait for an existing connection to be multiplexed instead of opening a new one
+                            curl_easy_setopt(transfer->handle, CURLOPT_PIPEWAIT, 1L);
+                        }
+                        idle.push_back(transfer.get());
+                        transfers.push_back(std::move(transfer));
+                    }
+                }
+
+                EventLoop(const EventLoop &) = delete;
+                EventLoop& operator = (const EventLoop &) = delete;
+
+                ~EventLoop() {
+                    for (std::unique_ptr<Transfer> &transfer: transfers) {
+                        curl_easy_cleanup(transfer->handle);
+                        curl_slist_free_all(transfer->headers);
+                    }
+                    curl_multi_cleanup(multi);
+                }
+
+                UploadResult run() {
+                    while (true) {
+                        submit_due_retries();
+                        while (!exhausted && !idle.empty() && start_next()) {}
+                        if (active == 0) {
+                            if (exhausted && waiting.empty()) {
+                                break;
+                            }
+                            // Waiting for memory to be released by other event loops, for the next retry or for the next job
+                            std::this_thread::sleep_for(std::chrono::milliseconds(starved ? UPLOAD_SOURCE_WAIT_MS : MEMORY_EXPORT_WAIT_MS));
+                            continue;
+                        }
+
+                        int running = 0;
+                        curl_multi_perform(multi, &running);
+
+                        int remaining = 0;
+                        while (CURLMsg *message = curl_multi_info_read(multi, &remaining)) {
+                            if (message->msg == CURLMSG_DONE) {
+                                finish(message->easy_handle, message->data.result);
+                            }
+                        }
+
+                        if (running > 0) {
+                            curl_multi_wait(multi, nullptr, 0, static_cast<int>(poll_timeout()), nullptr);
+                        }
+                    }
+                    return result;
+                }
+            };
+
+        }
+
+        UploadResult upload_all(const Options &options, const JobSource &source, std::ostream &logger, memory::MemoryTracker *tracker, const CompletionCallback &on_success, const RequestCallback &on_request) {
+            std::call_once(curl_initialized, [](){
+                curl_global_init(CURL_GLOBAL_DEFAULT);
+            });
+
+            const int threads = std::max(1, options.event_threads);
+            const int slots_per_thread = std::max(1, options.max_in_flight / threads);
+
+            std::mutex logger_mutex;
+            std::mutex result_mutex;
+            UploadResult total{0, 0, 0, 0};
+            std::vector<std::thread> thread_pool;
+            thread_pool.reserve(threads);
+            for (int i = 0; i < threads; i++) {
+                thread_pool.emplace_back([&options, &source, &on_success, &on_request, &logger, &logger_mutex, tracker, slots_per_thread, &result_mutex, &total, i](){
+                    trace::set_thread_name("upload event loop " + std::to_string(i));
+                    EventLoop loop(options, source, on_success, on_request, logger, logger_mutex, tracker, slots_per_thread);
+                    UploadResult result = loop.run();
+                    std::unique_lock<std::mutex> lock(result_mutex);
+                    total.total_requests += result.total_requests;
+                    total.errors += result.errors;
+                    total.retries += result.retries;
+                    total.bytes_sent += result.bytes_sent;
+                });
+            }
+            for (std::thread &t: thread_pool) {
+                t.join();
+            }
+            return total;
+        }
+
+    }
+
+}
@@ -0,0 +1,85 @@
+#ifndef WORLD_GENERATOR_UPLOADER_HPP
+#define WORLD_GENERATOR_UPLOADER_HPP
+
+#include <string>
+#include <cstdint>
+#include <iostream>
+#include <functional>
+
+#include "constants.hpp"
+#include "memory.hpp"
+
+namespace rustymon {
+
+    namespace upload {
+
+        struct UploadJob {
+            int x;
+            int y;
+            /// Level of the tile, sent as X-Tile-Level header if it's not zero
+            int level;
+            std::string body;
+        };
+
+        enum class JobState {
+            /// The job has been filled
+            READY,
+            /// No job is available yet, the source is asked again later
+            LATER,
+            /// There are no more jobs
+            DONE
+        };
+
+        /**
+         * Source of upload jobs shared by all event loops. It must be thread-safe and must not block,
+         * as it's called from the event loops: fill the given job and return READY, return LATER while
+         * the next job is still being prepared, or DONE when there are no more jobs.
+         */
+        using JobSource = std::function<JobState(UploadJob &job)>;
+
+        /// Called from the event loop threads after a job has been uploaded successfully
+        using CompletionCallback = std::function<void(const UploadJob &job)>;
+
+        /**
+         * Called from the event loop threads after every attempt of a request with its status code
+         * (zero if the request failed without a response) and its duration in microseconds
+         */
+        using RequestCallback = std::function<void(const UploadJob &job, long status_code, std::int64_t microseconds)>;
+
+        struct Options {
+            std::string push_url;
+            std::string auth_info;
+            /// Number of threads running their own event loop
+            int event_threads;
+            /// Maximum number of concurrent requests over all event loops
+            int max_in_flight;
+            /// Maximum number of connections to the push host per event loop
+            int max_connections;
+            /// Negotiate HTTP/2 (with multiplexing) if the server supports it
+            bool http2;
+            /// Number of times a request is repeated after a failure, a 429 or a 5xx status code
+            int max_retries;
+        };
+
+        struct UploadResult {
+            /// Number of uploaded jobs, without repeated requests
+            int total_requests;
+            /// Number of jobs which failed after all retries
+            int errors;
+            int retries;
+            /// Bytes of all request bodies sent, including repeated requests
+            std::uint64_t bytes_sent;
+        };
+
+        /**
+         * Upload all jobs of the given source with a number of curl-multi event loops.
+         * Bodies are requested from the source only when a transfer slot is free,
+         * so at most `max_in_flight` bodies are held in memory at any time.
+         */
+        UploadResult upload_all(const Options &options, const JobSource &source, std::ostream &logger, memory::MemoryTracker *tracker = nullptr, const CompletionCallback &on_success = CompletionCallback(), const RequestCallback &on_request = RequestCallback());
+
+    }
+
+}
+
+#endif //WORLD_GENERATOR_UPLOADER_HPP